@@ -19,14 +19,17 @@
 
 #include <Arduino.h>
 #include <math.h>
+#include "euno_fastmath.h"
 #include <EEPROM.h>
+#include "euno_config.h"
 #include <QMC5883LCompass.h>
 
 // ---------- CONFIGURAZIONE ----------
 
 #define ADV_SECTORS 72          // Numero di settori (es. 72 => 1 punto ogni 5°)
 #define SMOOTHING_FACTOR 0.2f   // Fattore smoothing per calibrazione
-#define ADV_EEPROM_ADDR 100     // Indirizzo EEPROM dove parte la tabella ADV
+#define ADV_CFG_VER 1           // record CFG_ADV (euno_config.h)
+#define ADV_LEGACY_ADDR 100     // layout a indirizzi fissi (solo migrazione)
 
 struct AdvCalPoint {
     float rawX;
@@ -37,6 +40,7 @@ struct AdvCalPoint {
 };
 
 static AdvCalPoint advTable[ADV_SECTORS];
+CFG_ASSERT_FITS(CFG_ADV, advTable);
 static int advPointCount = 0;
 static bool advCalibrationMode = false;
 
@@ -55,12 +59,100 @@ static inline int sectorIndex(int deg) {
     return norm360(deg) / (360 / ADV_SECTORS);
 }
 
+// ---------- TABELLA COMPILATA (lookup O(1)) ----------
+// Dopo la calibrazione advTable (vettori grezzi, resta per diagnostica) viene
+// compilata in ADV_LUT_BINS celle indicizzate dall'angolo grezzo del campo
+// attorno al centro dei punti: heading in decimi di grado, interpolato tra i
+// punti vicini in angolo. In uso basta 1 atan2 + 1 interpolazione tra due
+// celle: niente scansione dei 72 punti, niente sqrt.
+// Doppio buffer: loop() compila nell'altro e poi scambia, il task di controllo
+// (MODE 3) legge sempre una tabella completa.
+
+#define ADV_LUT_BINS 360        // 1 cella per grado di angolo grezzo
+
+struct AdvLut {
+    float    cx = 0.0f, cy = 0.0f;          // centro dei punti (hard-iron grezzo)
+    uint16_t hdg10[ADV_LUT_BINS];           // heading ×10 (0..3599)
+};
+
+static AdvLut advLut[2];
+static volatile int8_t advLutActive = -1;   // -1 = non compilata
+
+static inline float advWrap180(float a) {
+    while (a >  180.0f) a -= 360.0f;
+    while (a < -180.0f) a += 360.0f;
+    return a;
+}
+
+// Compila advTable → advLut; false se ci sono meno di 2 punti
+static inline bool advCompileLut() {
+    float th[ADV_SECTORS], hd[ADV_SECTORS];
+    int n = 0;
+    float cx = 0.0f, cy = 0.0f;
+    for (int i = 0; i < ADV_SECTORS; i++) {
+        if (!advTable[i].calibrated) continue;
+        cx += advTable[i].rawX; cy += advTable[i].rawY; n++;
+    }
+    if (n < 2) { advLutActive = -1; return false; }
+    cx /= n; cy /= n;
+
+    // punti ordinati per angolo grezzo (insertion sort, n ≤ 72)
+    n = 0;
+    for (int i = 0; i < ADV_SECTORS; i++) {
+        if (!advTable[i].calibrated) continue;
+        float t = fm_atan2_deg360(advTable[i].rawY - cy, advTable[i].rawX - cx);
+        float h = (float)norm360((float)advTable[i].headingDeg);
+        int j = n++;
+        while (j > 0 && th[j - 1] > t) { th[j] = th[j - 1]; hd[j] = hd[j - 1]; j--; }
+        th[j] = t; hd[j] = h;
+    }
+
+    int dst = (advLutActive == 0) ? 1 : 0;
+    AdvLut& L = advLut[dst];
+    L.cx = cx; L.cy = cy;
+    // per ogni cella: punti a cavallo (circolari) e interpolazione lineare
+    int k = 0;   // primo punto con angolo > cella
+    for (int b = 0; b < ADV_LUT_BINS; b++) {
+        float a = (b + 0.5f) * (360.0f / ADV_LUT_BINS);
+        while (k < n && th[k] <= a) k++;
+        int i0 = (k == 0) ? n - 1 : k - 1;
+        int i1 = (k == n) ? 0 : k;
+        float span = th[i1] - th[i0]; if (span <= 0.0f) span += 360.0f;
+        float off  = a - th[i0];      if (off  <  0.0f) off  += 360.0f;
+        float t = (span > 1e-3f) ? off / span : 0.0f;
+        float h = hd[i0] + t * advWrap180(hd[i1] - hd[i0]);
+        int h10 = (int)lroundf(h * 10.0f) % 3600;
+        if (h10 < 0) h10 += 3600;
+        L.hdg10[b] = (uint16_t)h10;
+    }
+    advLutActive = (int8_t)dst;
+    Serial.printf("[ADV] Tabella compilata: %d punti, centro X=%.2f Y=%.2f\n", n, cx, cy);
+    return true;
+}
+
+// Heading dalla tabella compilata (gradi 0..360), NAN se non compilata
+static inline float advLutLookup(float x, float y) {
+    int a = advLutActive;
+    if (a < 0) return NAN;
+    const AdvLut& L = advLut[a];
+    float f = fm_atan2_deg360(y - L.cy, x - L.cx) * (ADV_LUT_BINS / 360.0f) - 0.5f;
+    if (f < 0.0f) f += ADV_LUT_BINS;
+    int   b0 = (int)f;
+    float t  = f - (float)b0;
+    if (b0 >= ADV_LUT_BINS) b0 -= ADV_LUT_BINS;
+    int   b1 = (b0 + 1 == ADV_LUT_BINS) ? 0 : b0 + 1;
+    float h0 = L.hdg10[b0] * 0.1f;
+    float h  = h0 + t * advWrap180(L.hdg10[b1] * 0.1f - h0);
+    return (h < 0.0f) ? h + 360.0f : (h >= 360.0f ? h - 360.0f : h);
+}
+
 // ---------- CALIBRAZIONE ----------
 
 // Avvia la calibrazione ADV
 static inline void startAdvancedCalibration() {
     advPointCount = 0;
     advCalibrationMode = true;
+    advLutActive = -1;
     for (int i = 0; i < ADV_SECTORS; i++) {
         advTable[i].rawX = 0;
         advTable[i].rawY = 0;
@@ -73,18 +165,7 @@ static inline void startAdvancedCalibration() {
 
 // **RESETTA ANCHE LA EEPROM** della tabella ADV
 static inline void resetAdvCalibrationEEPROM() {
-    int addr = ADV_EEPROM_ADDR;
-    for (int i = 0; i < ADV_SECTORS; i++) {
-        float zeroF = 0.0f;
-        int zeroI = 0;
-        bool zeroB = false;
-        EEPROM.put(addr, zeroF);      addr += sizeof(float); // rawX
-        EEPROM.put(addr, zeroF);      addr += sizeof(float); // rawY
-        EEPROM.put(addr, zeroF);      addr += sizeof(float); // rawZ
-        EEPROM.put(addr, zeroI);      addr += sizeof(int);   // headingDeg
-        EEPROM.put(addr, zeroB);      addr += sizeof(bool);  // calibrated
-    }
-    EEPROM.commit();
+    cfgErase(CFG_ADV);
     Serial.println("[CAL] ADV Calibration EEPROM cleared");
 }
 
@@ -116,6 +197,7 @@ static inline void updateAdvancedCalibration(float gyroDeg, float compassX, floa
     if (advPointCount >= ADV_SECTORS) {
         advCalibrationMode = false;
         Serial.println("[CAL] Advanced calibration complete");
+        advCompileLut();
     }
 }
 
@@ -126,7 +208,10 @@ static inline bool isAdvancedCalibrationComplete() { return advPointCount >= ADV
 // ---------- APPLICAZIONE DELLA CALIBRAZIONE ----------
 
 // Interpolazione tra i 2 punti 3D più vicini
+// (z non serve alla tabella compilata: resta per la scansione di ripiego)
 static inline int applyAdvCalibrationInterp3D(float x, float y, float z) {
+    float hl = advLutLookup(x, y);
+    if (!isnan(hl)) return (int)lroundf(hl) % 360;
     if (advPointCount < 2) return 0;
 
     int idx1 = -1, idx2 = -1;
@@ -137,7 +222,7 @@ static inline int applyAdvCalibrationInterp3D(float x, float y, float z) {
         float dx = x - advTable[i].rawX;
         float dy = y - advTable[i].rawY;
         float dz = z - advTable[i].rawZ;
-        float dist = sqrt(dx * dx + dy * dy + dz * dz);
+        float dist = sqrtf(dx * dx + dy * dy + dz * dz);
         if (dist < minDist1) {
             minDist2 = minDist1; idx2 = idx1;
             minDist1 = dist;    idx1 = i;
@@ -151,17 +236,43 @@ static inline int applyAdvCalibrationInterp3D(float x, float y, float z) {
     // MEDIA ANGOLARE CIRCOLARE:
     float h1 = advTable[idx1].headingDeg;
     float h2 = advTable[idx2].headingDeg;
-    float sumX = w1 * cos(h1 * M_PI / 180.0f) + w2 * cos(h2 * M_PI / 180.0f);
-    float sumY = w1 * sin(h1 * M_PI / 180.0f) + w2 * sin(h2 * M_PI / 180.0f);
-    float hdg = atan2(sumY, sumX) * 180.0f / M_PI;
-    if (hdg < 0) hdg += 360.0f;
+    float s1, c1, s2, c2;
+    fm_sincos_deg(h1, s1, c1);
+    fm_sincos_deg(h2, s2, c2);
+    float hdg = fm_atan2_deg360(w1 * s1 + w2 * s2, w1 * c1 + w2 * c2);
     return (int)round(hdg);
 }
 
+// Calibrazione avanzata 2D: tabella compilata, altrimenti nearest neighbor
+int applyAdvCalibration(float x, float y) {
+  if (advPointCount == 0) {
+    return (int)lroundf(fm_atan2_deg360(y, x)) % 360;
+  }
+  float hl = advLutLookup(x, y);
+  if (!isnan(hl)) return (int)lroundf(hl) % 360;
+
+  float bestDist = 1e9f;
+  int   bestHeading = 0;
+
+  for (int i = 0; i < advPointCount; ++i) {
+    float dx = x - advTable[i].rawX;
+    float dy = y - advTable[i].rawY;
+    float dist = dx*dx + dy*dy;     // confronto sui quadrati: niente sqrt
+    if (dist < bestDist) {
+      bestDist    = dist;
+      bestHeading = advTable[i].headingDeg;
+    }
+  }
+
+  bestHeading %= 360;
+  if (bestHeading < 0) bestHeading += 360;
+  return bestHeading;
+}
+
 // Versione semplificata per azimuth (solo XY)
 static inline int applyAdvCalibrationInterp2D(float compassDegRaw) {
-    float compassX = cos(compassDegRaw * M_PI / 180.0f);
-    float compassY = sin(compassDegRaw * M_PI / 180.0f);
+    float compassX, compassY;
+    fm_sincos_deg(compassDegRaw, compassY, compassX);
     float compassZ = 0;
     return applyAdvCalibrationInterp3D(compassX, compassY, compassZ);
 }
@@ -169,31 +280,46 @@ static inline int applyAdvCalibrationInterp2D(float compassDegRaw) {
 // ---------- SALVATAGGIO/CARICAMENTO EEPROM ----------
 
 static inline void saveAdvCalibrationToEEPROM() {
-    int addr = ADV_EEPROM_ADDR;
+    cfgStore(CFG_ADV, advTable, sizeof(advTable), ADV_CFG_VER);
+    Serial.println("[ADV] Tabella ADV salvata su EEPROM.");
+}
+
+// Layout a indirizzi fissi (punti da 17 byte da ADV_LEGACY_ADDR). La tabella
+// copriva le credenziali a 512: se quelle sono state scritte dopo, i punti
+// non sono plausibili e la tabella si scarta.
+static inline bool loadAdvLegacy() {
+    int addr = ADV_LEGACY_ADDR;
     for (int i = 0; i < ADV_SECTORS; i++) {
-        EEPROM.put(addr, advTable[i].rawX);      addr += sizeof(float);
-        EEPROM.put(addr, advTable[i].rawY);      addr += sizeof(float);
-        EEPROM.put(addr, advTable[i].rawZ);      addr += sizeof(float);
-        EEPROM.put(addr, advTable[i].headingDeg);addr += sizeof(int);
-        EEPROM.put(addr, advTable[i].calibrated);addr += sizeof(bool);
+        AdvCalPoint& p = advTable[i];
+        int32_t hdg;
+        EEPROM.get(addr, p.rawX); addr += sizeof(float);
+        EEPROM.get(addr, p.rawY); addr += sizeof(float);
+        EEPROM.get(addr, p.rawZ); addr += sizeof(float);
+        EEPROM.get(addr, hdg);    addr += sizeof(int32_t);
+        uint8_t cal = EEPROM.read(addr++);
+        bool sane = cal <= 1 && hdg >= 0 && hdg < 360 &&
+                    fabsf(p.rawX) < 1e4f && fabsf(p.rawY) < 1e4f && fabsf(p.rawZ) < 1e4f;
+        if (!sane) return false;
+        p.headingDeg = hdg;
+        p.calibrated = (cal == 1);
     }
-    EEPROM.commit();
-    Serial.println("[ADV] Tabella ADV salvata su EEPROM.");
+    return true;
 }
 
 static inline void loadAdvCalibrationFromEEPROM() {
-    int addr = ADV_EEPROM_ADDR;
+    bool ok = cfgLoad(CFG_ADV, advTable, sizeof(advTable), ADV_CFG_VER) == CFG_LOAD_OK;
+    if (!ok && cfgLegacy()) ok = loadAdvLegacy();
     advPointCount = 0;
     for (int i = 0; i < ADV_SECTORS; i++) {
-        EEPROM.get(addr, advTable[i].rawX);      addr += sizeof(float);
-        EEPROM.get(addr, advTable[i].rawY);      addr += sizeof(float);
-        EEPROM.get(addr, advTable[i].rawZ);      addr += sizeof(float);
-        EEPROM.get(addr, advTable[i].headingDeg);addr += sizeof(int);
-        EEPROM.get(addr, advTable[i].calibrated);addr += sizeof(bool);
-        if (advTable[i].calibrated) advPointCount++;
+        if (!ok) {
+            advTable[i] = AdvCalPoint{ 0.0f, 0.0f, 0.0f, i * (360 / ADV_SECTORS), false };
+        } else if (advTable[i].calibrated) {
+            advPointCount++;
+        }
     }
     Serial.print("[ADV] Tabella ADV caricata da EEPROM. Punti validi: ");
     Serial.println(advPointCount);
+    advCompileLut();
 }
 
 // ---------- DEBUG ----------
@@ -0,0 +1,181 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// autopilot_autotune.h — autotune a relè ($PEUNO,CMD,CAL=TUNE)
+//
+// Con l'autopilota inserito su una rotta stabile, il task di controllo
+// sostituisce il controllore con un relè con isteresi attorno alla rotta
+// corrente: motore a ±V_max secondo il segno dell'errore sul heading fuso.
+// Barca + attuatore entrano in ciclo limite; da periodo Pu e ampiezza a si
+// ricava il guadagno critico  Ku = 4·d / (π·a)  (d = ampiezza relè in PWM).
+//
+// Dai due numeri si calcolano:
+//   - 3 STATI: T_risposta, E_min, E_max, Deadband (V_min/V_max invariati)
+//   - PID:     PID_Kp, PID_Ki, PID_Kd
+// Il task di controllo pubblica il risultato; loop() lo applica con
+// updateConfig() (stessi slot EEPROM del menu) e lo notifica su WS/UDP.
+// Dal task di controllo niente String né log: motivo del fallimento come
+// letterale (scritto prima di tuneState), ultimo ciclo in tuneLastPu/Amp;
+// i messaggi li compone loop() quando vede cambiare lo stato.
+
+#ifndef AUTOPILOT_AUTOTUNE_H
+#define AUTOPILOT_AUTOTUNE_H
+
+#include <Arduino.h>
+#include <math.h>
+#include "sensor_fusion.h"
+#include "autopilot_control.h"
+
+#define TUNE_HYST_DEG     2.0f     // isteresi del relè (°)
+#define TUNE_SETTLE_MS    3000UL   // motore fermo prima di partire
+#define TUNE_CYCLES       4        // periodi misurati (il primo è scartato)
+#define TUNE_TIMEOUT_MS   600000UL   // 10 min: 5 periodi anche con Pu ~ 1 min
+#define TUNE_ABORT_DEG    60.0f    // scostamento massimo dalla rotta
+
+enum EunoTuneState : uint8_t { TUNE_IDLE = 0, TUNE_SETTLE, TUNE_RELAY, TUNE_DONE, TUNE_FAILED };
+
+struct EunoTuneResult {
+  float Pu  = 0.0f;   // periodo ciclo limite (s)
+  float amp = 0.0f;   // ampiezza (°, picco)
+  float Ku  = 0.0f;   // guadagno critico (PWM/°)
+  int   T_risposta = 0, E_min = 0, E_max = 0, E_tol = 0;
+  int   PID_Kp = 0, PID_Ki = 0, PID_Kd = 0;
+};
+
+static volatile EunoTuneState tuneState = TUNE_IDLE;
+static volatile bool          tuneResultReady = false;
+static EunoTuneResult         tuneResult;
+static const char* volatile   tuneFailReason = "";   // sempre un letterale
+static volatile float         tuneLastPu  = 0.0f;    // ultimo periodo misurato (log)
+static volatile float         tuneLastAmp = 0.0f;
+
+static float         tuneSetpoint = 0.0f;
+static unsigned long tuneStartMs  = 0;
+static int           tuneDir      = 0;       // verso relè corrente (+1/-1)
+static unsigned long tuneLastUpMs = 0;       // ultimo passaggio − → +
+static int           tuneCycles   = 0;       // periodi completi visti
+static float         tuneSumPu    = 0.0f;
+static float         tuneSumAmp   = 0.0f;
+static float         tuneHiDev    = -1e9f;   // picchi del periodo corrente
+static float         tuneLoDev    =  1e9f;
+
+static inline bool autotuneActive(){
+  return tuneState == TUNE_SETTLE || tuneState == TUNE_RELAY;
+}
+
+static inline void autotuneStart(float headingDeg, unsigned long now){
+  tuneSetpoint = headingDeg;
+  tuneStartMs  = now;
+  tuneDir = 0; tuneLastUpMs = 0; tuneCycles = 0;
+  tuneSumPu = tuneSumAmp = 0.0f;
+  tuneHiDev = -1e9f; tuneLoDev = 1e9f;
+  tuneLastPu = tuneLastAmp = 0.0f;
+  tuneResultReady = false;
+  tuneFailReason = "";
+  stopMotor();
+  tuneState = TUNE_SETTLE;
+}
+
+// why: letterale (il puntatore resta valido per loop())
+static inline void autotuneFail(const char* why){
+  stopMotor();
+  tuneFailReason = why;
+  tuneState = TUNE_FAILED;
+  tuneResultReady = true;
+}
+
+static inline void autotuneAbort(){
+  if (autotuneActive()) autotuneFail("ABORT");
+}
+
+// Regole di taratura dai parametri del ciclo limite. Con attuatore che integra,
+// il PWM comanda la velocità del timone: il ciclo è lento (Pu decine di s) e
+// lo smorzamento lo dà il termine sul ROT (vedi autopilot_control.h).
+static inline void autotuneCompute(EunoTuneResult& r){
+  r.Ku = 4.0f * (float)V_max / ((float)M_PI * r.amp);
+
+  // PID (Kp ×10, Ki ×100, Kd ×10)
+  float kp = 0.3f * r.Ku;
+  float kd = kp * r.Pu * 0.5f;
+  float ki = kp / (4.0f * r.Pu);
+  r.PID_Kp = constrain((int)lroundf(kp * 10.0f),  1, 1000);
+  r.PID_Kd = constrain((int)lroundf(kd * 10.0f),  0, 5000);
+  r.PID_Ki = constrain((int)lroundf(ki * 100.0f), 0, 1000);
+
+  // 3 STATI: la velocità di rientro attesa (|e|/T_risposta) segue il periodo;
+  // la rampa E_min..E_max copre l'ampiezza che V_max produce da sola
+  r.T_risposta = constrain((int)lroundf(r.Pu / 3.0f), 3, 12);
+  r.E_tol      = constrain((int)lroundf(r.amp / 20.0f), 1, 5);
+  r.E_min      = constrain((int)lroundf(r.amp / 4.0f), r.E_tol + 1, 30);
+  r.E_max      = constrain((int)lroundf(r.amp * 2.0f), r.E_min + 5, 90);
+}
+
+// Un passo del relè, chiamato dal task di controllo al posto del controllore
+static inline void autotuneStep(unsigned long now){
+  if (!autotuneActive()) return;
+  if (!motorControllerState) { autotuneFail("MOTOR_OFF"); return; }
+  if (now - tuneStartMs > TUNE_TIMEOUT_MS) { autotuneFail("TIMEOUT"); return; }
+
+  float dev = sf_angDiff(getFusedHeading(), tuneSetpoint);   // + = a dritta
+  if (fabsf(dev) > TUNE_ABORT_DEG) { autotuneFail("DEV_LIMIT"); return; }
+
+  if (tuneState == TUNE_SETTLE) {
+    if (now - tuneStartMs < TUNE_SETTLE_MS) return;
+    tuneState = TUNE_RELAY;
+    tuneDir = (dev > 0.0f) ? -1 : 1;
+  }
+
+  if (dev > tuneHiDev) tuneHiDev = dev;
+  if (dev < tuneLoDev) tuneLoDev = dev;
+
+  // relè con isteresi: errore = −dev
+  int dir = tuneDir;
+  if (dev >  TUNE_HYST_DEG) dir = -1;
+  if (dev < -TUNE_HYST_DEG) dir =  1;
+
+  if (dir == 1 && tuneDir == -1) {
+    // passaggio − → +: chiude un periodo
+    if (tuneLastUpMs != 0) {
+      float pu  = (now - tuneLastUpMs) / 1000.0f;
+      float amp = 0.5f * (tuneHiDev - tuneLoDev);
+      tuneCycles++;
+      if (tuneCycles > 1) { tuneSumPu += pu; tuneSumAmp += amp; }
+      tuneLastPu = pu; tuneLastAmp = amp;
+    }
+    tuneLastUpMs = now;
+    tuneHiDev = -1e9f; tuneLoDev = 1e9f;
+  }
+  tuneDir = dir;
+
+  if (tuneCycles >= TUNE_CYCLES + 1) {
+    stopMotor();
+    EunoTuneResult r;
+    r.Pu  = tuneSumPu  / (float)TUNE_CYCLES;
+    r.amp = tuneSumAmp / (float)TUNE_CYCLES;
+    if (r.amp < 0.5f) { autotuneFail("AMP"); return; }
+    autotuneCompute(r);
+    tuneResult = r;
+    tuneState = TUNE_DONE;
+    tuneResultReady = true;
+    return;
+  }
+
+  gestisci_attuatore(dir * V_max);
+}
+
+// Stato per telemetria/UI: "RELAY 2/4", "DONE", ...
+static inline String autotuneStatus(){
+  switch (tuneState) {
+    case TUNE_SETTLE: return "SETTLE";
+    case TUNE_RELAY:  return "RELAY " + String(tuneCycles > 0 ? tuneCycles - 1 : 0) + "/" + String(TUNE_CYCLES);
+    case TUNE_DONE:   return "DONE";
+    case TUNE_FAILED: return String("FAILED ") + tuneFailReason;
+    default:          return "IDLE";
+  }
+}
+
+#endif // AUTOPILOT_AUTOTUNE_H
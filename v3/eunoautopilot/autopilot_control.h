@@ -0,0 +1,307 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// autopilot_control.h — algoritmo autopilota (3 stati) + duty-cycle motore,
+// oppure PID con ROT dal gyro (controlMode = CTRL_MODE_PID).
+// Gira nel task di controllo (vedi euno_scheduler.h), non più in loop().
+
+#ifndef AUTOPILOT_CONTROL_H
+#define AUTOPILOT_CONTROL_H
+
+#include <Arduino.h>
+#include <math.h>
+#include "sensor_fusion.h"
+
+/* ─────────────────────────────────────────────────────────────────────
+   VARIABILI GLOBALI (dichiarate nello sketch .ino)
+   ───────────────────────────────────────────────────────────────────── */
+extern int V_min, V_max, E_min, E_max, E_tol, T_risposta, T_pause;
+extern float errore_precedente;
+
+// Condivise con loop(): comando, sorgente e on/off li scrive loop() (UI,
+// TRACK, WIND, rotta), currentHeading il task di controllo. Parole singole,
+// volatile perché il task le rilegga a ogni passo.
+extern volatile int  headingSourceMode;
+extern volatile int  headingCommand;
+extern volatile int  currentHeading;
+extern volatile bool motorControllerState;
+
+extern unsigned long motorPhaseStartTime;
+extern bool motorPhaseActive;
+extern int  lastErrors[3];
+extern int  erroreIndex;
+extern bool shouldStopMotor;
+
+// Modalità controllore: 0 = 3 STATI (duty 1 s), 1 = PID @ rate del task controllo
+#define CTRL_MODE_3STATE 0
+#define CTRL_MODE_PID    1
+extern int controlMode;
+// Guadagni PID interi (come gli altri parametri, SET/EEPROM):
+//   PID_Kp  PWM per °          ×10
+//   PID_Ki  PWM per (°·s)      ×100
+//   PID_Kd  PWM per (°/s)      ×10
+extern int PID_Kp, PID_Ki, PID_Kd;
+
+int  applyAdvCalibration(float x, float y);   // ADV_CALIBRATION.h
+
+// Attuatore (IBT-2): RPWM=GPIO3 estende, LPWM=GPIO46 ritrae
+#define MOTOR_PIN_EXTEND   3
+#define MOTOR_PIN_RETRACT 46
+
+void extendMotor(int speed) { analogWrite(MOTOR_PIN_EXTEND, speed); analogWrite(MOTOR_PIN_RETRACT, 0); }
+void retractMotor(int speed){ analogWrite(MOTOR_PIN_EXTEND, 0);     analogWrite(MOTOR_PIN_RETRACT, speed); }
+void stopMotor()            { analogWrite(MOTOR_PIN_EXTEND, 0);     analogWrite(MOTOR_PIN_RETRACT, 0); }
+
+// Supporto: differenza circolare  –180 … +180
+int calculateCircularError(int heading, int command) {
+  int diff = (command - heading + 540) % 360 - 180;
+  return diff;
+}
+
+// Supporto: velocità target proporzionale all’errore
+float calcolaVelocitaTarget(float errore) {
+  float absErr = abs(errore);
+  if (absErr <= E_min) return V_min;
+  if (absErr >= E_max) return V_max;
+  return V_min + ((V_max - V_min) * (absErr - E_min)) / (float)(E_max - E_min);
+}
+
+// ### ALGORITMO AUTOPILOTA ###
+int calculateDifference(int heading, int command) {
+  int diff = (command - heading + 360) % 360;
+  if (diff > 180) diff -= 360;
+  return diff;
+}
+
+int calcola_velocita_proporzionale(int errore) {
+  int absErr = abs(errore);
+  if (absErr <= E_min) return V_min;
+  if (absErr >= E_max) return V_max;
+  return V_min + (V_max - V_min) * ((absErr - E_min) / (float)(E_max - E_min));
+}
+
+// Nuova logica a 3 stati – corregge anche con errore negativo
+int calcola_velocita_e_verso(int rotta_attuale, int rotta_desiderata) {
+  float errore = (float)((rotta_desiderata - rotta_attuale + 540) % 360 - 180);
+  float verso  = (errore >= 0.0f) ? 1.0f : -1.0f;
+
+  if (fabs(errore) <= E_tol) {
+    errore_precedente = errore;
+    return 0;
+  }
+
+  float deltaAmp = fabs(errore_precedente) - fabs(errore);
+  errore_precedente = errore;
+
+  float velocita_target = fabs(errore) / (float)T_risposta;
+  float margine = velocita_target * 0.20f;
+  int pwm = abs(calcola_velocita_proporzionale((int)errore));
+
+  if (fabs(deltaAmp - velocita_target) <= margine) {
+    return 0;                 // FERMA
+  } else if (deltaAmp < velocita_target) {
+    return pwm * verso;       // CONTINUA
+  } else {
+    return pwm * -verso;      // INVERTI
+  }
+}
+
+void gestisci_attuatore(int velocita) {
+  if (velocita > 0) extendMotor(velocita);
+  else if (velocita < 0) retractMotor(-velocita);
+  else stopMotor();
+}
+
+// Heading "di controllo" secondo headingSourceMode (prima era nel blocco 1 Hz)
+int getControlHeading() {
+  switch (headingSourceMode) {
+    case 1:  return (int)round(getFusedHeading());
+    case 2:  return (int)round(getExperimentalHeading());
+    case 3:  compass.read(); return applyAdvCalibration(compass.getX(), compass.getY());
+    case 4:  return (int)lroundf(getAhrsHeading()) % 360;
+    default: return getCorrectedHeading();
+  }
+}
+
+// Come sopra ma senza arrotondare al grado dove la sorgente è float (PID)
+float getControlHeadingF() {
+  switch (headingSourceMode) {
+    case 1:  return getFusedHeading();
+    case 2:  return getExperimentalHeading();
+    case 4:  return getAhrsHeading();
+    default: return (float)getControlHeading();
+  }
+}
+
+// Interventi della guardia "errore in calo per 3 cicli": il log lo fa loop(),
+// nel task di controllo niente String né Serial
+static volatile uint32_t dutyGuardStops = 0;
+
+// Controllo motore a duty ciclico: 1 s = fase attiva + T_pause*100 ms di pausa,
+// con guardia "errore in calo per 3 cicli" → stop
+void runMotorDutyCycle(unsigned long now) {
+  if (!motorControllerState) return;
+
+  unsigned long pauseTime  = (unsigned long)T_pause * 100UL;
+  unsigned long activeTime = 1000UL - pauseTime;
+  if (activeTime < 200UL) activeTime = 200UL;
+
+  if (motorPhaseActive) {
+    if (now - motorPhaseStartTime >= activeTime) {
+      stopMotor();
+      motorPhaseActive = false;
+      motorPhaseStartTime = now;
+    }
+    return;
+  }
+
+  if (now - motorPhaseStartTime < pauseTime) return;
+
+  int errore = abs(calculateDifference(currentHeading, headingCommand));
+
+  lastErrors[erroreIndex % 3] = errore;
+  erroreIndex++;
+
+  if (erroreIndex >= 3) {
+    int e0 = lastErrors[(erroreIndex - 3) % 3];
+    int e1 = lastErrors[(erroreIndex - 2) % 3];
+    int e2 = lastErrors[(erroreIndex - 1) % 3];
+
+    if (e2 < e1 && e1 < e0) {
+      shouldStopMotor = true;
+      dutyGuardStops++;
+    } else {
+      shouldStopMotor = false;
+    }
+  }
+
+  if (shouldStopMotor) {
+    stopMotor();
+    motorPhaseActive = false;
+    motorPhaseStartTime = now;
+  } else {
+    int velocita_correzione = calcola_velocita_e_verso(currentHeading, headingCommand);
+    gestisci_attuatore(velocita_correzione);
+    motorPhaseActive = true;
+    motorPhaseStartTime = now;
+  }
+}
+
+/* ─────────────────────────────────────────────────────────────────────
+   PID con ROT gyro come termine D
+   u = Kp·e + Ki·∫e − Kd·r     (e = comando − heading, r = rateOfTurn)
+   Derivata sulla misura: niente calcio sul cambio di rotta e niente
+   differenza di heading interi. L'attuatore integra (PWM = velocità timone),
+   quindi u è un comando di velocità: Kd sul ROT fa da "proporzionale" sul
+   timone e domina (default Kp=40, Ki=2, Kd=800, vedi host/euno_sim).
+   |u| < V_min/2 → fermo, altrimenti |u| limitato a V_min..V_max.
+   Anti-windup: integrale bloccato quando l'uscita è satura nello stesso
+   verso dell'errore, e limitato a ±V_max.
+   Guadagni schedulati sulla SOG filtrata (gps_motion.h): il timone rende
+   di più con la velocità, quindi Kp e Kd scalano con CTRL_SPEED_REF_KN / v
+   entro CTRL_SPEED_GAIN_MIN..MAX. Senza stima di velocità: fattore 1.
+   ───────────────────────────────────────────────────────────────────── */
+#define CTRL_SPEED_REF_KN    5.0f    // velocità a cui valgono i guadagni impostati
+#define CTRL_SPEED_GAIN_MIN  0.6f
+#define CTRL_SPEED_GAIN_MAX  1.5f
+
+static float         pidIntegral = 0.0f;   // ∫e dt (°·s)
+static float         pidRateF    = 0.0f;   // ROT filtrato (°/s)
+static unsigned long pidLastMs   = 0;
+static int           pidOut      = 0;      // ultimo comando (telemetria)
+
+void resetPidState() {
+  pidIntegral = 0.0f;
+  pidRateF    = 0.0f;
+  pidLastMs   = 0;
+  pidOut      = 0;
+}
+
+static inline float pidSpeedGain() {
+  EunoGpsMotion m = gpsMotionGet();
+  if (!m.valid || m.sogKn < 0.1f) return 1.0f;
+  return constrain(CTRL_SPEED_REF_KN / m.sogKn, CTRL_SPEED_GAIN_MIN, CTRL_SPEED_GAIN_MAX);
+}
+
+void runPidControl(float headingDeg, unsigned long now) {
+  if (!motorControllerState) { resetPidState(); return; }
+
+  float dt = pidLastMs ? (now - pidLastMs) / 1000.0f : 0.0f;
+  pidLastMs = now;
+  if (dt <= 0.0f || dt > 0.5f) dt = 0.05f;
+
+  float e = sf_angDiff((float)headingCommand, headingDeg);
+  if (fabsf(e) <= (float)E_tol) e = 0.0f;
+
+  pidRateF += 0.5f * (getRateOfTurn() - pidRateF);
+
+  float gs = pidSpeedGain();
+  float kp = PID_Kp * 0.1f * gs, ki = PID_Ki * 0.01f, kd = PID_Kd * 0.1f * gs;
+  float uNoI = kp * e - kd * pidRateF;
+  float u    = uNoI + ki * pidIntegral;
+
+  bool sat = fabsf(u) >= (float)V_max;
+  if (!(sat && (u > 0.0f) == (e > 0.0f))) {
+    pidIntegral += e * dt;
+    if (ki > 0.0f) {
+      float iMax = (float)V_max / ki;
+      pidIntegral = constrain(pidIntegral, -iMax, iMax);
+    } else {
+      pidIntegral = 0.0f;
+    }
+    u = uNoI + ki * pidIntegral;
+  }
+
+  float mag = fabsf(u);
+  int pwm = 0;
+  if (mag >= V_min * 0.5f) pwm = (int)constrain(mag, (float)V_min, (float)V_max);
+  pidOut = (u >= 0.0f) ? pwm : -pwm;
+  gestisci_attuatore(pidOut);
+}
+
+// Cambio algoritmo (SET:CTRL_MODE da loop()): controlMode è il valore
+// configurato (EEPROM, telemetria), ctrlModeRun quello che il task esegue.
+// Il reset dello stato (motore fermo, fase 3 stati, integrale PID) lo fa il
+// task di controllo al passo successivo, come autotune e jog: loop() non
+// tocca mai lo stato del controllore mentre il task lo sta usando.
+static volatile bool ctrlModeReq = true;   // al primo passo: prende controlMode
+static int           ctrlModeRun = CTRL_MODE_3STATE;
+
+void controlModeRequest(int mode) {
+  controlMode = mode;
+  ctrlModeReq = true;
+}
+
+// Motore comandato adesso: fase attiva del 3 stati o uscita PID non nulla
+// (cfgService() rimanda il commit EEPROM, che ferma il task di controllo)
+static inline bool controlMotorBusy() {
+  if (!motorControllerState) return false;
+  return ctrlModeRun == CTRL_MODE_PID ? pidOut != 0 : motorPhaseActive;
+}
+
+// Passo del task di controllo: 3 stati a duty 1 s oppure PID ad ogni tick
+void runAutopilotControl(unsigned long now) {
+  if (ctrlModeReq) {
+    // riparti da fermo con stato pulito
+    ctrlModeReq = false;
+    stopMotor();
+    motorPhaseActive = false;
+    shouldStopMotor = false;
+    resetPidState();
+    ctrlModeRun = controlMode;
+  }
+  if (ctrlModeRun == CTRL_MODE_PID) {
+    float h = getControlHeadingF();
+    currentHeading = ((int)lroundf(h)) % 360;
+    runPidControl(h, now);
+  } else {
+    currentHeading = getControlHeading();
+    runMotorDutyCycle(now);
+  }
+}
+
+#endif // AUTOPILOT_CONTROL_H
@@ -44,6 +44,8 @@ public:
   }
 
   void loop() {
+    if (!started) return;   // begin() arriva dopo la rete (avvio a fasi)
+
     // Avvia la scansione UNA SOLA VOLTA in modo ASINCRONO (non blocca)
     if (!connected && !scanning && !hasPending) {
       scanning = true;
@@ -9,6 +9,11 @@
 #define CALIBRATION_H
 
 #include "icm_compass.h"
+#include "euno_fastmath.h"
+#include "sensor_ahrs.h"
+#include "mag_ellipsoid.h"
+#include "compass_deviation.h"
+#include "euno_config.h"
 #include <EEPROM.h>
 #include <math.h>
 #include <stdint.h>
@@ -45,19 +50,48 @@ extern bool calibrationMode;
 extern unsigned long calibrationStartTime;
 extern float minX, minY, minZ;
 extern float maxX, maxY, maxZ;
-extern int16_t compassOffsetX, compassOffsetY, compassOffsetZ;  // EEPROM @0..5
+extern int16_t compassOffsetX, compassOffsetY, compassOffsetZ;  // record CFG_COMPASS
 extern ICMCompass compass;
-extern bool motorControllerState;
-extern int headingOffset;  // EEPROM @6..7 (offset software C-GPS)
+extern volatile bool motorControllerState;
+extern int headingOffset;  // record CFG_COMPASS (offset software C-GPS)
+
+/* ─────────────────────────────────────────────────────────────────────
+   FIT A ELLISSOIDE (CAL=MAG)
+   ───────────────────────────────────────────────────────────────────── */
+#define MAGCAL_CFG_VER     1
+
+// Record CFG_COMPASS: offset interi (C-GPS/ADV) + offset software
+struct EunoCompassCfg {
+  int16_t offX, offY, offZ;
+  int16_t headingOffset;
+};
+#define COMPASS_CFG_VER 1
+CFG_ASSERT_FITS(CFG_COMPASS, EunoCompassCfg);
+CFG_ASSERT_FITS(CFG_MAGCAL, EunoMagCal);
+CFG_ASSERT_FITS(CFG_DEVIATION, EunoDeviation);
+
+enum MagCalState : uint8_t { MAGCAL_IDLE = 0, MAGCAL_RUN, MAGCAL_DONE, MAGCAL_FAILED };
+
+static MagEllipsoidFit   magFit;             // accumulatori della finestra in corso
+static EunoMagCal        magCal;             // risultato attivo (EEPROM)
+static volatile MagCalState magCalState = MAGCAL_IDLE;
 
 /* ─────────────────────────────────────────────────────────────────────
    PROTOTIPI
    ───────────────────────────────────────────────────────────────────── */
 void resetCalibrationData();
 void performCalibration(unsigned long currentMillis);
+void loadCompassFromEEPROM();
+void saveCompassToEEPROM();
+void loadMagCalFromEEPROM();
+void saveMagCalToEEPROM();
+void loadDeviationFromEEPROM();
+void saveDeviationToEEPROM();
 int  getCorrectedHeading();
+void getCalibratedMag(float &mx, float &my, float &mz);
 
 inline void getTiltAngles(float &pitch, float &roll);
+inline void getTiltSinCos(float &sp, float &cp, float &sr, float &cr);
 inline float compensateTilt(float mx, float my, float mz, float pitch, float roll);
 
 /* ─────────────────────────────────────────────────────────────────────
@@ -66,6 +100,27 @@ inline float compensateTilt(float mx, float my, float mz, float pitch, float rol
 static inline float wrap360(float a){ a = fmodf(a,360.0f); if(a<0)a+=360.0f; return a; }
 static inline float angdiff(float a, float b){ return fmodf((a-b+540.0f),360.0f)-180.0f; }
 
+/* ─────────────────────────────────────────────────────────────────────
+   CURVA DI DEVIAZIONE (compass_deviation.h)
+   - compassHeadingRaw: ultimo heading pubblicato SENZA curva (serve al
+     learner, che confronta col COG)
+   ───────────────────────────────────────────────────────────────────── */
+static volatile float compassHeadingRaw = NAN;
+
+static inline float compassApplyDeviation(float rawDeg){
+  compassHeadingRaw = rawDeg;
+  return wrap360(rawDeg + devCorrectionDeg(rawDeg - (float)headingOffset));
+}
+
+void loadDeviationFromEEPROM() {
+  if (cfgLoad(CFG_DEVIATION, &devModel, sizeof(devModel), DEV_CFG_VER) == CFG_LOAD_OK) return;
+  devModel.reset();   // il layout a indirizzi fissi non aveva la curva
+}
+
+void saveDeviationToEEPROM() {
+  cfgStore(CFG_DEVIATION, &devModel, sizeof(devModel), DEV_CFG_VER);
+}
+
 /* ─────────────────────────────────────────────────────────────────────
    CALIBRAZIONE: reset min/max per hard-iron
    ───────────────────────────────────────────────────────────────────── */
@@ -74,12 +129,16 @@ unsigned long lastCalibrationLogTime = 0;
 void resetCalibrationData() {
   minX =  32767.0f; minY =  32767.0f; minZ =  32767.0f;
   maxX = -32768.0f; maxY = -32768.0f; maxZ = -32768.0f;
+  magFit.reset();
+  magCalState = MAGCAL_RUN;
   Serial.println("DEBUG: Calibration data reset");
 }
 
 /*
-  Calibrazione hard-iron: raccoglie min/max XYZ per ~20 s.
-  Alla fine salva offset X/Y/Z in EEPROM (int16_t) @0..5.
+  Calibrazione hard/soft-iron: ~20 s di campioni nel fit a ellissoide
+  (mag_ellipsoid.h, solo accumulatori). Alla fine salva offset + matrice W
+  (CFG_MAGCAL) e gli offset interi X/Y/Z (CFG_COMPASS, usati da C-GPS/ADV).
+  Se il fit non converge restano gli offset da min/max (filtrati col mediano).
 */
 void performCalibration(unsigned long currentMillis) {
   if (motorControllerState) {
@@ -93,9 +152,11 @@ void performCalibration(unsigned long currentMillis) {
     float y = compass.getY();
     float z = compass.getZ();
 
-    if (x < minX) minX = x; if (x > maxX) maxX = x;
-    if (y < minY) minY = y; if (y > maxY) maxY = y;
-    if (z < minZ) minZ = z; if (z > maxZ) maxZ = z;
+    if (magFit.add(x, y, z)) {
+      minX = magFit.minAxis(0); maxX = magFit.maxAxis(0);
+      minY = magFit.minAxis(1); maxY = magFit.maxAxis(1);
+      minZ = magFit.minAxis(2); maxZ = magFit.maxAxis(2);
+    }
 
     if (currentMillis - lastCalibrationLogTime > 500UL) {
       lastCalibrationLogTime = currentMillis;
@@ -105,25 +166,67 @@ void performCalibration(unsigned long currentMillis) {
   } else {
     calibrationMode = false;
 
-    // Hard-iron offsets
-    float offXf = 0.5f * (maxX + minX);
-    float offYf = 0.5f * (maxY + minY);
-    float offZf = 0.5f * (maxZ + minZ);
-
-    compassOffsetX = (int16_t)lroundf(offXf);
-    compassOffsetY = (int16_t)lroundf(offYf);
-    compassOffsetZ = (int16_t)lroundf(offZf);
+    EunoMagCal fit;
+    float zPrior = magCal.valid() ? magCal.off[2] : (float)compassOffsetZ;
+    if (magFit.solve(fit, zPrior)) {
+      magCal = fit;
+      magCalState = MAGCAL_DONE;
+      compassOffsetX = (int16_t)lroundf(fit.off[0]);
+      compassOffsetY = (int16_t)lroundf(fit.off[1]);
+      compassOffsetZ = (int16_t)lroundf(fit.off[2]);
+      Serial.printf("DEBUG: Ellipsoid fit %dD, n=%u, fit=%.2f%%, off=(%.2f, %.2f, %.2f)\n",
+                    fit.mode, (unsigned)magFit.count(), fit.fitPct, fit.off[0], fit.off[1], fit.off[2]);
+    } else {
+      // fallback: hard-iron da min/max come prima
+      magCal = EunoMagCal();
+      magCal.fitPct = fit.fitPct;
+      magCalState = MAGCAL_FAILED;
+      compassOffsetX = (int16_t)lroundf(0.5f * (maxX + minX));
+      compassOffsetY = (int16_t)lroundf(0.5f * (maxY + minY));
+      compassOffsetZ = (int16_t)lroundf(0.5f * (maxZ + minZ));
+      Serial.printf("DEBUG: Ellipsoid fit rejected (n=%u), min/max offsets\n", (unsigned)magFit.count());
+    }
 
-    EEPROM.put<int16_t>(0, compassOffsetX);
-    EEPROM.put<int16_t>(2, compassOffsetY);
-    EEPROM.put<int16_t>(4, compassOffsetZ);
-    EEPROM.commit();
-    delay(100);
+    saveCompassToEEPROM();
+    saveMagCalToEEPROM();
 
     Serial.println("DEBUG: Calibration complete and offsets saved.");
   }
 }
 
+void loadCompassFromEEPROM() {
+  EunoCompassCfg c;
+  if (cfgLoad(CFG_COMPASS, &c, sizeof(c), COMPASS_CFG_VER) == CFG_LOAD_OK) {
+    compassOffsetX = c.offX; compassOffsetY = c.offY; compassOffsetZ = c.offZ;
+    headingOffset  = c.headingOffset;
+  } else if (cfgLegacy()) {
+    EEPROM.get<int16_t>(0, compassOffsetX);
+    EEPROM.get<int16_t>(2, compassOffsetY);
+    EEPROM.get<int16_t>(4, compassOffsetZ);
+    uint16_t ho = 0; EEPROM.get(6, ho);
+    headingOffset = (ho == 0xFFFF) ? 0 : ho;   // 0xFFFF = mai scritto
+  } else {
+    compassOffsetX = compassOffsetY = compassOffsetZ = 0;
+    headingOffset = 0;
+  }
+  if (headingOffset < 0 || headingOffset >= 360) headingOffset = 0;
+}
+
+void saveCompassToEEPROM() {
+  EunoCompassCfg c = { compassOffsetX, compassOffsetY, compassOffsetZ, (int16_t)headingOffset };
+  cfgStore(CFG_COMPASS, &c, sizeof(c), COMPASS_CFG_VER);
+}
+
+void loadMagCalFromEEPROM() {
+  // il layout a indirizzi fissi non aveva il fit: senza record, offset interi
+  if (cfgLoad(CFG_MAGCAL, &magCal, sizeof(magCal), MAGCAL_CFG_VER) != CFG_LOAD_OK || !magCal.valid())
+    magCal = EunoMagCal();
+}
+
+void saveMagCalToEEPROM() {
+  cfgStore(CFG_MAGCAL, &magCal, sizeof(magCal), MAGCAL_CFG_VER);
+}
+
 /* ─────────────────────────────────────────────────────────────────────
    CORREZIONI “SOFT-IRON” da min/max (scale per assi)
    - opzionale: normalizza le scale X/Y/Z per rendere l’ellissoide ≈ cerchio
@@ -143,11 +246,26 @@ static inline void applySoftIron(float &mx, float &my, float &mz){
 #endif
 }
 
+// Campo magnetico (µT) con hard-iron e soft-iron applicati: lo usano la
+// bussola qui sotto e l'AHRS (sensor_fusion.h)
+void getCalibratedMag(float &mx, float &my, float &mz) {
+  compass.read();
+  if (magCal.valid()) {
+    mx = compass.getX(); my = compass.getY(); mz = compass.getZ();
+    magCal.apply(mx, my, mz);
+    return;
+  }
+  mx = compass.getX() - (float)compassOffsetX;
+  my = compass.getY() - (float)compassOffsetY;
+  mz = compass.getZ() - (float)compassOffsetZ;
+  applySoftIron(mx, my, mz);
+}
+
 /* ─────────────────────────────────────────────────────────────────────
    HEADING COMPASS CORRETTO
    - Legge ICM, applica hard/soft iron, compensazione tilt (se abilitata),
      converte in convenzione bussola (0°=Nord, 90°=Est, CW),
-     media vettoriale su finestra COMPASS_PUB_MS
+     media vettoriale su finestra COMPASS_PUB_MS, curva di deviazione
    ───────────────────────────────────────────────────────────────────── */
 int getCorrectedHeading() {
   static float sumCos = 0.0f;
@@ -158,30 +276,28 @@ int getCorrectedHeading() {
   static int lastOutputDeg = 0;
   static bool initialized = false;
 
-  // 1) Lettura sensore + hard-iron
-  compass.read();
-  float mx = compass.getX() - (float)compassOffsetX;
-  float my = compass.getY() - (float)compassOffsetY;
-  float mz = compass.getZ() - (float)compassOffsetZ;
+  // Stato statico condiviso tra task di controllo e loop(): serializza
+  ICMLock guard(compass);
 
-  // 2) Soft-iron (opzionale)
-  applySoftIron(mx, my, mz);
+  // 1-2) Lettura sensore + hard-iron + soft-iron (opzionale)
+  float mx, my, mz;
+  getCalibratedMag(mx, my, mz);
 
   // 3) Tilt compensation (opzionale)
   float headingRadMath; // heading matematico: 0=asse X (Est), CCW+
 #if COMPASS_USE_TILT
-  float pitch, roll;
-  getTiltAngles(pitch, roll);
+  float sp, cp, sr, cr;
+  getTiltSinCos(sp, cp, sr, cr);
   // proietta nel piano orizzontale
-  float xh = mx * cosf(pitch) + mz * sinf(pitch);
-  float yh = mx * sinf(roll) * sinf(pitch) + my * cosf(roll) - mz * cosf(pitch) * sinf(roll);
-  headingRadMath = atan2f(yh, xh);
+  float xh = mx * cp + mz * sp;
+  float yh = mx * sr * sp + my * cr - mz * cp * sr;
+  headingRadMath = fm_atan2(yh, xh);
 #else
-  headingRadMath = atan2f(my, mx);
+  headingRadMath = fm_atan2(my, mx);
 #endif
 
   // 4) Converti in convenzione bussola (0=N, 90=E, orario)
-  float headingDegMath = headingRadMath * 180.0f / (float)M_PI; // 0=Est, CCW+
+  float headingDegMath = headingRadMath * FM_RAD2DEG; // 0=Est, CCW+
   if (headingDegMath < 0.0f) headingDegMath += 360.0f;
 
   // Compass: 0=N (90° a Est), CW+  ->  headingCW = (90 - headingMath) mod 360
@@ -201,9 +317,10 @@ int getCorrectedHeading() {
   bool reject = (xyMean < COMPASS_MIN_XY_uT && absmz > COMPASS_Z_REJ_RATIO * fmaxf(COMPASS_MIN_XY_uT, xyMean));
 
   if (!reject) {
-    float hRad = headingCW * (float)M_PI / 180.0f;
-    sumCos += cosf(hRad);
-    sumSin += sinf(hRad);
+    float s, c;
+    fm_sincos_deg(headingCW, s, c);
+    sumCos += c;
+    sumSin += s;
     sampleCount++;
   }
 
@@ -212,8 +329,7 @@ int getCorrectedHeading() {
   // 6) Primo output: evita valori casuali
   if (!initialized) {
     if (sampleCount >= 3) { // attendo almeno 3 campioni
-      float avgRad = atan2f(sumSin, sumCos);
-      float avgDeg = wrap360(avgRad * 180.0f / (float)M_PI);
+      float avgDeg = compassApplyDeviation(fm_atan2_deg360(sumSin, sumCos));
 
       // low-pass opzionale
       if (COMPASS_SMOOTH_ALPHA > 0.0f) {
@@ -229,15 +345,14 @@ int getCorrectedHeading() {
       return lastOutputDeg;
     } else {
       // Finché non ho abbastanza campioni, restituisco l’istante (meno stabile)
-      return (int)lroundf(headingCW);
+      return (int)lroundf(compassApplyDeviation(headingCW)) % 360;
     }
   }
 
   // 7) Pubblica ogni COMPASS_PUB_MS con media vettoriale
   if (now - lastPublish >= COMPASS_PUB_MS) {
     if (sampleCount > 0) {
-      float avgRad = atan2f(sumSin, sumCos);
-      float avgDeg = wrap360(avgRad * 180.0f / (float)M_PI);
+      float avgDeg = compassApplyDeviation(fm_atan2_deg360(sumSin, sumCos));
 
       if (COMPASS_SMOOTH_ALPHA > 0.0f) {
         lastOutputDeg = (int)lroundf(wrap360(COMPASS_SMOOTH_ALPHA * avgDeg +
@@ -247,7 +362,7 @@ int getCorrectedHeading() {
       }
     } else {
       // Nessun campione valido → fai pass-through dell’ultimo istante letto
-      lastOutputDeg = (int)lroundf(headingCW);
+      lastOutputDeg = (int)lroundf(compassApplyDeviation(headingCW)) % 360;
     }
     sumCos = 0.0f; sumSin = 0.0f; sampleCount = 0;
     lastPublish = now;
@@ -259,19 +374,47 @@ int getCorrectedHeading() {
 /* ─────────────────────────────────────────────────────────────────────
    Tilt helpers
    ───────────────────────────────────────────────────────────────────── */
-inline void getTiltAngles(float &pitch, float &roll) {
+// Verticale negli assi del sensore: dall'AHRS quando è a regime (niente
+// accelerazioni di onda/accostata), altrimenti dall'accelerometro grezzo
+static inline bool getTiltGravity(float &ax, float &ay, float &az) {
+  if (ahrs.ready()) { ahrsUpSensor(ax, ay, az); return true; }
   sensors_event_t acc;
-  if (compass.getAccelEvent(acc)) {
+  if (!compass.getAccelEvent(acc)) return false;
+  ax = acc.acceleration.x; ay = acc.acceleration.y; az = acc.acceleration.z;
+  return true;
+}
+
+inline void getTiltAngles(float &pitch, float &roll) {
+  float ax, ay, az;
+  if (getTiltGravity(ax, ay, az)) {
     // NB: formula in convenzione classica per ICM20948/Adafruit
-    pitch = atan2f(-acc.acceleration.x,
-                   sqrtf(acc.acceleration.y*acc.acceleration.y + acc.acceleration.z*acc.acceleration.z));
-    roll  = atan2f(acc.acceleration.y, acc.acceleration.z);
+    pitch = fm_atan2(-ax, sqrtf(ay*ay + az*az));
+    roll  = fm_atan2(ay, az);
   } else {
     pitch = 0.0f;
     roll  = 0.0f;
   }
 }
 
+// Seno/coseno di pitch e roll direttamente dal vettore verticale, senza
+// passare dagli angoli (stessa convenzione di getTiltAngles): 2 sqrt invece
+// di 2 atan2 + sqrt + 4 sin/cos
+inline void getTiltSinCos(float &sp, float &cp, float &sr, float &cr) {
+  float ax, ay, az;
+  if (getTiltGravity(ax, ay, az)) {
+    float yz2 = ay*ay + az*az;
+    float n2  = yz2 + ax*ax;
+    if (yz2 > 1e-6f) {
+      float rYZ = 1.0f / sqrtf(yz2);
+      float rN  = 1.0f / sqrtf(n2);
+      sr = ay * rYZ;          cr = az * rYZ;
+      sp = -ax * rN;          cp = yz2 * rYZ * rN;
+      return;
+    }
+  }
+  sp = 0.0f; cp = 1.0f; sr = 0.0f; cr = 1.0f;
+}
+
 // Mantengo per compatibilità, ma NON usata direttamente nel nuovo flusso
 inline float compensateTilt(float mx, float my, float mz, float pitch, float roll) {
   float xh = mx * cosf(pitch) + mz * sinf(pitch);
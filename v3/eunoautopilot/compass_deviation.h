@@ -0,0 +1,189 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// compass_deviation.h — curva di deviazione a serie di Fourier, appresa dal COG
+//
+//   dev(θ) = A + B·sinθ + C·cosθ + D·sin2θ + E·cos2θ        (gradi)
+//
+// θ è l'heading bussola senza offset C-GPS. È la classica curva di deviazione:
+// 1ª armonica = ferro duro residuo, 2ª = ferro dolce residuo. A raccoglie
+// tutto ciò che è costante tra bussola e COG (declinazione, scarroccio medio,
+// resto dell'offset C-GPS).
+// I coefficienti si stimano online ai minimi quadrati ricorsivi (RLS) sul
+// residuo COG − heading, solo a velocità sufficiente e in rotta stabile (vedi
+// EunoDevLearner). Con fattore d'oblio la curva segue i cambi di ferro a bordo.
+// Stato in EEPROM (record CFG_DEVIATION): 5 coefficienti + covarianza 5×5
+// (128 byte) al posto dei 1224 della tabella ADV; la covarianza serve perché
+// al riavvio le armoniche già apprese non vengano riscritte dalla prima rotta.
+// Valutazione: 1 sincos + 5 moltiplicazioni-somme.
+
+#ifndef COMPASS_DEVIATION_H
+#define COMPASS_DEVIATION_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "euno_fastmath.h"
+
+#define DEV_MAGIC        0xDE71u
+#define DEV_CFG_VER      1          // record CFG_DEVIATION (euno_config.h)
+#define DEV_LAMBDA       0.9995f    // oblio per campione (~30 min di memoria a 1 Hz)
+#define DEV_P0           100.0f     // varianza iniziale coefficienti (°²)
+#define DEV_P_TRACE_MAX  (5.0f * DEV_P0)   // oltre, niente oblio (rotta fissa per ore)
+#define DEV_MIN_SAMPLES  30         // campioni prima di applicare la curva
+#define DEV_MAX_GAP_OCT  2          // ...e nessun arco di rotte mai viste > 2 ottanti (90°)
+#define DEV_MAX_DEG      30.0f      // limite della correzione applicata
+
+// Condizioni di apprendimento
+#define DEV_MIN_SOG_KN   3.0f       // sotto, il COG è rumoroso e lo scarroccio pesa
+#define DEV_MAX_ROT_DPS  2.0f       // rateo di accostata massimo
+#define DEV_STEADY_MS    10000UL    // rotta stabile da almeno...
+#define DEV_STEADY_DEG   5.0f       // ...entro ± questi gradi (COG e bussola)
+#define DEV_GATE_DEG     20.0f      // residuo oltre la curva attuale: scartato
+#define DEV_FEED_MS      1000UL     // un campione al secondo
+#define DEV_GPS_AGE_MS   2000UL
+#define DEV_SAVE_MS      600000UL   // EEPROM al massimo ogni 10 min
+
+static inline float dev_wrap180(float a){
+  a = fmodf(a + 180.0f, 360.0f);
+  if (a < 0.0f) a += 360.0f;
+  return a - 180.0f;
+}
+
+struct EunoDeviation {
+  uint16_t magic = 0;
+  uint16_t cover = 0;          // bit i = ottante di θ [45·i, 45·i+45) visitato
+  uint32_t n     = 0;          // campioni accettati
+  float    c[5]  = {0, 0, 0, 0, 0};
+  float    P[5][5];
+
+  EunoDeviation(){ reset(); }
+
+  void reset(){
+    magic = DEV_MAGIC; n = 0; cover = 0;
+    for (int i = 0; i < 5; i++) {
+      c[i] = 0.0f;
+      for (int j = 0; j < 5; j++) P[i][j] = (i == j) ? DEV_P0 : 0.0f;
+    }
+  }
+
+  bool valid() const { return magic == DEV_MAGIC; }
+  int octants() const {
+    int k = 0;
+    for (int i = 0; i < 8; i++) k += (cover >> i) & 1;
+    return k;
+  }
+  // arco più lungo di ottanti consecutivi non visitati (circolare)
+  int maxGap() const {
+    int best = 0, run = 0;
+    for (int i = 0; i < 16; i++) {
+      if ((cover >> (i & 7)) & 1) run = 0;
+      else if (++run > best) best = run;
+    }
+    return best > 8 ? 8 : best;
+  }
+  // Con rotte su mezzo giro le armoniche spiegano i dati visti ma sbagliano
+  // altrove (anche di 10°): la curva si applica solo col giro coperto
+  bool ready() const { return valid() && n >= DEV_MIN_SAMPLES && maxGap() <= DEV_MAX_GAP_OCT; }
+
+  static void regressors(float thetaDeg, float phi[5]){
+    float s, co;
+    fm_sincos_deg(thetaDeg, s, co);
+    phi[0] = 1.0f;
+    phi[1] = s;
+    phi[2] = co;
+    phi[3] = 2.0f * s * co;          // sin2θ
+    phi[4] = co * co - s * s;        // cos2θ
+  }
+
+  float eval(float thetaDeg) const {
+    float phi[5]; regressors(thetaDeg, phi);
+    return c[0] + c[1]*phi[1] + c[2]*phi[2] + c[3]*phi[3] + c[4]*phi[4];
+  }
+
+  // Un passo RLS: y = deviazione osservata (COG − heading bussola) a θ
+  void update(float thetaDeg, float y){
+    float phi[5]; regressors(thetaDeg, phi);
+    float Pphi[5];
+    float den = 0.0f, tr = 0.0f;
+    for (int i = 0; i < 5; i++) {
+      float a = 0.0f;
+      for (int j = 0; j < 5; j++) a += P[i][j] * phi[j];
+      Pphi[i] = a;
+      den += phi[i] * a;
+      tr  += P[i][i];
+    }
+    // covarianza già ampia (direzioni non eccitate): oblio sospeso
+    float lam = (tr < DEV_P_TRACE_MAX) ? DEV_LAMBDA : 1.0f;
+    den += lam;
+    float e = dev_wrap180(y - eval(thetaDeg));
+    float rl = 1.0f / lam;
+    for (int i = 0; i < 5; i++) {
+      float k = Pphi[i] / den;
+      c[i] += k * e;
+      for (int j = i; j < 5; j++) {
+        float v = (P[i][j] - k * Pphi[j]) * rl;
+        P[i][j] = v; P[j][i] = v;    // simmetria esplicita (float)
+      }
+    }
+    c[0] = dev_wrap180(c[0]);
+    int oct = (int)(thetaDeg * (1.0f / 45.0f)) & 7;
+    cover |= (uint16_t)(1u << oct);
+    n++;
+  }
+};
+
+// Sceglie i campioni: SOG minima, niente accostata, rotta stabile da
+// DEV_STEADY_MS sia al COG sia in bussola (esclude i transitori in cui COG e
+// prua divergono), un campione ogni DEV_FEED_MS. Nessuna dipendenza dal GPS:
+// i valori arrivano dal chiamante.
+struct EunoDevLearner {
+  uint32_t steadySince = 0, lastFeed = 0;
+  float    refCog = NAN, refHdg = NAN;
+  uint32_t rejects = 0;
+
+  void restart(uint32_t ms, float cog, float hdg){
+    steadySince = ms; refCog = cog; refHdg = hdg;
+  }
+
+  // true se il campione è stato usato. hdg = bussola senza curva, θ senza offset
+  bool step(EunoDeviation& dev, uint32_t ms, bool gpsOk, float cog, float sogKn,
+            float hdg, float thetaDeg, float rotDps){
+    if (!gpsOk || sogKn < DEV_MIN_SOG_KN || fabsf(rotDps) > DEV_MAX_ROT_DPS) {
+      refCog = NAN;
+      return false;
+    }
+    if (isnan(refCog) ||
+        fabsf(dev_wrap180(cog - refCog)) > DEV_STEADY_DEG ||
+        fabsf(dev_wrap180(hdg - refHdg)) > DEV_STEADY_DEG) {
+      restart(ms, cog, hdg);
+      return false;
+    }
+    if (ms - steadySince < DEV_STEADY_MS || ms - lastFeed < DEV_FEED_MS) return false;
+    lastFeed = ms;
+
+    float y = dev_wrap180(cog - hdg);
+    if (dev.ready() && fabsf(dev_wrap180(y - dev.eval(thetaDeg))) > DEV_GATE_DEG) {
+      rejects++;
+      return false;
+    }
+    dev.update(thetaDeg, y);
+    return true;
+  }
+};
+
+static EunoDeviation  devModel;     // curva attiva (EEPROM)
+static EunoDevLearner devLearner;   // gira in loop(), dove arriva il GPS
+
+// Correzione da sommare all'heading bussola (θ senza offset C-GPS), gradi
+static inline float devCorrectionDeg(float thetaDeg){
+  if (!devModel.ready()) return 0.0f;
+  float d = devModel.eval(thetaDeg);
+  return (d > DEV_MAX_DEG) ? DEV_MAX_DEG : (d < -DEV_MAX_DEG ? -DEV_MAX_DEG : d);
+}
+
+#endif // COMPASS_DEVIATION_H
@@ -0,0 +1,75 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// euno_boot.h — tempi delle fasi di avvio (ms da reset, millis())
+//
+// setup() porta su solo sensori, configurazione e task di controllo; rete e
+// BLE salgono dopo, a piccoli passi dal loop(). Ogni fase annota qui il primo
+// istante in cui è pronta: BOOT_STEER (primo tick del controllo con heading
+// già calcolato) è il "time-to-steer" da tenere d'occhio.
+// Report: $PEUNO,BOOT,... su WS (a fine avvio e a ogni nuovo client) e
+// oggetto "boot" in /api/stats. 0 = fase non ancora raggiunta.
+
+#ifndef EUNO_BOOT_H
+#define EUNO_BOOT_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+enum EunoBootPhase : uint8_t {
+  BOOT_SENSORS = 0,   // ICM-20948 inizializzata
+  BOOT_CONFIG,        // record EEPROM caricati (ed eventuale migrazione)
+  BOOT_HEADING,       // primo tick fusion
+  BOOT_STEER,         // primo tick controllo: autopilota operativo
+  BOOT_AP,            // AP Wi-Fi attivo
+  BOOT_NET,           // UDP + HTTP + WS in ascolto
+  BOOT_STA,           // STA connessa (se c'è una rete nota)
+  BOOT_BLE,           // NimBLE inizializzato
+  BOOT_GPS,           // ricevitore GPS trovato e configurato (task gps_cfg)
+  BOOT_PHASES
+};
+
+static const char* const bootPhaseNames[BOOT_PHASES] = {
+  "SENS", "CFG", "HDG", "STEER", "AP", "NET", "STA", "BLE", "GPS"
+};
+
+// scritte da task diversi, una fase ciascuno: word a 32 bit, niente lock
+static volatile uint32_t bootMs[BOOT_PHASES] = {};
+
+static inline void bootMark(EunoBootPhase p){
+  if (bootMs[p]) return;
+  uint32_t ms = millis();
+  bootMs[p] = ms ? ms : 1;
+}
+
+static inline bool bootReached(EunoBootPhase p){ return bootMs[p] != 0; }
+
+// $PEUNO,BOOT,SENS=12,CFG=40,...  (N/A = fase non raggiunta)
+static inline String bootNmea(){
+  String s = "$PEUNO,BOOT";
+  for (int i = 0; i < BOOT_PHASES; i++) {
+    s += ',';
+    s += bootPhaseNames[i];
+    s += '=';
+    s += bootMs[i] ? String((uint32_t)bootMs[i]) : String("N/A");
+  }
+  return s;
+}
+
+static inline void bootAppendJson(String& json){
+  json += '{';
+  for (int i = 0; i < BOOT_PHASES; i++) {
+    if (i) json += ',';
+    json += '"';
+    json += bootPhaseNames[i];
+    json += "\":";
+    json += bootMs[i] ? String((uint32_t)bootMs[i]) : String("null");
+  }
+  json += '}';
+}
+
+#endif // EUNO_BOOT_H
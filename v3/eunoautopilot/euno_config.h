@@ -0,0 +1,223 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// euno_config.h — archivio configurazione in EEPROM: record tipizzati con
+// versione e CRC, scritture raggruppate
+//
+// Layout (schema CFG_SCHEMA, 2.5 KB):
+//   0..15      intestazione: magic + versione schema
+//   poi uno slot fisso per record: [id][ver][len][crc16] + dati
+// Un record con id/versione/lunghezza/CRC che non tornano è "assente": chi
+// lo carica usa i default (o il layout precedente, vedi cfgLegacy()).
+//
+// Scrittura: cfgStore() aggiorna solo la copia in RAM della EEPROM (l'ESP32
+// la tiene tutta in RAM) e segna il commit come pendente. cfgService(), dal
+// loop, fa UN EEPROM.commit() quando le scritture tacciono da
+// CFG_COALESCE_MS: una raffica di SET: costa un solo commit del settore.
+// Il commit blocca la cache flash (si ferma anche il task di controllo): lo
+// si rimanda mentre il motore è comandato (fase attiva del 3 stati o uscita
+// PID), al massimo CFG_MAX_DEFER_MS.
+//
+// Migrazione: senza intestazione valida la EEPROM è nel layout a indirizzi
+// fissi delle versioni precedenti (offset 0..7, parametri 10..35, ADV 100,
+// credenziali 512). Ogni modulo in quel caso legge il vecchio indirizzo (fit
+// del magnetometro e curva di deviazione non c'erano: partono dai default);
+// setup() poi riscrive tutto come record e chiude con cfgFinishMigration(). La vecchia tabella ADV (100..1323)
+// copriva le credenziali a 512: quale dei due è integro lo dice il controllo
+// di plausibilità in lettura.
+
+#ifndef EUNO_CONFIG_H
+#define EUNO_CONFIG_H
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <stdint.h>
+
+#define CFG_EEPROM_SIZE   2560          // era 2048: l'EEPROM ESP32 si allarga conservando i dati
+#define CFG_MAGIC         0x46435545u   // "EUCF"
+#define CFG_SCHEMA        1
+#define CFG_COALESCE_MS   1500UL        // quiete prima del commit
+#define CFG_MAX_DEFER_MS  10000UL       // commit comunque entro...
+
+enum EunoCfgId : uint8_t {
+  CFG_COMPASS   = 1,   // offset hard-iron interi + offset C-GPS
+  CFG_PARAMS    = 2,   // parametri di controllo (SET:)
+  CFG_MAGCAL    = 3,   // fit a ellissoide (EunoMagCal)
+  CFG_DEVIATION = 4,   // curva di deviazione (EunoDeviation)
+  CFG_NET       = 5,   // credenziali STA utente
+  CFG_ADV       = 6,   // tabella ADV (72 punti)
+  CFG_FUSION    = 7,   // checkpoint stato fusion (warm start)
+  CFG_GPS       = 8,   // front end GPS (NMEA/UBX)
+  CFG_ROUTE     = 9,   // rotta a bordo (EunoRoute, waypoint attivo)
+};
+
+struct EunoCfgSlot { uint8_t id; uint16_t addr; uint16_t cap; };   // cap = header + dati
+
+static constexpr EunoCfgSlot cfgSlots[] = {
+  { CFG_COMPASS,     16,   16 },
+  { CFG_PARAMS,      32,   48 },
+  { CFG_MAGCAL,      80,   64 },
+  { CFG_DEVIATION,  144,  136 },
+  { CFG_NET,        280,  112 },
+  { CFG_ADV,        392, 1456 },
+  { CFG_FUSION,    1848,   56 },
+  { CFG_GPS,       1904,   16 },
+  { CFG_ROUTE,     1920,  528 },   // → 2447
+};
+
+struct EunoCfgHeader {
+  uint8_t  id;
+  uint8_t  ver;
+  uint16_t len;
+  uint16_t crc;
+};
+
+// Capienza dello slot a compile time (0 = id sconosciuto)
+static constexpr uint16_t cfgSlotCap(uint8_t id, size_t i = 0){
+  return i >= sizeof(cfgSlots) / sizeof(cfgSlots[0]) ? 0
+       : cfgSlots[i].id == id ? cfgSlots[i].cap : cfgSlotCap(id, i + 1);
+}
+
+// Accanto a ogni tipo di record: cfgStore() di un record troppo grande
+// fallirebbe in silenzio, meglio non compilare
+#define CFG_ASSERT_FITS(id, T) \
+  static_assert(sizeof(T) + sizeof(EunoCfgHeader) <= cfgSlotCap(id), #T " non sta nello slot " #id)
+
+static bool          cfgLegacyLayout = false;
+static bool          cfgOpen         = false;
+static bool          cfgPending      = false;
+static unsigned long cfgFirstDirtyMs = 0, cfgLastDirtyMs = 0;
+static uint32_t      cfgCommits      = 0;
+
+static inline const EunoCfgSlot* cfgSlot(uint8_t id){
+  for (const EunoCfgSlot& s : cfgSlots) if (s.id == id) return &s;
+  return nullptr;
+}
+
+// CRC-16/CCITT-FALSE, bit a bit (pochi record, niente tabella in flash)
+static inline uint16_t cfgCrc16(uint16_t crc, uint8_t b){
+  crc ^= (uint16_t)b << 8;
+  for (int i = 0; i < 8; i++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+  return crc;
+}
+
+// CRC su id, versione, lunghezza e dati (letti dalla copia EEPROM)
+static inline uint16_t cfgRecordCrc(const EunoCfgHeader& h, int dataAddr){
+  uint16_t crc = 0xFFFF;
+  crc = cfgCrc16(crc, h.id);
+  crc = cfgCrc16(crc, h.ver);
+  crc = cfgCrc16(crc, (uint8_t)(h.len & 0xFF));
+  crc = cfgCrc16(crc, (uint8_t)(h.len >> 8));
+  for (uint16_t i = 0; i < h.len; i++) crc = cfgCrc16(crc, EEPROM.read(dataAddr + i));
+  return crc;
+}
+
+static inline void cfgMarkDirty(){
+  unsigned long now = millis();
+  if (!cfgPending) cfgFirstDirtyMs = now;
+  cfgLastDirtyMs = now;
+  cfgPending = true;
+}
+
+// Apre la EEPROM; false = nessuna intestazione (layout precedente o vergine)
+static inline bool cfgBegin(){
+  EEPROM.begin(CFG_EEPROM_SIZE);
+  uint32_t magic = 0; uint16_t schema = 0;
+  EEPROM.get(0, magic);
+  EEPROM.get(4, schema);
+  cfgLegacyLayout = !(magic == CFG_MAGIC && schema == CFG_SCHEMA);
+  cfgOpen = true;
+  return !cfgLegacyLayout;
+}
+
+// Già aperta da setup(): un secondo EEPROM.begin() ricaricherebbe il buffer
+// dalla flash perdendo i cfgStore() non ancora committati
+static inline bool cfgIsOpen(){ return cfgOpen; }
+
+// true finché setup() non ha migrato il layout a indirizzi fissi
+static inline bool cfgLegacy(){ return cfgLegacyLayout; }
+
+enum EunoCfgLoad : uint8_t {
+  CFG_LOAD_OK = 0,
+  CFG_LOAD_MISSING,      // slot vuoto, di un altro id o layout precedente
+  CFG_LOAD_CORRUPT,      // CRC sbagliato
+  CFG_LOAD_VERSION,      // record integro ma di un'altra versione/lunghezza
+};
+
+// Carica il record in dst se id/versione/lunghezza/CRC sono validi.
+// CFG_LOAD_VERSION (con la versione trovata in *foundVer) lascia al modulo
+// la scelta di migrare; intanto lo si segnala su Serial, niente default muti.
+static inline EunoCfgLoad cfgLoad(uint8_t id, void* dst, uint16_t len, uint8_t ver,
+                                  uint8_t* foundVer = nullptr){
+  if (cfgLegacyLayout) return CFG_LOAD_MISSING;
+  const EunoCfgSlot* s = cfgSlot(id);
+  if (!s || len + sizeof(EunoCfgHeader) > s->cap) return CFG_LOAD_MISSING;
+  EunoCfgHeader h = {};
+  EEPROM.get(s->addr, h);
+  if (h.id != id || h.len + sizeof(EunoCfgHeader) > s->cap) return CFG_LOAD_MISSING;
+  int dataAddr = s->addr + (int)sizeof(EunoCfgHeader);
+  if (cfgRecordCrc(h, dataAddr) != h.crc) return CFG_LOAD_CORRUPT;
+  if (foundVer) *foundVer = h.ver;
+  if (h.ver != ver || h.len != len) {
+    Serial.printf("[CFG] record %u: versione %u/%u byte, attesa %u/%u byte\n",
+                  id, h.ver, h.len, ver, len);
+    return CFG_LOAD_VERSION;
+  }
+  uint8_t* p = (uint8_t*)dst;
+  for (uint16_t i = 0; i < len; i++) p[i] = EEPROM.read(dataAddr + i);
+  return CFG_LOAD_OK;
+}
+
+// Scrive il record nella copia RAM; il commit lo fa cfgService()
+static inline bool cfgStore(uint8_t id, const void* src, uint16_t len, uint8_t ver){
+  const EunoCfgSlot* s = cfgSlot(id);
+  if (!s || len + sizeof(EunoCfgHeader) > s->cap) return false;
+  int dataAddr = s->addr + (int)sizeof(EunoCfgHeader);
+  const uint8_t* p = (const uint8_t*)src;
+  for (uint16_t i = 0; i < len; i++) EEPROM.write(dataAddr + i, p[i]);
+  EunoCfgHeader h = { id, ver, len, 0 };
+  h.crc = cfgRecordCrc(h, dataAddr);
+  EEPROM.put(s->addr, h);
+  cfgMarkDirty();
+  return true;
+}
+
+// Invalida il record (al prossimo avvio: default)
+static inline void cfgErase(uint8_t id){
+  const EunoCfgSlot* s = cfgSlot(id);
+  if (!s) return;
+  EunoCfgHeader h = { 0, 0, 0, 0 };
+  EEPROM.put(s->addr, h);
+  cfgMarkDirty();
+}
+
+// Fine migrazione: intestazione dello schema corrente (i record sono già scritti)
+static inline void cfgFinishMigration(){
+  EEPROM.put(0, (uint32_t)CFG_MAGIC);
+  EEPROM.put(4, (uint16_t)CFG_SCHEMA);
+  cfgLegacyLayout = false;
+  cfgMarkDirty();
+}
+
+static inline void cfgFlush(){
+  if (!cfgPending) return;
+  EEPROM.commit();
+  cfgPending = false;
+  cfgCommits++;
+}
+
+// Dal loop: commit dopo CFG_COALESCE_MS di quiete, non con busy (motore in
+// fase attiva) se non oltre CFG_MAX_DEFER_MS. true se ha fatto il commit.
+static inline bool cfgService(unsigned long now, bool busy){
+  if (!cfgPending) return false;
+  bool overdue = (now - cfgFirstDirtyMs >= CFG_MAX_DEFER_MS);
+  if (!overdue && (busy || now - cfgLastDirtyMs < CFG_COALESCE_MS)) return false;
+  cfgFlush();
+  return true;
+}
+
+#endif // EUNO_CONFIG_H
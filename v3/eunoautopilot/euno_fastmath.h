@@ -0,0 +1,73 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// euno_fastmath.h — atan2 / sincos veloci per la pipeline heading
+//
+// Polinomi minimax in float (l'S3 ha FPU single precision: niente tabelle
+// in flash, niente fixed point). Errori massimi misurati da
+// v3/host/bench_fastmath.cpp:
+//   fm_atan2   < 2e-6 rad   (~0.0001°)
+//   fm_sincos  < 5e-7       (assoluto, |x| ≤ 1e4 rad)
+// Ben sotto il grado intero che la bussola pubblica.
+// Radici con sqrtf() e 1.0f/sqrtf(): la rsqrt a bit + Newton che c'era
+// non batteva libm (0.64× sull'host) e non è stata misurata più veloce sull'S3.
+
+#ifndef EUNO_FASTMATH_H
+#define EUNO_FASTMATH_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FM_PI      3.14159265358979f
+#define FM_PI_2    1.57079632679490f
+#define FM_RAD2DEG 57.2957795130823f
+#define FM_DEG2RAD 0.0174532925199433f
+
+// atan2 in radianti (−π..π): riduzione a [0,1] + polinomio dispari grado 11
+static inline float fm_atan2(float y, float x){
+  float ax = fabsf(x), ay = fabsf(y);
+  float mx = ax > ay ? ax : ay;
+  float mn = ax > ay ? ay : ax;
+  if (mx == 0.0f) return 0.0f;
+  float z  = mn / mx;
+  float z2 = z * z;
+  float r  = z * (0.99997726f + z2 * (-0.33262347f + z2 * (0.19354346f +
+             z2 * (-0.11643287f + z2 * (0.05265332f + z2 * (-0.01172120f))))));
+  if (ay > ax)   r = FM_PI_2 - r;
+  if (x < 0.0f)  r = FM_PI - r;
+  return (y < 0.0f) ? -r : r;
+}
+
+// atan2 in gradi 0..360 (heading matematico)
+static inline float fm_atan2_deg360(float y, float x){
+  float d = fm_atan2(y, x) * FM_RAD2DEG;
+  return (d < 0.0f) ? d + 360.0f : d;
+}
+
+// seno e coseno insieme: riduzione a quadrante [−π/4, π/4] + Taylor/minimax
+static inline void fm_sincos(float x, float &s, float &c){
+  float q  = x * (2.0f / FM_PI);
+  int   qi = (int)(q >= 0.0f ? q + 0.5f : q - 0.5f);
+  // riduzione Cody-Waite in due passi per non perdere bit su |x| grandi
+  float r  = (x - (float)qi * 1.5703125f) - (float)qi * 4.83826794897e-4f;
+  float r2 = r * r;
+  float sn = r * (1.0f + r2 * (-0.166666667f + r2 * (0.00833333333f + r2 * (-0.000198412698f))));
+  float cs = 1.0f + r2 * (-0.5f + r2 * (0.0416666667f + r2 * (-0.00138888889f + r2 * 2.48015873e-5f)));
+  switch (qi & 3) {
+    case 0:  s =  sn; c =  cs; break;
+    case 1:  s =  cs; c = -sn; break;
+    case 2:  s = -sn; c = -cs; break;
+    default: s = -cs; c =  sn; break;
+  }
+}
+
+static inline void fm_sincos_deg(float deg, float &s, float &c){
+  fm_sincos(deg * FM_DEG2RAD, s, c);
+}
+
+#endif // EUNO_FASTMATH_H
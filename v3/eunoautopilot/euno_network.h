@@ -9,6 +9,7 @@
 #include <functional>
 #include <esp_wifi.h>
 #include <EEPROM.h>
+#include "euno_config.h"
 #include "manifest_json.h"
 
 
@@ -50,59 +51,103 @@ public:
   String mdnsName = "euno-client";
   unsigned long lastHello = 0;
 
-  // EEPROM (semplice layout: [lenSSID][ssid...][lenPASS][pass...])
-  static const int   EE_SIZE = 2048;
-  static const int   EE_BASE = 512;
+  // EEPROM: record CFG_NET (euno_config.h); prima [lenSSID][ssid][lenPASS][pass] @512
+  static const int   EE_LEGACY_BASE = 512;
   static const uint8_t SSID_MAX = 32;
   static const uint8_t PASS_MAX = 64;
+  static const uint8_t CREDS_CFG_VER = 1;
+  struct StaCreds {
+    uint8_t ssidLen;
+    char    ssid[SSID_MAX];
+    uint8_t passLen;
+    char    pass[PASS_MAX];
+  };
+  CFG_ASSERT_FITS(CFG_NET, StaCreds);
 
   // --------- INIT ---------
-// euno_network.h — SOSTITUISCI TUTTO IL CORPO DI EunoNetwork::begin() CON QUESTO
-void begin(){
-  Serial.begin(115200);
-  delay(50);
-
-  // EEPROM: carica credenziali utente (STA2)
-  EEPROM.begin(EE_SIZE);
-  String eepSsid, eepPass;
-  if (loadOpenPlotterCreds(eepSsid, eepPass)) {
-    cfg.sta2_ssid = eepSsid;
-    cfg.sta2_pass = eepPass;
-    Serial.println("[NET] EEPROM creds: " + cfg.sta2_ssid);
-  } else {
-    Serial.println("[NET] No EEPROM creds, only defaults");
+  // Avvio a passi: beginStep() fa una fase e torna subito, loop() la richiama
+  // finché ready. Così setup() non aspetta la rete e il controllo parte prima;
+  // le attese (assestamento radio, mDNS) diventano distanze tra i passi.
+  enum NetBootStage : uint8_t { NB_CREDS, NB_AP, NB_STA, NB_MDNS, NB_SERVERS, NB_DONE };
+  NetBootStage  bootStage = NB_CREDS;
+  unsigned long bootStageMs = 0;
+  bool          apUp  = false;
+  bool          ready = false;           // UDP/HTTP/WS in ascolto
+  unsigned long mdnsBeginAt = 0;         // MDNS.begin() differita dopo MDNS.end()
+
+  // Compatibilità: avvio completo bloccante
+  void begin(){
+    while (!beginStep()) delay(1);
   }
 
-  // 1) AP SEMPRE ATTIVO (UI sempre raggiungibile)
-  beginAP();                              // WIFI_AP_STA
-  ipStr = WiFi.softAPIP().toString();     // IP di AP finché STA non sale
-
-  // 2) STA: prova default poi EEPROM (AP resta ON)
-  bool staOk = false;
-  if (trySTA(cfg.sta1_ssid.c_str(), cfg.sta1_pass.c_str())) staOk = true;
-  else if (cfg.sta2_ssid.length() && trySTA(cfg.sta2_ssid.c_str(), cfg.sta2_pass.c_str())) staOk = true;
-  mode = staOk ? LINK_STA : LINK_AP;
-
-  // 3) mDNS (una sola volta, qui)
-  initMDNS();
-
-  // 4) UDP + HTTP + WS (una sola volta, qui)
-  udp.begin(cfg.udp_in_port);
-  Serial.printf("[NET] UDP IN @ %u\n", cfg.udp_in_port);
-
-  mountHTTP();
-  ws.begin();
-  ws.onEvent([this](uint8_t num, WStype_t type, uint8_t * payload, size_t len){
-    onWsEvent(num, type, payload, len);
-  });
-
-  // Info finale
-  Serial.println("[NET] Ready. Mode=" + String(mode==LINK_STA?"STA":"AP") + " IP=" + ipStr);
-}
+  // Un passo dell'avvio rete; true quando UDP/HTTP/WS sono su
+  bool beginStep(){
+    unsigned long now = millis();
+    switch (bootStage) {
+      case NB_CREDS: {
+        // EEPROM: carica credenziali utente (STA2); l'archivio lo apre setup()
+        if (!cfgIsOpen()) cfgBegin();
+        String eepSsid, eepPass;
+        if (loadOpenPlotterCreds(eepSsid, eepPass)) {
+          cfg.sta2_ssid = eepSsid;
+          cfg.sta2_pass = eepPass;
+          Serial.println("[NET] EEPROM creds: " + cfg.sta2_ssid);
+        } else {
+          Serial.println("[NET] No EEPROM creds, only defaults");
+        }
+        // 1) AP SEMPRE ATTIVO (UI sempre raggiungibile): radio su WIFI_AP_STA
+        beginRadio();
+        bootStage = NB_AP; bootStageMs = now;
+        return false;
+      }
+      case NB_AP:
+        if (now - bootStageMs < 50) return false;   // assestamento radio
+        beginAP();
+        ipStr = WiFi.softAPIP().toString();         // IP di AP finché STA non sale
+        apUp = true;
+        bootStage = NB_STA; bootStageMs = now;
+        return false;
+      case NB_STA: {
+        // 2) STA: prova default poi EEPROM (AP resta ON)
+        bool staOk = false;
+        if (trySTA(cfg.sta1_ssid.c_str(), cfg.sta1_pass.c_str())) staOk = true;
+        else if (cfg.sta2_ssid.length() && trySTA(cfg.sta2_ssid.c_str(), cfg.sta2_pass.c_str())) staOk = true;
+        mode = staOk ? LINK_STA : LINK_AP;
+        bootStage = NB_MDNS; bootStageMs = now;
+        return false;
+      }
+      case NB_MDNS:
+        // 3) mDNS (una sola volta, qui)
+        initMDNS();
+        bootStage = NB_SERVERS; bootStageMs = now;
+        return false;
+      case NB_SERVERS:
+        // 4) UDP + HTTP + WS (una sola volta, qui)
+        udp.begin(cfg.udp_in_port);
+        Serial.printf("[NET] UDP IN @ %u\n", cfg.udp_in_port);
+
+        mountHTTP();
+        ws.begin();
+        ws.onEvent([this](uint8_t num, WStype_t type, uint8_t * payload, size_t len){
+          onWsEvent(num, type, payload, len);
+        });
+        ready = true;
+        bootStage = NB_DONE;
+
+        // Info finale
+        Serial.println("[NET] Ready. Mode=" + String(mode==LINK_STA?"STA":"AP") + " IP=" + ipStr
+                       + " (" + String(now) + " ms)");
+        return true;
+      default:
+        return true;
+    }
+  }
 
 
   // --------- LOOP ---------
   void loop(){
+    if (!ready) { beginStep(); return; }
+    serviceMDNS();
     server.handleClient();
     ws.loop();
 
@@ -154,7 +199,8 @@ if (millis() - lastChk > 800) {
       lastHello = millis();
     }
 
-    // UDP IN
+    // UDP IN: un datagramma può portare più frasi (plotter); riga per riga,
+    // prima il percorso veloce sul buffer, String solo per il resto
     int p = udp.parsePacket();
     if (p > 0){
       char buf[512];
@@ -162,39 +208,69 @@ if (millis() - lastChk > 800) {
       if (n < 0) n = 0;
       buf[n] = 0;
       peerOP = udp.remoteIP();
-      onUdpLine(String(buf));
+      char* line = buf;
+      while (line < buf + n){
+        char* e = line;
+        while (*e && *e != '\r' && *e != '\n') e++;
+        bool last = !*e;
+        *e = 0;
+        if (*line && !onFastLine(line)) onUdpLine(String(line));
+        if (last) break;
+        line = e + 1;
+      }
     }
   }
 
   // --------- INVII ---------
   void sendUDP(const String& line){
+    if (!ready) return;              // rete ancora in avvio (beginStep)
     if (peerOP) udp.beginPacket(peerOP, cfg.udp_out_port);
     else        udp.beginPacket(IPAddress(255,255,255,255), cfg.udp_out_port);
     udp.print(line);
     udp.endPacket();
   }
 
+  // Righe già pronte in un buffer (telemetry_frame.h): nessuna copia in String
+  void sendUDP(const char* line, size_t len){
+    if (!ready || !len) return;
+    if (peerOP) udp.beginPacket(peerOP, cfg.udp_out_port);
+    else        udp.beginPacket(IPAddress(255,255,255,255), cfg.udp_out_port);
+    udp.write((const uint8_t*)line, len);
+    udp.endPacket();
+  }
+
   void sendWS(const String& msg){
-    if (!msg.length()) return;
+    if (!ready || !msg.length()) return;
     String tmp = msg;
     ws.broadcastTXT(tmp);
   }
 
+  void sendWS(const char* msg, size_t len){
+    if (!ready || !len) return;
+    ws.broadcastTXT(msg, len);
+  }
+
   // --------- CALLBACK ---------
+  std::function<bool(const char*)> onFastLine = [](const char*){ return false; };  // true = gestita (niente String)
   std::function<void(const String&)> onUdpLine = [](const String&){};
   std::function<void(const String&)> onUiCommand = [](const String&){};
+  std::function<String(bool)> onStatsJson = [](bool){ return String("{}"); }; // reset dopo lettura?
+  std::function<String()> onRouteJson = [](){ return String("{}"); };
+  std::function<String(const String&)> onRoutePost = [](const String&){ return String("route non gestita"); }; // "" = OK
 
 private:
   // ===== AP SEMPRE ATTIVO =====
-  void beginAP(){
+  void beginRadio(){
     // Manteniamo sempre AP+STA
     WiFi.mode(WIFI_AP_STA);
 
     // Evita power save
     WiFi.setSleep(false);
     esp_wifi_set_ps(WIFI_PS_NONE);
-    delay(50);
+  }
 
+  // Dopo beginRadio() e ~50 ms di assestamento (vedi beginStep())
+  void beginAP(){
     // AP config
     WiFi.softAPConfig(IPAddress(192, 168, 4, 1),
                       IPAddress(0, 0, 0, 0),
@@ -229,9 +305,16 @@ return false;
 
   // ===== mDNS =====
 // euno_network.h — SOSTITUISCI TUTTA initMDNS()
+// MDNS.end() subito, MDNS.begin() ~50 ms dopo da serviceMDNS() (era delay(50))
 void initMDNS() {
   MDNS.end();
-  delay(50);
+  mdnsBeginAt = millis() + 50;
+  if (!mdnsBeginAt) mdnsBeginAt = 1;
+}
+
+void serviceMDNS() {
+  if (!mdnsBeginAt || (long)(millis() - mdnsBeginAt) < 0) return;
+  mdnsBeginAt = 0;
 
   // Evita begin se non c'è IP né in STA né in AP (caso raro)
   if (WiFi.status() != WL_CONNECTED && WiFi.softAPIP() == IPAddress(0,0,0,0)) {
@@ -269,6 +352,22 @@ void initMDNS() {
       server.send(200, "text/plain", "pong");
     });
 
+    // Tempi per stadio del loop (min/avg/p99/max µs) + overrun; ?reset=1 azzera
+    server.on("/api/stats", HTTP_GET, [this](){
+      bool reset = server.hasArg("reset") && server.arg("reset") == "1";
+      server.send(200, "application/json", onStatsJson(reset));
+    });
+
+    // Rotta a bordo (route_engine.h): GET stato, POST sostituisce i waypoint
+    server.on("/api/route", HTTP_GET, [this](){
+      server.send(200, "application/json", onRouteJson());
+    });
+    server.on("/api/route", HTTP_POST, [this](){
+      String err = onRoutePost(server.arg("plain"));
+      if (err.length()) server.send(400, "text/plain", err);
+      else              server.send(200, "application/json", onRouteJson());
+    });
+
     // Salva SSID/PASS (EEPROM) e riavvia per applicare
     server.on("/api/net", HTTP_POST, [this](){
       if (!server.hasArg("ssid") || !server.hasArg("pass")){
@@ -276,6 +375,7 @@ void initMDNS() {
       }
       String s = server.arg("ssid"), p = server.arg("pass");
       saveOpenPlotterCreds(s, p);
+      cfgFlush();   // il riavvio non aspetta il commit differito
       server.send(200, "text/plain", "OK, rebooting STA");
       delay(300);
       ESP.restart();
@@ -329,6 +429,7 @@ server.on("/api/scan", HTTP_GET, [this](){
       return;
     }
     if (type == WStype_TEXT){
+      if (payload[len] == 0 && onFastLine((const char*)payload)) return;   // la lib termina il testo
       String s((char*)payload, len);
       onUiCommand(s);
     }
@@ -338,39 +439,45 @@ server.on("/api/scan", HTTP_GET, [this](){
       public:
 
   void saveOpenPlotterCreds(const String& ssid, const String& pass){
-    String S = ssid; if (S.length() > SSID_MAX) S.remove(SSID_MAX);
-    String P = pass; if (P.length() > PASS_MAX) P.remove(PASS_MAX);
-
-    int pos = EE_BASE;
-    
-    EEPROM.write(pos++, (uint8_t)S.length());
-    for (size_t i=0; i<S.length(); ++i) EEPROM.write(pos++, S[i]);
-
-    EEPROM.write(pos++, (uint8_t)P.length());
-    for (size_t i=0; i<P.length(); ++i) EEPROM.write(pos++, P[i]);
-
-    EEPROM.commit();
+    StaCreds c;
+    memset(&c, 0, sizeof(c));
+    c.ssidLen = (uint8_t)min((int)ssid.length(), (int)SSID_MAX);
+    c.passLen = (uint8_t)min((int)pass.length(), (int)PASS_MAX);
+    memcpy(c.ssid, ssid.c_str(), c.ssidLen);
+    memcpy(c.pass, pass.c_str(), c.passLen);
+    cfgStore(CFG_NET, &c, sizeof(c), CREDS_CFG_VER);
     Serial.println("[NET] STA creds saved to EEPROM");
   }
 
   bool loadOpenPlotterCreds(String& ssidOut, String& passOut){
-    int pos = EE_BASE;
-    uint8_t l1 = EEPROM.read(pos++);
-    if (l1 == 0xFF || l1 == 0 || l1 > SSID_MAX) return false;
-    char s1[SSID_MAX+1];
-    for (uint8_t i=0;i<l1;i++) s1[i] = EEPROM.read(pos++);
-    s1[l1] = 0;
-
-    uint8_t l2 = EEPROM.read(pos++);
-    if (l2 == 0xFF || l2 > PASS_MAX) return false;
-    char s2[PASS_MAX+1];
-    for (uint8_t i=0;i<l2;i++) s2[i] = EEPROM.read(pos++);
-    s2[l2] = 0;
-
+    StaCreds c;
+    if (cfgLoad(CFG_NET, &c, sizeof(c), CREDS_CFG_VER) != CFG_LOAD_OK) {
+      if (!cfgLegacy() || !loadLegacyCreds(c)) return false;
+    }
+    if (c.ssidLen == 0 || c.ssidLen > SSID_MAX || c.passLen > PASS_MAX) return false;
+    char s1[SSID_MAX+1], s2[PASS_MAX+1];
+    memcpy(s1, c.ssid, c.ssidLen); s1[c.ssidLen] = 0;
+    memcpy(s2, c.pass, c.passLen); s2[c.passLen] = 0;
     ssidOut = String(s1);
     passOut = String(s2);
     return ssidOut.length()>0;
   }
+
+private:
+  // Layout precedente @512. La vecchia tabella ADV poteva averlo sovrascritto:
+  // si accettano solo caratteri stampabili
+  bool loadLegacyCreds(StaCreds& c){
+    int pos = EE_LEGACY_BASE;
+    c.ssidLen = EEPROM.read(pos++);
+    if (c.ssidLen == 0xFF || c.ssidLen == 0 || c.ssidLen > SSID_MAX) return false;
+    for (uint8_t i=0;i<c.ssidLen;i++) c.ssid[i] = (char)EEPROM.read(pos++);
+    c.passLen = EEPROM.read(pos++);
+    if (c.passLen == 0xFF || c.passLen > PASS_MAX) return false;
+    for (uint8_t i=0;i<c.passLen;i++) c.pass[i] = (char)EEPROM.read(pos++);
+    for (uint8_t i=0;i<c.ssidLen;i++) if (c.ssid[i] < 0x20 || c.ssid[i] > 0x7E) return false;
+    for (uint8_t i=0;i<c.passLen;i++) if (c.pass[i] < 0x20 || c.pass[i] > 0x7E) return false;
+    return true;
+  }
 };
 
 // ============================================================================
@@ -0,0 +1,160 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// euno_profiler.h — tempi per stadio del loop (cycle counter) + istogrammi
+//
+// - PROF_SCOPE(PROF_NET) misura il blocco corrente in cicli CPU
+// - Per stadio: n, min, media, max, p99 da istogramma log-lineare
+//   (4 sotto-bucket per ottava → p99 con errore < 19%)
+// - Overrun del loop: iterazioni oltre EUNO_LOOP_BUDGET_US
+// - Uscite: JSON (/api/stats) e frame $PEUNO,STAT (WS, opzionale)
+
+#ifndef EUNO_PROFILER_H
+#define EUNO_PROFILER_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#ifndef EUNO_LOOP_BUDGET_US
+#define EUNO_LOOP_BUDGET_US 10000UL   // 1 periodo di fusion @100 Hz
+#endif
+
+enum EunoProfStage : uint8_t {
+  PROF_LOOP = 0,    // iterazione completa di loop()
+  PROF_NET,         // net.loop()
+  PROF_BLE,         // ble.loop()
+  PROF_UDP_RX,      // comandi UDP 4210
+  PROF_GPS,         // Serial2 → TinyGPSPlus (onReceive, task eventi UART)
+  PROF_FUSION,      // updateSensorFusion() (task di controllo)
+  PROF_CONTROL,     // heading + duty-cycle motore (task di controllo)
+  PROF_HEADING,     // getHeadingByMode() nella telemetria
+  PROF_TELEM,       // costruzione stringa $AUTOPILOT
+  PROF_SEND,        // invio WS/UDP/Serial
+  PROF_COUNT
+};
+
+static const char* const EUNO_PROF_NAMES[PROF_COUNT] = {
+  "loop", "net", "ble", "udp_rx", "gps", "fusion", "control", "heading", "telem", "send"
+};
+
+// Istogramma log-lineare: bucket = 4*ottava + 2 bit dopo il MSB (µs)
+static const uint8_t EUNO_PROF_BUCKETS = 96;   // fino a ~2^24 µs
+
+struct EunoProfStats {
+  uint32_t n      = 0;
+  uint32_t minUs  = 0xFFFFFFFFu;
+  uint32_t maxUs  = 0;
+  uint64_t sumUs  = 0;
+  uint32_t hist[EUNO_PROF_BUCKETS] = {0};
+};
+
+static EunoProfStats eunoProf[PROF_COUNT];
+static uint32_t      eunoLoopOverruns = 0;
+
+static inline uint32_t eunoCycles(){
+#if defined(ESP32)
+  return ESP.getCycleCount();
+#else
+  return micros();
+#endif
+}
+
+static inline uint32_t eunoCyclesToUs(uint32_t c){
+#if defined(ESP32)
+  static uint32_t mhz = 0;
+  if (!mhz) mhz = ESP.getCpuFreqMHz();
+  return c / mhz;
+#else
+  return c;
+#endif
+}
+
+static inline uint8_t eunoProfBucket(uint32_t us){
+  if (us < 4) return (uint8_t)us;
+  uint8_t msb = 31 - __builtin_clz(us);
+  uint8_t b = (uint8_t)(4 * (msb - 1) + ((us >> (msb - 2)) & 3));
+  return b < EUNO_PROF_BUCKETS ? b : EUNO_PROF_BUCKETS - 1;
+}
+
+// Limite superiore (µs) del bucket: per p99 riportiamo il caso peggiore
+static inline uint32_t eunoProfBucketTop(uint8_t b){
+  if (b < 4) return b;
+  uint8_t msb = b / 4 + 1;
+  uint32_t base = 1UL << msb;
+  return base + ((uint32_t)(b & 3) + 1) * (base >> 2) - 1;
+}
+
+static inline void eunoProfRecord(EunoProfStage s, uint32_t us){
+  EunoProfStats& p = eunoProf[s];
+  p.n++;
+  p.sumUs += us;
+  if (us < p.minUs) p.minUs = us;
+  if (us > p.maxUs) p.maxUs = us;
+  p.hist[eunoProfBucket(us)]++;
+  if (s == PROF_LOOP && us > EUNO_LOOP_BUDGET_US) eunoLoopOverruns++;
+}
+
+static inline uint32_t eunoProfPercentile(const EunoProfStats& p, float q){
+  if (!p.n) return 0;
+  uint32_t target = (uint32_t)ceilf(q * (float)p.n);
+  uint32_t acc = 0;
+  for (uint8_t b = 0; b < EUNO_PROF_BUCKETS; b++){
+    acc += p.hist[b];
+    if (acc >= target) {
+      uint32_t top = eunoProfBucketTop(b);
+      return top < p.maxUs ? top : p.maxUs;
+    }
+  }
+  return p.maxUs;
+}
+
+static inline void eunoProfReset(){
+  for (uint8_t i = 0; i < PROF_COUNT; i++) eunoProf[i] = EunoProfStats();
+  eunoLoopOverruns = 0;
+}
+
+// RAII: misura lo scope corrente
+struct EunoProfScope {
+  EunoProfStage s;
+  uint32_t c0;
+  explicit EunoProfScope(EunoProfStage st) : s(st), c0(eunoCycles()) {}
+  ~EunoProfScope(){ eunoProfRecord(s, eunoCyclesToUs(eunoCycles() - c0)); }
+};
+#define PROF_SCOPE(stage) EunoProfScope _prof_##stage(stage)
+
+// {"loop_overruns":N,"budget_us":B,"stages":{"net":{"n":..,"min":..,"avg":..,"p99":..,"max":..},...}}
+static inline void eunoProfAppendJson(String& out){
+  out += "{\"loop_overruns\":" + String(eunoLoopOverruns);
+  out += ",\"budget_us\":" + String(EUNO_LOOP_BUDGET_US);
+  out += ",\"stages\":{";
+  for (uint8_t i = 0; i < PROF_COUNT; i++){
+    const EunoProfStats& p = eunoProf[i];
+    if (i) out += ",";
+    out += "\""; out += EUNO_PROF_NAMES[i]; out += "\":{";
+    out += "\"n\":"    + String(p.n);
+    out += ",\"min\":" + String(p.n ? p.minUs : 0);
+    out += ",\"avg\":" + String(p.n ? (uint32_t)(p.sumUs / p.n) : 0);
+    out += ",\"p99\":" + String(eunoProfPercentile(p, 0.99f));
+    out += ",\"max\":" + String(p.maxUs);
+    out += "}";
+  }
+  out += "}}";
+}
+
+// $PEUNO,STAT,OVR=3,loop=min/avg/p99/max,net=...   (µs)
+static inline String eunoProfNmea(){
+  String s = "$PEUNO,STAT,OVR=" + String(eunoLoopOverruns);
+  for (uint8_t i = 0; i < PROF_COUNT; i++){
+    const EunoProfStats& p = eunoProf[i];
+    s += ","; s += EUNO_PROF_NAMES[i]; s += "=";
+    s += String(p.n ? p.minUs : 0) + "/" + String(p.n ? (uint32_t)(p.sumUs / p.n) : 0) + "/" +
+         String(eunoProfPercentile(p, 0.99f)) + "/" + String(p.maxUs);
+  }
+  return s;
+}
+
+#endif // EUNO_PROFILER_H
@@ -0,0 +1,167 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// euno_scheduler.h — executive a rate fisse (task periodici + priorità + jitter)
+//
+// - Ogni task dichiara frequenza (Hz) e priorità (più alta = prima)
+// - runDue() esegue i task scaduti in ordine di priorità, rilascio "drift-free"
+//   (next += period), se si perde più di un periodo conta un overrun e riallinea
+// - Statistiche per task: jitter di rilascio (ritardo rispetto all'istante
+//   previsto) max/medio, tempo di esecuzione max/medio, overrun
+// - startEunoRtTask(): fa girare un'istanza in un task FreeRTOS dedicato
+//   (priorità sopra loopTask) → fusion/controllo non dipendono da rete/BLE
+
+#ifndef EUNO_SCHEDULER_H
+#define EUNO_SCHEDULER_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+struct EunoTaskStats {
+  uint32_t runs        = 0;
+  uint32_t overruns    = 0;     // rilasci persi (ritardo > 1 periodo)
+  uint32_t jitterMaxUs = 0;     // ritardo max rispetto al rilascio previsto
+  float    jitterAvgUs = 0.0f;  // media esponenziale
+  uint32_t execMaxUs   = 0;
+  float    execAvgUs   = 0.0f;
+};
+
+struct EunoTask {
+  const char* name     = "";
+  uint32_t    periodUs = 0;
+  uint8_t     prio     = 0;
+  void      (*fn)()    = nullptr;
+  uint32_t    nextUs   = 0;
+  EunoTaskStats st;
+};
+
+template <uint8_t N>
+class EunoScheduler {
+public:
+  // Registra un task; ritorna l'indice o -1 se pieno
+  int add(const char* name, float hz, uint8_t prio, void (*fn)()){
+    if (n >= N || hz <= 0.0f || !fn) return -1;
+    EunoTask& t = tasks[n];
+    t.name     = name;
+    t.periodUs = (uint32_t)(1e6f / hz);
+    t.prio     = prio;
+    t.fn       = fn;
+    t.nextUs   = micros() + t.periodUs;
+    t.st       = EunoTaskStats();
+    return n++;
+  }
+
+  // Esegue il task scaduto a priorità più alta; false se nessuno è pronto
+  bool runOnce(){
+    uint32_t now = micros();
+    int best = -1;
+    for (uint8_t i = 0; i < n; i++){
+      if ((int32_t)(now - tasks[i].nextUs) < 0) continue;
+      if (best < 0 || tasks[i].prio > tasks[best].prio) best = i;
+    }
+    if (best < 0) return false;
+
+    EunoTask& t = tasks[best];
+    uint32_t late = now - t.nextUs;
+    t.fn();
+    uint32_t end  = micros();
+    uint32_t exec = end - now;
+
+    EunoTaskStats& s = t.st;
+    s.runs++;
+    if (late > s.jitterMaxUs) s.jitterMaxUs = late;
+    if (exec > s.execMaxUs)   s.execMaxUs   = exec;
+    s.jitterAvgUs += 0.05f * ((float)late - s.jitterAvgUs);
+    s.execAvgUs   += 0.05f * ((float)exec - s.execAvgUs);
+
+    t.nextUs += t.periodUs;
+    if ((int32_t)(end - t.nextUs) >= 0){
+      // troppo in ritardo: non recuperiamo i rilasci persi, riallineiamo
+      s.overruns++;
+      t.nextUs = end + t.periodUs;
+    }
+    return true;
+  }
+
+  void runDue(){ while (runOnce()) {} }
+
+  // µs al prossimo rilascio (0 se qualcosa è già scaduto)
+  uint32_t usUntilNext() const {
+    uint32_t now = micros();
+    uint32_t best = 0xFFFFFFFFu;
+    for (uint8_t i = 0; i < n; i++){
+      int32_t d = (int32_t)(tasks[i].nextUs - now);
+      if (d <= 0) return 0;
+      if ((uint32_t)d < best) best = (uint32_t)d;
+    }
+    return best;
+  }
+
+  uint8_t count() const { return n; }
+  const EunoTask& task(uint8_t i) const { return tasks[i]; }
+
+  void resetStats(){ for (uint8_t i = 0; i < n; i++) tasks[i].st = EunoTaskStats(); }
+
+  void printStats(Print& out) const {
+    for (uint8_t i = 0; i < n; i++){
+      const EunoTask& t = tasks[i];
+      out.printf("[SCHED] %-10s %6.1fHz runs=%lu ovr=%lu jit avg/max=%.0f/%lu us exec avg/max=%.0f/%lu us\n",
+                 t.name, 1e6f / (float)t.periodUs,
+                 (unsigned long)t.st.runs, (unsigned long)t.st.overruns,
+                 t.st.jitterAvgUs, (unsigned long)t.st.jitterMaxUs,
+                 t.st.execAvgUs, (unsigned long)t.st.execMaxUs);
+    }
+  }
+
+  // [{"name":..,"hz":..,"runs":..,"ovr":..,"jit_avg":..,"jit_max":..,"exec_avg":..,"exec_max":..},...]
+  void appendJson(String& out) const {
+    out += "[";
+    for (uint8_t i = 0; i < n; i++){
+      const EunoTask& t = tasks[i];
+      if (i) out += ",";
+      out += "{\"name\":\""; out += t.name; out += "\"";
+      out += ",\"hz\":"       + String(1e6f / (float)t.periodUs, 1);
+      out += ",\"runs\":"     + String(t.st.runs);
+      out += ",\"ovr\":"      + String(t.st.overruns);
+      out += ",\"jit_avg\":"  + String((uint32_t)t.st.jitterAvgUs);
+      out += ",\"jit_max\":"  + String(t.st.jitterMaxUs);
+      out += ",\"exec_avg\":" + String((uint32_t)t.st.execAvgUs);
+      out += ",\"exec_max\":" + String(t.st.execMaxUs);
+      out += "}";
+    }
+    out += "]";
+  }
+
+private:
+  EunoTask tasks[N];
+  uint8_t  n = 0;
+};
+
+// ====== TASK FREERTOS DEDICATO ========================================
+#if defined(ESP32)
+template <uint8_t N>
+static void eunoRtTaskBody(void* arg){
+  EunoScheduler<N>* s = (EunoScheduler<N>*)arg;
+  for (;;){
+    s->runDue();
+    // Tick FreeRTOS = 1 ms: attesa minima 1 tick (cede la CPU a loopTask/IDLE)
+    uint32_t waitUs = s->usUntilNext();
+    TickType_t ticks = pdMS_TO_TICKS(waitUs / 1000);
+    vTaskDelay(ticks > 0 ? ticks : 1);
+  }
+}
+
+// Priorità 3 > loopTask (1): il task preempta rete/BLE/telemetria su core 1
+template <uint8_t N>
+static inline bool startEunoRtTask(EunoScheduler<N>& s, const char* name,
+                                   uint32_t stack = 6144, UBaseType_t prio = 3,
+                                   BaseType_t core = 1){
+  return xTaskCreatePinnedToCore(eunoRtTaskBody<N>, name, stack, &s, prio, nullptr, core) == pdPASS;
+}
+#endif
+
+#endif // EUNO_SCHEDULER_H
@@ -28,6 +28,15 @@
 #include <esp_wifi.h>     // <-- usi esp_wifi_set_channel(...)
 #include <math.h>
 #include "sensor_fusion.h"  // Include il nostro modulo sensor fusion
+#include "autopilot_control.h"  // algoritmo 3 stati + duty-cycle motore
+#include "autopilot_autotune.h" // autotune a relè (CAL=TUNE)
+#include "motor_jog.h"          // jog manuale in standby senza delay()
+#include "euno_scheduler.h"     // executive a rate fisse (fusion/controllo/telemetria)
+#include "euno_profiler.h"      // tempi per stadio + istogrammi (/api/stats, $PEUNO,STAT)
+#include "euno_boot.h"          // tempi delle fasi di avvio (time-to-steer)
+#include "gps_ingest.h"         // GPS a eventi UART, ricevitore a 115200 / 10 Hz
+#include "route_engine.h"       // rotta a bordo (waypoint in EEPROM, ortodromia)
+#include "telemetry_frame.h"    // righe $AUTOPILOT in buffer fisso con checksum
 #include <Update.h>
 #include <stdint.h>
 #include "ADV_CALIBRATION.h"
@@ -46,7 +55,7 @@ void handleAdvancedCalibrationCommand(const String& cmd);
 void handleCommandClient(String command);    // <-- usato prima della definizione
 void updateConfig(String command);           // <-- usato prima della definizione
 void sendHeadingSource(int mode);            // <-- usato prima della definizione
-int  applyAdvCalibration(float x, float y);  // definita in fondo
+int  applyAdvCalibration(float x, float y);  // ADV_CALIBRATION.h
 
 #define FW_VERSION "1.2.1-CLIENT"
 #include "icm_compass.h"
@@ -62,13 +71,22 @@ EunoCmdAPI  api;
 inline void EUNO_PARSE(const String& s){ parseNMEAClientLine(s, api); }
 
 int externalBearingDeg = -1;  // ultimo bearing esterno valido (per telemetria/UI)
+bool trackModeEnabled = false; // TRACK: comando da RMB/APB con correzione XTE (track_mode.h)
+EunoTrackCtl  trackCtl;
+EunoNavTarget navTarget;       // ultima RMB/APB ricevuta
+EunoRouteNav  routeNav;        // rotta a bordo: con running ha la precedenza su RMB/APB e CMD:
+bool windModeEnabled = false;  // WIND: rotta dall'AWA obiettivo (wind_vane.h), esclude TRACK/rotta
+float windTargetAwa  = 0.0f;   // AWA obiettivo, + = vento a dritta
+bool windLost        = false;  // vento assente da WIND_STALE_MS (segnalato una volta)
+EunoWindVane  windVane;
+bool statFrameEnabled = false;  // $PEUNO,STAT su WS (1 Hz), $PEUNO,CMD,STAT=ON/OFF
 
 // gg### VARIABILI GLOBALI CONDIVISE ###
 WiFiUDP udp;
 IPAddress serverIP(192, 168, 4, 1);
 unsigned int serverPort = 4210;
 char incomingPacket[255];
-int headingSourceMode = 0;  // 0 = COMPASS, 1 = FUSION, 2 = EXPERIMENTAL, 3 = ADV
+volatile int headingSourceMode = 0;  // 0 = COMPASS, 1 = FUSION, 2 = EXPERIMENTAL, 3 = ADV, 4 = AHRS
 int headingOffset = 0;      // Offset software per la bussola (impostato con C-GPS)
 float smoothedSpeed = 0.0;
 int T_pause = 0;            // 0..9 (0..900 ms)
@@ -79,37 +97,21 @@ int lastErrors[3] = {999, 999, 999};
 int erroreIndex = 0;
 bool shouldStopMotor = false;
 
-// EEPROM helpers
-#define EEPROM_SIZE 64
-
-int readParameterFromEEPROM(int addr) {
-  int low  = EEPROM.read(addr);
-  int high = EEPROM.read(addr + 1);
-  return (high << 8) | low;
+// EEPROM helpers (record in euno_config.h)
+// Valore salvato → parametro: fuori range sotto → default, sopra → clamp
+int paramOrDefault(int v, int defVal, int minV, int maxV) {
+  if (v < minV)   return defVal;
+  if (v > maxV)   return maxV;
+  return v;
 }
 
-void writeParameterToEEPROM(int addr, int value) {
-  EEPROM.write(addr,     value & 0xFF);
-  EEPROM.write(addr + 1, (value >> 8) & 0xFF);
-  EEPROM.commit();
-}
-// Legge 16 bit e applica fallback + clamp in caso di EEPROM non inizializzata (0xFFFF) o fuori-range
+// Layout a indirizzi fissi (solo migrazione): 16 bit, 0xFFFF = mai scritto
 int readParamOrDefault(int addr, int defVal, int minV, int maxV) {
   int low  = EEPROM.read(addr);
   int high = EEPROM.read(addr + 1);
   int v = (high << 8) | low;
   if (v == 0xFFFF) return defVal;   // EEPROM “vuota” o non scritta
-  if (v < minV)   return defVal;    // fuori range → torna default (o puoi scegliere minV)
-  if (v > maxV)   return maxV;      // clamp superiore
-  return v;
-}
-
-// Legge headingOffset (uint16) con fallback a 0 se 0xFFFF
-int readHeadingOffsetOr0() {
-  int low  = EEPROM.read(6);
-  int high = EEPROM.read(7);
-  int v = (high << 8) | low;
-  return (v == 0xFFFF) ? 0 : v;
+  return paramOrDefault(v, defVal, minV, maxV);
 }
 
 // ### VARIABILI OTA CLIENT ###
@@ -191,13 +193,6 @@ void handleOTAData(String command) {
   }
 }
 
-// ### FUNZIONI EEPROM ###
-void saveParameterToEEPROM(int address, int value) {
-  EEPROM.write(address, value & 0xFF);
-  EEPROM.write(address + 1, (value >> 8) & 0xFF);
-  EEPROM.commit();
-}
-
 // ### VARIABILI GLOBALI ###
 bool calibrationMode = false;
 unsigned long calibrationStartTime = 0;
@@ -206,23 +201,27 @@ float maxX = -32768, maxY = -32768, maxZ = -32768;
 int16_t compassOffsetX = 0, compassOffsetY = 0, compassOffsetZ = 0;
 ICMCompass compass;
 
-int headingCommand = 0;
-int currentHeading = 0;
+volatile int headingCommand = 0;
+volatile int currentHeading = 0;
 bool useGPSHeading = false;
-bool motorControllerState = false;
+volatile bool motorControllerState = false;
 TinyGPSPlus gps;
 bool externalBearingEnabled = false;
 
 // === MAPPING CALLBACK API → LOGICA ESISTENTE (senza alterare pin/algoritmi) ===
+static void windSetTarget(float awa);
 static void api_cmdDelta_internal(int v){
+  if (windModeEnabled) {          // in WIND i tasti spostano l'AWA: +1 = poggia a dritta
+    windSetTarget(windTargetAwa - (float)v);
+    return;
+  }
   if (v==1)        handleCommandClient("ACTION:+1");
   else if (v==-1)  handleCommandClient("ACTION:-1");
   else if (v==10)  handleCommandClient("ACTION:+10");
   else if (v==-10) handleCommandClient("ACTION:-10");
   else {
     if (motorControllerState){
-      headingCommand = (headingCommand + v) % 360;
-      if (headingCommand<0) headingCommand += 360;
+      headingCommand = ((headingCommand + v) % 360 + 360) % 360;   // una sola scrittura: il task non vede valori < 0
     }
   }
 }
@@ -238,9 +237,15 @@ static void api_cmdMode_internal(const String& m){
   else if (m=="FUSION")       mode = 1;
   else if (m=="EXPERIMENTAL") mode = 2;
   else if (m=="ADV")          mode = 3;
+  else if (m=="AHRS")         mode = 4;
   headingSourceMode = mode;
   sendHeadingSource(mode);
 }
+// CAL=TUNE: serve l'autopilota inserito, il relè oscilla attorno alla rotta corrente
+static void autotuneRequest(){
+  if (motorControllerState) autotuneStart(getFusedHeading(), millis());
+  else net.sendWS("$PEUNO,TUNE,STATE=FAILED MOTOR_OFF");
+}
 static void api_cmdCal_internal(const String& w){
   if (w=="MAG"){
     calibrationMode = true;
@@ -248,8 +253,14 @@ static void api_cmdCal_internal(const String& w){
     resetCalibrationData();
     debugLog("CAL: Hard-iron avviata.");
   } else if (w=="GYRO"){
-    performSensorFusionCalibration();
-    debugLog("CAL: Gyro calib eseguita.");
+    startSensorFusionCalibration();
+    debugLog("CAL: Gyro calib avviata (barca ferma ~5 s).");
+  } else if (w=="DEV"){
+    devModel.reset();
+    saveDeviationToEEPROM();
+    debugLog("CAL: Curva di deviazione azzerata.");
+  } else if (w=="TUNE"){
+    autotuneRequest();
   } else {
     handleAdvancedCalibrationCommand(w);
   }
@@ -261,12 +272,202 @@ static void api_cmdExternalBearing_internal(int brg){
   externalBearingDeg = brg;
   headingCommand = brg;
 }
+// RMB/APB: in TRACK comando con correzione XTE, altrimenti bearing come prima
+static void api_onNavTarget_internal(const EunoNavTarget& t){
+  navTarget = t;
+  if (routeNav.running || windModeEnabled) return;   // comanda la rotta a bordo / il vento
+  if (trackModeEnabled) {
+    float cmd;
+    if (trackCtl.step(t, cmd)) {
+      externalBearingDeg = (int)lroundf(navPlainBearing(t)) % 360;
+      headingCommand = (int)lroundf(cmd) % 360;
+    }
+    return;
+  }
+  float brg = navPlainBearing(t);
+  if (t.valid && !isnan(brg)) api_cmdExternalBearing_internal((int)lroundf(brg) % 360);
+}
+static void windModeOff(const char* why);
+static void api_cmdTrack_internal(bool on){
+  if (on && windModeEnabled) windModeOff("TRACK");
+  if (on != trackModeEnabled) trackCtl.reset();
+  trackModeEnabled = on;
+  net.sendWS(String("$PEUNO,TRACK,STATE=") + (on ? "ON" : "OFF"));
+  debugLog(String("TRACK: ") + (on ? "ON" : "OFF"));
+}
+// ---- rotta a bordo (route_engine.h) ----
+CFG_ASSERT_FITS(CFG_ROUTE, EunoRoute);
+static void loadRouteFromEEPROM(){
+  EunoRoute r;
+  if (cfgLoad(CFG_ROUTE, &r, sizeof(r), ROUTE_CFG_VER) == CFG_LOAD_OK && r.count <= ROUTE_MAX_WP) routeNav.r = r;
+}
+static void saveRouteToEEPROM(){
+  cfgStore(CFG_ROUTE, &routeNav.r, sizeof(routeNav.r), ROUTE_CFG_VER);
+}
+static String routeWpName(int i){
+  const EunoWaypoint& w = routeNav.r.wp[i];
+  return w.name[0] ? String(w.name) : "#" + String(i);
+}
+static void routeSendState(const char* state){
+  String s = String("$PEUNO,ROUTE,STATE=") + state
+           + ",N=" + String(routeNav.r.count)
+           + ",WPT=" + (routeNav.r.count ? routeWpName(routeNav.r.active) : String("N/A"));
+  net.sendWS(s);
+  debugLog(s);
+}
+static String routeJson(){
+  const EunoRoute& r = routeNav.r;
+  const EunoRouteLeg& g = routeNav.leg;
+  String json = String("{\"running\":") + (routeNav.running ? "true" : "false")
+              + ",\"active\":"   + String(r.active)
+              + ",\"arrive_m\":" + String(r.arriveM)
+              + ",\"btw\":" + (isnan(g.btwDeg) ? String("null") : String(g.btwDeg, 1))
+              + ",\"dtw\":" + (isnan(g.dtwNm)  ? String("null") : String(g.dtwNm, 3))
+              + ",\"xte\":" + (routeNav.running ? String(g.xteNm, 3) : String("null"))
+              + ",\"wps\":[";
+  for (int i = 0; i < r.count; i++) {
+    if (i) json += ',';
+    json += "{\"name\":\"" + String(r.wp[i].name) + "\""
+          + ",\"lat\":" + String(r.wp[i].lat * 1e-7, 7)
+          + ",\"lon\":" + String(r.wp[i].lon * 1e-7, 7) + "}";
+  }
+  return json + "]}";
+}
+// Nome waypoint: fino a 7 caratteri, niente separatori NMEA/JSON
+static void routeCleanName(const String& in, char* out){
+  int n = 0;
+  for (int i = 0; i < (int)in.length() && n < 7; i++) {
+    char c = in[i];
+    if (c > ' ' && c != ',' && c != '*' && c != '"' && c != '\\' && c != '$') out[n++] = c;
+  }
+  out[n] = 0;
+}
+// POST /api/route: una riga per waypoint "lat,lon[,nome]", opzionale "ARRIVE=<m>".
+// Sostituisce la rotta (ferma quella in corso); "" = OK
+static String api_routePost_internal(const String& body){
+  EunoRouteNav nr;
+  nr.r.arriveM = routeNav.r.arriveM;
+  int start = 0, lineNo = 0;
+  while (start < (int)body.length()) {
+    int end = body.indexOf('\n', start);
+    if (end < 0) end = body.length();
+    String ln = body.substring(start, end);
+    start = end + 1;
+    lineNo++;
+    ln.trim();
+    if (!ln.length() || ln[0] == '#') continue;
+    if (ln.startsWith("ARRIVE=")) { nr.setArrive(ln.substring(7).toInt()); continue; }
+    int c1 = ln.indexOf(','), c2 = c1 < 0 ? -1 : ln.indexOf(',', c1 + 1);
+    if (c1 < 0) return "riga " + String(lineNo) + ": serve lat,lon";
+    char name[8];
+    routeCleanName(c2 < 0 ? String("") : ln.substring(c2 + 1), name);
+    String sLat = ln.substring(0, c1), sLon = c2 < 0 ? ln.substring(c1 + 1) : ln.substring(c1 + 1, c2);
+    double lat, lon;
+    if (!geoParseDeg(sLat.c_str(), 90.0, lat) || !geoParseDeg(sLon.c_str(), 180.0, lon) ||
+        !nr.add(lat, lon, name))
+      return "riga " + String(lineNo) + ": waypoint non valido o oltre " + String(ROUTE_MAX_WP);
+  }
+  routeNav.stop();
+  routeNav.r = nr.r;
+  saveRouteToEEPROM();
+  routeSendState("LOADED");
+  return "";
+}
+// $PEUNO,CMD,WPT=<lat>:<lon>[:<nome>] → in coda
+static void api_cmdWpt_internal(const String& v){
+  int c1 = v.indexOf(':'), c2 = c1 < 0 ? -1 : v.indexOf(':', c1 + 1);
+  char name[8] = "";
+  if (c2 >= 0) routeCleanName(v.substring(c2 + 1), name);
+  double lat, lon;
+  bool ok = c1 > 0 &&
+            geoParseDeg(v.substring(0, c1).c_str(), 90.0, lat) &&
+            geoParseDeg((c2 < 0 ? v.substring(c1 + 1) : v.substring(c1 + 1, c2)).c_str(), 180.0, lon) &&
+            routeNav.add(lat, lon, name);
+  if (ok) saveRouteToEEPROM();
+  routeSendState(ok ? "WPT_ADDED" : "WPT_REJECTED");
+}
+// $PEUNO,CMD,ROUTE=START|STOP|CLEAR|NEXT|PREV|GOTO:<i>|ARRIVE:<m>
+static void api_cmdRoute_internal(const String& v){
+  if (v == "START") {
+    if (windModeEnabled && routeNav.r.count) windModeOff("ROUTE");
+    if (routeNav.start()) { trackCtl.reset(); routeSendState("ON"); }
+    else routeSendState("EMPTY");
+  } else if (v == "STOP") {
+    routeNav.stop(); routeSendState("OFF");
+  } else if (v == "CLEAR") {
+    routeNav.clear(); saveRouteToEEPROM(); routeSendState("CLEARED");
+  } else if (v == "NEXT" || v == "PREV" || v.startsWith("GOTO:")) {
+    int idx = v == "NEXT" ? routeNav.r.active + 1 : v == "PREV" ? routeNav.r.active - 1 : v.substring(5).toInt();
+    if (routeNav.select(idx)) { trackCtl.reset(); saveRouteToEEPROM(); }
+    routeSendState(routeNav.running ? "ON" : "OFF");
+  } else if (v.startsWith("ARRIVE:")) {
+    routeNav.setArrive(v.substring(7).toInt()); saveRouteToEEPROM();
+    routeSendState(routeNav.running ? "ON" : "OFF");
+  }
+}
+
+// ---- modo WIND (wind_vane.h) ----
+static void windSendState(const char* state){
+  String s = String("$PEUNO,WIND,STATE=") + state + ",AWA_T=" + String((int)lroundf(windTargetAwa));
+  net.sendWS(s);
+  debugLog(s);
+}
+// obiettivo con segno, mai più stretto di WIND_AWA_MIN_DEG (virata = cambio di segno)
+static void windSetTarget(float awa){
+  awa = wind_wrap180(awa);
+  if (fabsf(awa) < WIND_AWA_MIN_DEG) awa = (awa < 0.0f ? -WIND_AWA_MIN_DEG : WIND_AWA_MIN_DEG);
+  windTargetAwa = awa;
+  if (windModeEnabled) windSendState("ON");
+}
+static void windModeOff(const char* why){
+  windModeEnabled = false;
+  windSendState(why);
+}
+// Campione MWV/VWR (dal percorso veloce, nessuna String): filtro e, in WIND, comando
+static void api_onWind_internal(const EunoWindObs& w){
+  if (!windVane.update(w, (float)currentHeading)) return;   // raffica scartata
+  if (!windModeEnabled) return;
+  windLost = false;
+  if (!isnan(windVane.awsKn) && windVane.awsKn < WIND_MIN_KN) return;   // calma: rotta ferma
+  headingCommand = (int)lroundf(windVane.command(windTargetAwa)) % 360;
+}
+// $PEUNO,CMD,WIND=ON: tiene l'AWA di adesso; OFF: resta la rotta corrente
+static void api_cmdWindMode_internal(const String& v){
+  if (v == "ON" || v == "on" || v == "1") {
+    if (!windVane.valid(millis())) { windSendState("NO_WIND"); return; }
+    routeNav.stop();
+    trackModeEnabled = false;
+    windModeEnabled = true;
+    windLost = false;
+    windSetTarget(windVane.awaDeg((float)currentHeading));
+  } else if (windModeEnabled) {
+    windModeOff("OFF");
+  }
+}
+
+static void api_cmdStat_internal(bool on){
+  statFrameEnabled = on;
+}
+static void api_cmdGps_internal(const String& fe){
+  bool ok;
+  if      (fe == "UBX")  ok = gpsSelectFrontEnd(GPS_FE_UBX);
+  else if (fe == "NMEA") ok = gpsSelectFrontEnd(GPS_FE_NMEA);
+  else return;
+  // rifiutato durante la configurazione di avvio: resta il front end attuale
+  net.sendWS(String("$PEUNO,GPS,FE=") + gpsFrontEndName() + (ok ? "" : ",STATE=BUSY"));
+}
 static void api_onOpenPlotterFrame_internal(const String& kind,const String& raw){
   debugLog(String("OP ")+kind+": "+raw);
 }
 
-unsigned long lastSensorUpdate = 0;
-const unsigned long sensorUpdateInterval = 100; // ms
+// ### SCHEDULER ###
+// Task di controllo (FreeRTOS, prio > loopTask): fusion + heading + motore
+// Task di loop() (cooperativi): calibrazioni, telemetria, debug
+#define FUSION_TASK_HZ   100.0f
+#define CONTROL_TASK_HZ   20.0f
+#define TELEM_TASK_HZ      1.0f   // 1..10 Hz
+EunoScheduler<4> ctrlSched;
+EunoScheduler<12> loopSched;
 
 // Parametri configurabili
 int V_min = 100;
@@ -276,6 +477,53 @@ int E_max = 40;
 int E_tol = 1;
 int T_risposta = 10; // sec
 
+// Controllore: 0 = 3 STATI, 1 = PID (guadagni ×10 / ×100 / ×10, vedi autopilot_control.h)
+int controlMode = CTRL_MODE_3STATE;
+int PID_Kp = 40;
+int PID_Ki = 2;
+int PID_Kd = 800;
+
+// Record CFG_PARAMS: stessi parametri, stesso ordine degli slot 10..35 di prima
+struct EunoParamsCfg {
+  int16_t V_min, V_max, E_min, E_max, E_tol;
+  int16_t T_pause, T_risposta, controlMode;
+  int16_t PID_Kp, PID_Ki, PID_Kd;
+};
+#define PARAMS_CFG_VER 1
+CFG_ASSERT_FITS(CFG_PARAMS, EunoParamsCfg);
+
+// ### FUNZIONI EEPROM ###
+// I SET: scrivono solo la copia RAM; il commit lo raggruppa taskConfig()
+void saveParamsToEEPROM() {
+  EunoParamsCfg c = { (int16_t)V_min, (int16_t)V_max, (int16_t)E_min, (int16_t)E_max, (int16_t)E_tol,
+                      (int16_t)T_pause, (int16_t)T_risposta, (int16_t)controlMode,
+                      (int16_t)PID_Kp, (int16_t)PID_Ki, (int16_t)PID_Kd };
+  cfgStore(CFG_PARAMS, &c, sizeof(c), PARAMS_CFG_VER);
+}
+
+void loadParamsFromEEPROM() {
+  EunoParamsCfg c;
+  bool ok = cfgLoad(CFG_PARAMS, &c, sizeof(c), PARAMS_CFG_VER) == CFG_LOAD_OK;
+  bool legacy = !ok && cfgLegacy();
+  // Default/range: adatta se usi altri limiti nella UI
+  auto pick = [&](int16_t v, int legacyAddr, int defVal, int minV, int maxV) {
+    if (ok)     return paramOrDefault(v, defVal, minV, maxV);
+    if (legacy) return readParamOrDefault(legacyAddr, defVal, minV, maxV);
+    return defVal;
+  };
+  V_min       = pick(c.V_min,       10, /*def*/100, /*min*/0, /*max*/255);
+  V_max       = pick(c.V_max,       12, /*def*/255, /*min*/0, /*max*/255);
+  E_min       = pick(c.E_min,       14, /*def*/5,   /*min*/0, /*max*/180);
+  E_max       = pick(c.E_max,       16, /*def*/40,  /*min*/0, /*max*/180);
+  E_tol       = pick(c.E_tol,       18, /*def*/1,   /*min*/0, /*max*/20);
+  T_pause     = pick(c.T_pause,     24, /*def*/0,   /*min*/0, /*max*/9);
+  T_risposta  = pick(c.T_risposta,  26, /*def*/10,  /*min*/3, /*max*/12);
+  controlMode = pick(c.controlMode, 28, /*def*/0,   /*min*/0, /*max*/1);
+  PID_Kp      = pick(c.PID_Kp,      30, /*def*/40,  /*min*/0, /*max*/1000);
+  PID_Ki      = pick(c.PID_Ki,      32, /*def*/2,   /*min*/0, /*max*/1000);
+  PID_Kd      = pick(c.PID_Kd,      34, /*def*/800, /*min*/0, /*max*/5000);
+}
+
 // Variabili di controllo
 float errore_precedente = 0;
 int direzione_attuatore = 0;
@@ -291,22 +539,26 @@ WiFi.persistent(true);
   udp.begin(serverPort);
 }
 
-void sendNMEAData(int currentHeading, int headingCommand, int error, TinyGPSPlus gps) {
-  String nmeaData = "$AUTOPILOT,";
-  nmeaData += "HEADING=" + String(currentHeading) + ",";
-  nmeaData += "COMMAND=" + String(headingCommand) + ",";
-  nmeaData += "ERROR=" + String(error) + ",";
-  nmeaData += "GPS_HEADING=" + (gps.course.isValid() ? String(gps.course.deg()) : "N/A") + ",";
-  nmeaData += "GPS_SPEED=" + (gps.speed.isValid() ? String(gps.speed.knots()) : "N/A") + ",";
-  nmeaData += "E_min=" + String(E_min) + ",";
-  nmeaData += "E_max=" + String(E_max) + ",";
-  nmeaData += "E_tol=" + String(E_tol) + ",";
-  nmeaData += "T_risposta=" + String(T_risposta) + ",";
-  nmeaData += "T_pause=" + String(T_pause) + ",";
-  nmeaData += "V_min=" + String(V_min) + ",";
-  nmeaData += "V_max=" + String(V_max) + "*";
+static EunoFrame legacyFrame;   // solo loop() (taskLegacyTelemetry)
+
+void sendNMEAData(int currentHeading, int headingCommand, int error, const EunoGpsFix& fix) {
+  EunoFrame& f = legacyFrame;
+  f.begin("$AUTOPILOT");
+  f.key("HEADING");     f.putInt(currentHeading);
+  f.key("COMMAND");     f.putInt(headingCommand);
+  f.key("ERROR");       f.putInt(error);
+  f.key("GPS_HEADING"); if (fix.valid) f.putFixed(fix.cogDeg, 2); else f.na();
+  f.key("GPS_SPEED");   if (fix.valid) f.putFixed(fix.sogKn, 2);  else f.na();
+  f.key("E_min");       f.putInt(E_min);
+  f.key("E_max");       f.putInt(E_max);
+  f.key("E_tol");       f.putInt(E_tol);
+  f.key("T_risposta");  f.putInt(T_risposta);
+  f.key("T_pause");     f.putInt(T_pause);
+  f.key("V_min");       f.putInt(V_min);
+  f.key("V_max");       f.putInt(V_max);
+  if (!f.finish()) return;
   udp.beginPacket(serverIP, serverPort);
-  udp.write((const uint8_t*)nmeaData.c_str(), nmeaData.length());
+  udp.write((const uint8_t*)f.c_str(), f.len);
   udp.endPacket();
 }
 
@@ -317,6 +569,7 @@ void sendHeadingSource(int mode) {
   else if (mode == 1) modeStr = "FUSION";
   else if (mode == 2) modeStr = "EXPERIMENTAL";
   else if (mode == 3) modeStr = "ADV";
+  else if (mode == 4) modeStr = "AHRS";
   else modeStr = "UNKNOWN";
 
   String msg = "$HEADING_SOURCE,MODE=" + modeStr + "*";
@@ -336,22 +589,34 @@ void updateConfig(String command) {
   if (eqPos == -1) return;
   String param = command.substring(4, eqPos);
   int value = command.substring(eqPos + 1).toInt();
+  bool known = true;
 
   if (param == "V_min") {
-    V_min = value; saveParameterToEEPROM(10, V_min);
+    V_min = value;
   } else if (param == "V_max") {
-    V_max = value; saveParameterToEEPROM(12, V_max);
+    V_max = value;
   } else if (param == "E_min") {
-    E_min = value; saveParameterToEEPROM(14, E_min);
+    E_min = value;
   } else if (param == "E_max") {
-    E_max = value; saveParameterToEEPROM(16, E_max);
+    E_max = value;
   } else if (param == "Deadband") {
-    E_tol = value; saveParameterToEEPROM(18, E_tol);
+    E_tol = value;
   } else if (param == "T_pause") {
-    T_pause = value; writeParameterToEEPROM(24, T_pause);
+    T_pause = value;
   } else if (param == "T_risposta") {
-    T_risposta = constrain(value, 3, 12); writeParameterToEEPROM(26, T_risposta);
+    T_risposta = constrain(value, 3, 12);
+  } else if (param == "CTRL_MODE") {
+    controlModeRequest(constrain(value, 0, 1));   // reset nel task di controllo
+  } else if (param == "PID_Kp") {
+    PID_Kp = constrain(value, 0, 1000);
+  } else if (param == "PID_Ki") {
+    PID_Ki = constrain(value, 0, 1000);
+  } else if (param == "PID_Kd") {
+    PID_Kd = constrain(value, 0, 5000);
+  } else {
+    known = false;
   }
+  if (known) saveParamsToEEPROM();   // commit raggruppato da taskConfig()
 
   String confirmMsg = "$PARAM_UPDATE," + param + "=" + String(value) + "*";
   udp.beginPacket(serverIP, serverPort);
@@ -360,17 +625,16 @@ void updateConfig(String command) {
   //enow.sendLine(confirmMsg);
 }
 
-void extendMotor(int speed) { analogWrite(3, speed);  analogWrite(46, 0); }
-void retractMotor(int speed){ analogWrite(3, 0);      analogWrite(46, speed); }
-void stopMotor()             { analogWrite(3, 0);      analogWrite(46, 0); }
-
 void handleAdvancedCalibrationCommand(const String& cmd) {
   if (cmd == "ADV_CANCEL") { advCalibrationMode = false; }
 }
 
+// Come prima (area 0..99): offset, parametri e fit magnetometro tornano ai default
 void resetAllEEPROM() {
-  for (int i = 0; i < EEPROM_SIZE; i++) EEPROM.write(i, 0xFF);
-  EEPROM.commit();
+  cfgErase(CFG_COMPASS);
+  cfgErase(CFG_PARAMS);
+  cfgErase(CFG_MAGCAL);
+  cfgFlush();
   debugLog("EEPROM azzerata!");
 }
 
@@ -406,7 +670,7 @@ shouldStopMotor = false;     // pulisci la guardia “3 cicli in calo”
 
   // Calibrazioni
   else if (cmd == "CAL=MAG")   { calibrationMode = true; calibrationStartTime = millis(); resetCalibrationData(); }
-  else if (cmd == "CAL=GYRO")  { performSensorFusionCalibration(); }
+  else if (cmd == "CAL=GYRO")  { startSensorFusionCalibration(); }
   else if (cmd == "CAL=C-GPS") { handleCommandClient("ACTION:C-GPS"); } // già definito sotto
 
   // Cambia modalità heading
@@ -440,7 +704,9 @@ shouldStopMotor = false;     // pulisci la guardia “3 cicli in calo”
   }
 
   if (command.startsWith("CMD:")) {
-    if (externalBearingEnabled) {
+    if (routeNav.running || windModeEnabled) {
+      debugLog("Ricevuto CMD ma rotta a bordo o WIND attivi.");
+    } else if (externalBearingEnabled) {
       int newBearing = command.substring(4).toInt();
       headingCommand = newBearing;
       debugLog("Nuovo heading command: " + String(headingCommand));
@@ -456,23 +722,22 @@ shouldStopMotor = false;     // pulisci la guardia “3 cicli in calo”
   if (command == "ACTION:-1") {
     if (motorControllerState) {
       headingCommand = (headingCommand + 359) % 360;
-    } else { retractMotor(V_max); delay(700); stopMotor(); }
+    } else { jogRequest(-1); }
   }
   else if (command == "ACTION:+1") {
     if (motorControllerState) {
       headingCommand = (headingCommand + 1) % 360;
-    } else { extendMotor(V_max); delay(700); stopMotor(); }
+    } else { jogRequest(+1); }
   }
   else if (command == "ACTION:-10") {
     if (motorControllerState) {
       headingCommand = (headingCommand + 350) % 360;
-    } else { retractMotor(V_max); delay(700); stopMotor(); }
+    } else { jogRequest(-1); }
   }
   else if (command == "ACTION:+10") {
     if (motorControllerState) {
       headingCommand = (headingCommand + 10) % 360;
-      if (headingCommand>=360) headingCommand-=360;
-    } else { extendMotor(V_max); delay(700); stopMotor(); }
+    } else { jogRequest(+1); }
   }
 else if (command == "ACTION:TOGGLE") {
   motorControllerState = !motorControllerState;
@@ -499,13 +764,14 @@ else if (command == "ACTION:TOGGLE") {
     }
   }
   else if (command == "ACTION:GPS") {
-    headingSourceMode = (headingSourceMode + 1) % 4;
+    headingSourceMode = (headingSourceMode + 1) % 5;
     sendHeadingSource(headingSourceMode);
     useGPSHeading = (headingSourceMode == 1);
 
     if (headingSourceMode == 0)          headingCommand = getCorrectedHeading();
     else if (headingSourceMode == 1)     headingCommand = (int)round(getFusedHeading());
     else if (headingSourceMode == 2)     headingCommand = (int)round(getExperimentalHeading());
+    else if (headingSourceMode == 4)     headingCommand = (int)lroundf(getAhrsHeading()) % 360;
     else /* ADV */ {
       compass.read();
       headingCommand = applyAdvCalibration(compass.getX(), compass.getY());
@@ -513,17 +779,19 @@ else if (command == "ACTION:TOGGLE") {
     debugLog("Comando allineato al nuovo heading: " + String(headingCommand));
   }
   else if (command == "ACTION:C-GPS") {
-    if (gps.course.isValid()) {
-      int gpsHeading = (int)gps.course.deg();
+    EunoGpsMotion mot = gpsMotionGet();   // COG filtrato, non l'ultimo fix
+    if (mot.cogValid) {
+      int gpsHeading = (int)mot.cogDeg;
       compass.read();
       float rawX = compass.getX() - compassOffsetX;
       float rawY = compass.getY() - compassOffsetY;
       int compassHeading = (int)(atan2(rawY, rawX) * 180.0 / M_PI);
       if (compassHeading < 0) compassHeading += 360;
+      int prevOffset = headingOffset;
       headingOffset = (gpsHeading - compassHeading + 360) % 360;
-      EEPROM.write(6, headingOffset & 0xFF);
-      EEPROM.write(7, (headingOffset >> 8) & 0xFF);
-      EEPROM.commit();
+      // il termine costante della curva è relativo all'offset: lo riallinea
+      devModel.c[0] = dev_wrap180(devModel.c[0] - (float)(headingOffset - prevOffset));
+      saveCompassToEEPROM();
       debugLog("C-GPS: Offset bussola aggiornato = " + String(headingOffset));
     } else {
       debugLog("C-GPS fallito: GPS non valido");
@@ -549,17 +817,19 @@ else if (command == "ACTION:TOGGLE") {
       advTable[advPointCount].rawX = rawX;
       advTable[advPointCount].rawY = rawY;
       advTable[advPointCount].headingDeg = headingCommand;  // o currentHeading
+      advTable[advPointCount].calibrated = true;
       debugLog("ADV: Salvato punto #" + String(advPointCount) +
                " → X=" + String(rawX) + " Y=" + String(rawY) +
                " → heading=" + String(headingCommand));
       advPointCount++;
+      advCompileLut();
     } else {
       debugLog("ADV: Tabella piena");
     }
   }
   else if (command == "ACTION:CAL-GYRO") {
     debugLog("Avvio calibrazione completa (tilt + gyro)...");
-    performSensorFusionCalibration();
+    startSensorFusionCalibration();
   }
   else if (command == "EXT_BRG_ENABLED") {
     externalBearingEnabled = true;
@@ -572,72 +842,12 @@ else if (command == "ACTION:TOGGLE") {
   }
 }
 
-// Supporto: differenza circolare  –180 … +180
-int calculateCircularError(int heading, int command) {
-  int diff = (command - heading + 540) % 360 - 180;
-  return diff;
-}
-
-// Supporto: velocità target proporzionale all’errore
-float calcolaVelocitaTarget(float errore) {
-  float absErr = abs(errore);
-  if (absErr <= E_min) return V_min;
-  if (absErr >= E_max) return V_max;
-  return V_min + ((V_max - V_min) * (absErr - E_min)) / (float)(E_max - E_min);
-}
-
-// ### ALGORITMO AUTOPILOTA ###
-int calculateDifference(int heading, int command) {
-  int diff = (command - heading + 360) % 360;
-  if (diff > 180) diff -= 360;
-  return diff;
-}
-
-int calcola_velocita_proporzionale(int errore) {
-  int absErr = abs(errore);
-  if (absErr <= E_min) return V_min;
-  if (absErr >= E_max) return V_max;
-  return V_min + (V_max - V_min) * ((absErr - E_min) / (float)(E_max - E_min));
-}
-
-// Nuova logica a 3 stati – corregge anche con errore negativo
-int calcola_velocita_e_verso(int rotta_attuale, int rotta_desiderata) {
-  float errore = (float)((rotta_desiderata - rotta_attuale + 540) % 360 - 180);
-  float verso  = (errore >= 0.0f) ? 1.0f : -1.0f;
-
-  if (fabs(errore) <= E_tol) {
-    errore_precedente = errore;
-    return 0;
-  }
-
-  float deltaAmp = fabs(errore_precedente) - fabs(errore);
-  errore_precedente = errore;
-
-  float velocita_target = fabs(errore) / (float)T_risposta;
-  float margine = velocita_target * 0.20f;
-  int pwm = abs(calcola_velocita_proporzionale((int)errore));
-
-  if (fabs(deltaAmp - velocita_target) <= margine) {
-    return 0;                 // FERMA
-  } else if (deltaAmp < velocita_target) {
-    return pwm * verso;       // CONTINUA
-  } else {
-    return pwm * -verso;      // INVERTI
-  }
-}
-
-void gestisci_attuatore(int velocita) {
-  if (velocita > 0) extendMotor(velocita);
-  else if (velocita < 0) retractMotor(-velocita);
-  else stopMotor();
-}
-
 // ### LETTURA SENSORI ###
 void readSensors() {
   compass.read();
   int headingCompass = getCorrectedHeading();
 
-  if (useGPSHeading && gps.speed.isValid() && gps.course.isValid()) {
+  if (useGPSHeading && gpsFixGet().valid) {
     currentHeading = (int)round(getFusedHeading());
   } else {
     currentHeading = headingCompass;
@@ -678,10 +888,422 @@ int getHeadingByMode(){
         case 1:  return hdgF;
         case 2:  return hdgE;
         case 3:  return hdgA;
+        case 4:  return (int)lroundf(getAhrsHeading()) % 360;
         default: return hdgF;
     }
 }
 
+// ### TASK PERIODICI ###
+// --- task di controllo (ctrlSched, FreeRTOS) ---
+static void taskFusion() {
+  PROF_SCOPE(PROF_FUSION);
+  updateSensorFusion();
+  bootMark(BOOT_HEADING);
+}
+
+static void taskControl() {
+  PROF_SCOPE(PROF_CONTROL);
+  jogTick(millis(), motorControllerState);
+  if (autotuneActive()) {
+    currentHeading = getControlHeading();
+    autotuneStep(millis());
+  } else {
+    runAutopilotControl(millis());
+  }
+  bootMark(BOOT_STEER);
+}
+
+// --- task di loop() (loopSched, cooperativi) ---
+static void taskCalibration() {
+  // gestione calibrazione ADV (non blocca)
+  if (isAdvancedCalibrationMode()) {
+    compass.read();
+    updateAdvancedCalibration(headingGyro, compass.getX(), compass.getY(), compass.getZ());
+
+    if (isAdvancedCalibrationComplete()) {
+      saveAdvCalibrationToEEPROM();
+      debugLog("Calibrazione completata. ADV salvata su EEPROM.");
+      udp.beginPacket(serverIP, serverPort); udp.print("EXPCAL_DONE"); udp.endPacket();
+      debugLog("Risposta EXPCAL_DONE inviata all’AP");
+    }
+  }
+
+  // Gestione calibrazione hard-iron se attiva
+  if (calibrationMode) {
+    performCalibration(millis());
+  }
+
+  // Fine calibrazione magnetometro: esito del fit su WS
+  static int mcalLastState = MAGCAL_IDLE;
+  int mcalState = magCalState;
+  if (mcalState != mcalLastState) {
+    static const char* mcalNames[] = { "IDLE", "RUN", "DONE", "FAILED" };
+    String msg = String("$PEUNO,CAL,MAG,STATE=") + mcalNames[mcalState];
+    if (mcalState == MAGCAL_DONE || mcalState == MAGCAL_FAILED)
+      msg += ",MODE=" + String(magCal.mode) + ",N=" + String(magFit.count())
+           + ",FIT=" + String(magCal.fitPct, 2);
+    if (mcalState == MAGCAL_DONE)
+      msg += ",OFF=" + String(magCal.off[0], 1) + "/" + String(magCal.off[1], 1) + "/" + String(magCal.off[2], 1);
+    net.sendWS(msg);
+    mcalLastState = mcalState;
+  }
+
+  // Calibrazione gyro/tilt (gira nel tick fusion): avanzamento e fermo su WS
+  static int fcalLastState = FCAL_IDLE, fcalLastProg = -1;
+  int fcalState = fusionCalState;
+  int fcalProg  = getSensorFusionCalProgress() / 10 * 10;
+  if (fcalState != fcalLastState || (fcalState == FCAL_RUN && fcalProg != fcalLastProg)) {
+    static const char* fcalNames[] = { "IDLE", "RUN", "DONE", "FAILED" };
+    String msg = String("$PEUNO,CAL,GYRO,STATE=") + fcalNames[fcalState]
+               + ",PROG=" + String(fcalProg)
+               + ",STILL=" + String(fusionCalStill ? 1 : 0);
+    if (fcalState == FCAL_DONE) {
+      msg += ",BIASZ=" + String(gyroBiasZ_radps, 5)
+           + ",PITCH=" + String(accPitchOffset, 3) + ",ROLL=" + String(accRollOffset, 3);
+      fusionCheckpointService(millis(), true);   // nuovo bias subito in EEPROM
+    }
+    net.sendWS(msg);
+    fcalLastState = fcalState;
+    fcalLastProg  = fcalProg;
+  }
+
+  // Guardia del duty-cycle scattata nel task di controllo
+  static uint32_t guardLast = 0;
+  uint32_t guardNow = dutyGuardStops;
+  if (guardNow != guardLast) {
+    guardLast = guardNow;
+    debugLog("STOP MOTORE: errore in calo per 3 cicli (" + String(guardNow) + ")");
+  }
+
+  // Autotune: avanzamento su WS, a fine prova parametri salvati come da menu
+  static String tuneLast = "IDLE";
+  String tuneNow = autotuneStatus();
+  if (tuneNow != tuneLast) {
+    tuneLast = tuneNow;
+    net.sendWS("$PEUNO,TUNE,STATE=" + tuneNow);
+    if (tuneState == TUNE_RELAY && tuneLastPu > 0.0f)
+      debugLog("TUNE: " + tuneNow + " Pu=" + String(tuneLastPu, 1) + "s a=" + String(tuneLastAmp, 1));
+    else
+      debugLog("TUNE: " + tuneNow);
+  }
+  if (tuneResultReady) {
+    tuneResultReady = false;
+    if (tuneState == TUNE_DONE) {
+      const EunoTuneResult& r = tuneResult;
+      updateConfig("SET:T_risposta=" + String(r.T_risposta));
+      updateConfig("SET:E_min="      + String(r.E_min));
+      updateConfig("SET:E_max="      + String(r.E_max));
+      updateConfig("SET:Deadband="   + String(r.E_tol));
+      updateConfig("SET:PID_Kp="     + String(r.PID_Kp));
+      updateConfig("SET:PID_Ki="     + String(r.PID_Ki));
+      updateConfig("SET:PID_Kd="     + String(r.PID_Kd));
+      String msg = "$PEUNO,TUNE,STATE=DONE,PU=" + String(r.Pu, 1) + ",AMP=" + String(r.amp, 1)
+                 + ",KU=" + String(r.Ku, 1);
+      debugLog(msg);
+      net.sendWS(msg);
+      udp.beginPacket(serverIP, serverPort); udp.print(msg); udp.endPacket();
+    }
+  }
+}
+
+// WIND senza vento: rotta ferma sull'ultimo comando, avviso una volta
+static void taskWind() {
+  if (!windModeEnabled || windLost || windVane.valid(millis())) return;
+  windLost = true;
+  windSendState("LOST");
+}
+
+// Rotta a bordo: un passo per fix nuovo, comando in headingCommand
+static void taskRoute() {
+  if (!routeNav.running) return;
+  EunoNavTarget t;
+  EunoRouteStep st = routeNav.step(gpsFixGet(), millis(), t);
+  if (st == ROUTE_STEP_NONE) return;
+  if (st == ROUTE_STEP_DONE) {            // ultimo waypoint: resta la prua corrente
+    saveRouteToEEPROM();
+    routeSendState("DONE");
+    return;
+  }
+  if (st == ROUTE_STEP_ADVANCED) {
+    trackCtl.reset();
+    saveRouteToEEPROM();
+    routeSendState("ON");
+  }
+  float cmd;
+  if (trackCtl.step(t, cmd)) {
+    externalBearingDeg = (int)lroundf(t.btwDeg) % 360;
+    headingCommand = (int)lroundf(cmd) % 360;
+  }
+}
+
+// Curva di deviazione: campioni COG vs bussola in rotta stabile, EEPROM ogni 10 min
+static void taskDeviation() {
+  static uint32_t savedN = devModel.n;
+  static unsigned long lastSave = 0;
+  float raw = compassHeadingRaw;
+  if (isnan(raw)) return;
+
+  unsigned long now = millis();
+  EunoGpsMotion mot = gpsMotionGet();
+  bool gpsOk = mot.cogValid && now - mot.ms < DEV_GPS_AGE_MS;
+  devLearner.step(devModel, now, gpsOk,
+                  gpsOk ? mot.cogDeg : 0.0f,
+                  gpsOk ? mot.sogKn : 0.0f,
+                  raw, wrap360(raw - (float)headingOffset), getRateOfTurn());
+
+  if (devModel.n != savedN && now - lastSave >= DEV_SAVE_MS) {
+    saveDeviationToEEPROM();
+    savedN = devModel.n;
+    lastSave = now;
+    debugLog("DEV: curva salvata, campioni " + String(devModel.n));
+  }
+}
+
+// Checkpoint fusion + commit EEPROM raggruppato (euno_config.h): mai dal task
+// di controllo, e non mentre il motore spinge (il commit ferma la cache flash
+// su entrambi i core)
+static void taskConfig() {
+  fusionCheckpointService(millis(), false);   // stato fusion ogni 10 min se cambiato
+  if (cfgService(millis(), controlMotorBusy()))
+    debugLog("CFG: commit EEPROM #" + String(cfgCommits));
+}
+
+// Telemetria legacy verso l'AP (porta 4210)
+static void taskLegacyTelemetry() {
+  if (!net.ready) return;   // WiFiUDP senza stack di rete
+  int hdg = (currentHeading + 360) % 360;
+  int diff = calculateDifference(hdg, headingCommand);
+  sendNMEAData(hdg, headingCommand, diff, gpsFixGet());
+}
+
+static void taskTiltDebug() {
+  float pitch, roll;
+  getTiltAngles(pitch, roll);
+
+  Serial.printf("Tilt: Pitch=%.1f°, Roll=%.1f°\n",
+               pitch * 180.0/M_PI, roll * 180.0/M_PI);
+  Serial.printf("Offsets: Pitch=%.3f, Roll=%.3f rad\n",
+               accPitchOffset, accRollOffset);
+}
+
+static void taskSchedStats() {
+  ctrlSched.printStats(Serial);
+  loopSched.printStats(Serial);
+}
+
+// JSON per /api/stats: stadi del loop + jitter dei task
+static String buildStatsJson(bool reset) {
+  String json = "{\"uptime_ms\":" + String(millis()) + ",\"prof\":";
+  eunoProfAppendJson(json);
+  json += ",\"ctrl_tasks\":";
+  ctrlSched.appendJson(json);
+  json += ",\"loop_tasks\":";
+  loopSched.appendJson(json);
+  json += ",\"imu\":{\"fifo\":" + String(compass.fifoActive() ? "true" : "false")
+        + ",\"odr_hz\":"    + String(compass.fifoRateHz(), 1)
+        + ",\"samples\":"   + String((uint32_t)icmAcqSamples)
+        + ",\"ring\":"      + String(imuRing.size())
+        + ",\"drops\":"     + String(imuRing.dropped())
+        + ",\"overflows\":" + String((uint32_t)icmAcqOverflows) + "}";
+  json += ",\"cfg\":{\"commits\":" + String(cfgCommits)
+        + ",\"pending\":" + String(cfgPending ? "true" : "false") + "}";
+  json += ",\"gps\":{\"fe\":\"" + String(gpsFrontEndName()) + "\""
+        + ",\"baud\":" + String((uint32_t)gpsBaud)
+        + ",\"rate_hz\":"   + String((float)gpsRateHz, 1)
+        + ",\"config\":"    + String(gpsConfigured ? "true" : "false")
+        + ",\"chars\":"     + String((uint32_t)gpsChars)
+        + ",\"sentences\":" + String((uint32_t)gpsSentences)
+        + ",\"cs_fail\":"   + String((uint32_t)gps.failedChecksum())
+        + ",\"ubx_frames\":" + String(gpsUbx.frames)
+        + ",\"ubx_cs_fail\":" + String(gpsUbx.ckFail)
+        + ",\"overruns\":"  + String((uint32_t)gpsOverruns) + "}";
+  {
+    EunoGpsMotion mot = gpsMotionGet();
+    json += ",\"motion\":{\"valid\":" + String(mot.valid ? "true" : "false")
+          + ",\"sog_sig\":"  + (isnan(mot.sogSigKn) ? String("null") : String(mot.sogSigKn, 2))
+          + ",\"cog_sig\":"  + (isnan(mot.cogSigDeg) ? String("null") : String(mot.cogSigDeg, 1))
+          + ",\"accepted\":" + String(gpsMotionKf.accepted)
+          + ",\"rejected\":" + String(gpsMotionKf.rejected)
+          + ",\"resets\":"   + String(gpsMotionKf.resets) + "}";
+  }
+  json += ",\"wind\":{\"samples\":" + String(windVane.samples)
+        + ",\"gusts\":" + String(windVane.gusts) + "}";
+  json += ",\"boot\":";
+  bootAppendJson(json);
+  json += "}";
+  if (reset) {
+    eunoProfReset();
+    ctrlSched.resetStats();
+    loopSched.resetStats();
+  }
+  return json;
+}
+
+static void taskStatFrame() {
+  if (statFrameEnabled && net.wsReady) net.sendWS(eunoProfNmea());
+}
+
+// Avvio a fasi: rete e BLE salgono qui, dopo che il controllo è già operativo.
+// net.loop() fa i passi di EunoNetwork::beginStep(); BLE parte BOOT_BLE_DELAY_MS
+// dopo la rete (la radio è condivisa: niente scansione durante l'aggancio STA)
+#define BOOT_BLE_DELAY_MS 1000UL
+
+static void taskBoot() {
+  if (net.apUp) bootMark(BOOT_AP);
+  if (gpsBaud) bootMark(BOOT_GPS);
+  if (net.ready && !bootReached(BOOT_NET)) {
+    udp.begin(serverPort); // abilita UDP in ingresso (legacy)
+    bootMark(BOOT_NET);
+  }
+  if (net.ready && net.mode == LINK_STA) bootMark(BOOT_STA);
+  if (bootReached(BOOT_NET) && !bootReached(BOOT_BLE) && millis() - bootMs[BOOT_NET] >= BOOT_BLE_DELAY_MS) {
+    ble.begin();
+    bootMark(BOOT_BLE);
+    Serial.println("[BOOT] " + bootNmea());
+  }
+
+  // $PEUNO,BOOT a fine avvio e a ogni nuovo client WS
+  static bool sentDone = false, lastWs = false;
+  bool ws = net.wsReady;
+  if (bootReached(BOOT_BLE) && (!sentDone || (ws && !lastWs))) {
+    net.sendWS(bootNmea());
+    sentDone = true;
+  }
+  lastWs = ws;
+}
+
+// === TELEMETRIA $AUTOPILOT (WS + ESP-NOW + UDP HDT) =====================
+// Snapshot del tick: quello che serve a più campi o va calcolato una volta
+struct EunoTelemCtx {
+  int           hdgOut, err, hdgC, hdgF, hdgE, hdgA;
+  float         devNow;
+  bool          windOk;
+  EunoGpsFix    fix;
+  EunoGpsMotion mot;
+};
+
+static void telemOnOff(EunoFrame& f, bool on){ f.puts(on ? "ON" : "OFF"); }
+
+// Campi nell'ordine della riga (la WebApp e il TFT cercano per chiave)
+static const EunoTelemField<EunoTelemCtx> TELEM_FIELDS[] = {
+  { "HEADING",     [](EunoFrame& f, const EunoTelemCtx& c){ f.putInt(c.hdgOut); } },
+  { "COMMAND",     [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(headingCommand); } },
+  { "ERROR",       [](EunoFrame& f, const EunoTelemCtx& c){ f.putInt(c.err); } },
+  { "GPS_HEADING", [](EunoFrame& f, const EunoTelemCtx& c){ if (c.fix.valid) f.putInt((int)c.fix.cogDeg); else f.na(); } },
+  { "GPS_SPEED",   [](EunoFrame& f, const EunoTelemCtx& c){ if (c.fix.valid) f.putFixed(c.fix.sogKn, 1); else f.na(); } },
+  { "COG_F",       [](EunoFrame& f, const EunoTelemCtx& c){ if (c.mot.cogValid) f.putFixed(c.mot.cogDeg, 1); else f.na(); } },
+  { "SOG_F",       [](EunoFrame& f, const EunoTelemCtx& c){ if (c.mot.valid) f.putFixed(c.mot.sogKn, 2); else f.na(); } },
+  { "MODE",        [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(headingSourceMode); } },
+  { "MOTOR",       [](EunoFrame& f, const EunoTelemCtx&){ telemOnOff(f, motorControllerState); } },
+  { "JOG",         [](EunoFrame& f, const EunoTelemCtx&){ f.puts(jogStateStr()); } },
+  { "JOG_Q",       [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(jogQueued()); } },
+  // --- headings per UI ---
+  { "HDG_C",       [](EunoFrame& f, const EunoTelemCtx& c){ f.putInt(c.hdgC); } },
+  { "HDG_F",       [](EunoFrame& f, const EunoTelemCtx& c){ f.putInt(c.hdgF); } },
+  { "HDG_E",       [](EunoFrame& f, const EunoTelemCtx& c){ f.putInt(c.hdgE); } },
+  { "HDG_A",       [](EunoFrame& f, const EunoTelemCtx& c){ f.putInt(c.hdgA); } },
+  { "HDG_Q",       [](EunoFrame& f, const EunoTelemCtx&){ f.putInt((int)lroundf(getAhrsHeading()) % 360); } },
+  { "DEV",         [](EunoFrame& f, const EunoTelemCtx& c){ f.putFixed(c.devNow, 1); } },
+  { "DEV_N",       [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(devModel.n); } },
+  { "HEEL",        [](EunoFrame& f, const EunoTelemCtx&){ f.putFixed(ahrs.heelDeg(), 1); } },
+  { "PITCH",       [](EunoFrame& f, const EunoTelemCtx&){ f.putFixed(ahrs.pitchDeg(), 1); } },
+  { "EXTBRG",      [](EunoFrame& f, const EunoTelemCtx&){ telemOnOff(f, externalBearingEnabled); } },
+  { "TRACK",       [](EunoFrame& f, const EunoTelemCtx&){ telemOnOff(f, trackModeEnabled); } },
+  { "XTE",         [](EunoFrame& f, const EunoTelemCtx&){ if (isnan(trackCtl.xteNm)) f.na(); else f.putFixed(trackCtl.xteNm, 3); } },
+  { "XTE_CORR",    [](EunoFrame& f, const EunoTelemCtx&){ f.putFixed(trackCtl.corrDeg, 1); } },
+  { "ROUTE",       [](EunoFrame& f, const EunoTelemCtx&){ telemOnOff(f, routeNav.running); } },
+  { "WIND",        [](EunoFrame& f, const EunoTelemCtx&){ telemOnOff(f, windModeEnabled); } },
+  { "AWA",         [](EunoFrame& f, const EunoTelemCtx& c){ if (c.windOk) f.putFixed(windVane.awaDeg((float)currentHeading), 0); else f.na(); } },
+  { "AWS",         [](EunoFrame& f, const EunoTelemCtx& c){ if (c.windOk && !isnan(windVane.awsKn)) f.putFixed(windVane.awsKn, 1); else f.na(); } },
+  { "AWA_T",       [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(lroundf(windTargetAwa)); } },
+  { "WPT",         [](EunoFrame& f, const EunoTelemCtx&){
+      const EunoWaypoint* w = routeNav.activeWp();
+      if (!w) f.na();
+      else if (w->name[0]) f.puts(w->name);
+      else { f.put('#'); f.putInt(routeNav.r.active); }
+  } },
+  { "DTW",         [](EunoFrame& f, const EunoTelemCtx&){ if (routeNav.running && !isnan(routeNav.leg.dtwNm)) f.putFixed(routeNav.leg.dtwNm, 2); else f.na(); } },
+  { "BTW",         [](EunoFrame& f, const EunoTelemCtx&){ if (routeNav.running && !isnan(routeNav.leg.btwDeg)) f.putInt(lroundf(routeNav.leg.btwDeg) % 360); else f.na(); } },
+  // --- PARAMETRI (telemetria) ---
+  { "V_min",       [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(V_min); } },
+  { "V_max",       [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(V_max); } },
+  { "E_min",       [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(E_min); } },
+  { "E_max",       [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(E_max); } },
+  { "Deadband",    [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(E_tol); } },   // la WebApp usa l’ID 'Deadband'
+  { "E_tol",       [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(E_tol); } },   // alias utile a log/retrocompatibilità
+  { "T_pause",     [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(T_pause); } },
+  { "T_risposta",  [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(T_risposta); } },
+  { "CTRL_MODE",   [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(controlMode); } },
+  { "PID_Kp",      [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(PID_Kp); } },
+  { "PID_Ki",      [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(PID_Ki); } },
+  { "PID_Kd",      [](EunoFrame& f, const EunoTelemCtx&){ f.putInt(PID_Kd); } },
+  { "ROT",         [](EunoFrame& f, const EunoTelemCtx&){ f.putFixed(getRateOfTurn(), 1); } },
+};
+
+static EunoFrame telemFrame;   // solo loop() (taskTelemetry)
+
+static void taskTelemetry() {
+    // 1) Heading “di controllo” e errore
+    int hdgOut;
+    {
+      PROF_SCOPE(PROF_HEADING);
+      hdgOut = getHeadingByMode();
+    }
+    int err    = calculateDifference(hdgOut, headingCommand);
+
+    // 2) Compass per UI smussato (1 Hz, media circolare)
+    static float          hdgC_smoothed = NAN;
+    static unsigned long  hdgC_last     = 0;
+    int   hdgC_raw = getCorrectedHeading();
+    unsigned long now = millis();
+    if (isnan(hdgC_smoothed)) { hdgC_smoothed = hdgC_raw; hdgC_last = now; }
+    if (now - hdgC_last >= 1000) {
+      float diff = fmodf((hdgC_raw - hdgC_smoothed + 540.0f), 360.0f) - 180.0f;
+      hdgC_smoothed = fmodf(hdgC_smoothed + 0.3f * diff + 360.0f, 360.0f);
+      hdgC_last = now;
+    }
+    int hdgC = (int)lroundf(hdgC_smoothed);
+
+    // 3) altri heading
+    int hdgF = (int)round(getFusedHeading());
+    updateExperimental(hdgF);
+    int hdgE = (int)round(getExperimentalHeading());
+    int hdgA = hdgC;
+    if (isAdvancedCalibrationComplete()) {
+      compass.read();
+      hdgA = applyAdvCalibrationInterp3D(
+        compass.getX(), compass.getY(), compass.getZ()
+      );
+    }
+
+    // 4) WebSocket/UI – usa HEADING e ERROR come nel TFT
+    EunoTelemCtx c;
+    c.hdgOut = hdgOut; c.err = err;
+    c.hdgC = hdgC; c.hdgF = hdgF; c.hdgE = hdgE; c.hdgA = hdgA;
+    c.fix = gpsFixGet();
+    c.mot = gpsMotionGet();
+    c.windOk = windVane.valid(now);
+    float hdgRaw = compassHeadingRaw;
+    c.devNow = isnan(hdgRaw) ? 0.0f : devCorrectionDeg(wrap360(hdgRaw - (float)headingOffset));
+    uint32_t telemC0 = eunoCycles();
+    bool ok = telemBuild(telemFrame, "$AUTOPILOT", TELEM_FIELDS, c);
+    eunoProfRecord(PROF_TELEM, eunoCyclesToUs(eunoCycles() - telemC0));
+
+    PROF_SCOPE(PROF_SEND);
+    if (ok) {
+      net.sendWS(telemFrame.c_str(), telemFrame.len);
+      net.sendUDP(telemFrame.c_str(), telemFrame.len);
+    } else {
+      debugLog("TELEM: riga $AUTOPILOT oltre TELEM_FRAME_MAX, non inviata");
+    }
+
+    // 6) NMEA UDP (HDT)
+    telemFrame.begin("$HDT,");
+    telemFrame.putInt(hdgOut);
+    telemFrame.puts(",T");
+    if (telemFrame.finish()) net.sendUDP(telemFrame.c_str(), telemFrame.len);
+}
+
 // ### SETUP E LOOP ###
 void setup() {
   // === INIT ICM-20948 (Pimoroni, I2C @0x68) ===
@@ -694,40 +1316,52 @@ if (!compass.begin(0x68, &Wire)) {
 } else {
   Serial.println("ICM20948 inizializzato.");
 }
+bootMark(BOOT_SENSORS);
 
- EEPROM.begin(2048);
+// Configurazione: record con CRC (euno_config.h); layout precedente → migrazione
+bool cfgOk = cfgBegin();
 loadAdvCalibrationFromEEPROM();
-// 1) Leggi offset SIGNED PRIMA di stampare
-EEPROM.get<int16_t>(0, compassOffsetX);
-EEPROM.get<int16_t>(2, compassOffsetY);
-EEPROM.get<int16_t>(4, compassOffsetZ);
-
-// 2) Leggi headingOffset con fallback (0 se 0xFFFF)
-headingOffset = readHeadingOffsetOr0();
-
-// 3) Ora stampa: prima i raw bytes, poi i valori letti
-Serial.printf("EEPROM 0..5 →  %02X %02X  %02X %02X  %02X %02X\n",
-              EEPROM.read(0), EEPROM.read(1),
-              EEPROM.read(2), EEPROM.read(3),
-              EEPROM.read(4), EEPROM.read(5));
+loadCompassFromEEPROM();  // offset hard-iron interi + offset C-GPS
+loadMagCalFromEEPROM();   // fit a ellissoide (se presente sostituisce offset + scale)
+loadDeviationFromEEPROM(); // curva di deviazione appresa dal COG
+loadParamsFromEEPROM();
+bool warm = loadFusionCheckpoint();   // bias/scala gyro, tilt, heading: warm start della fusion
+
+if (!cfgOk) {
+  // tutto letto dal vecchio layout: ora si può riscrivere sopra
+  String ssid, pass;
+  bool haveCreds = net.loadOpenPlotterCreds(ssid, pass);
+  saveCompassToEEPROM();
+  saveParamsToEEPROM();
+  if (magCal.valid()) saveMagCalToEEPROM();
+  if (devModel.n > 0) saveDeviationToEEPROM();
+  if (advPointCount > 0) saveAdvCalibrationToEEPROM();
+  if (haveCreds) net.saveOpenPlotterCreds(ssid, pass);
+  cfgFinishMigration();
+  cfgFlush();
+  Serial.printf("[CFG] Migrato al formato record v%d%s\n", CFG_SCHEMA, haveCreds ? " (con credenziali)" : "");
+}
+bootMark(BOOT_CONFIG);
+
+Serial.printf("Fusion → %s\n", warm ? "checkpoint ripristinato (warm start)" : "avvio a freddo");
 Serial.printf("Offset letti  →  X=%d  Y=%d  Z=%d\n",
               compassOffsetX, compassOffsetY, compassOffsetZ);
 Serial.printf("HeadingOffset (deg) → %d\n", headingOffset);
+Serial.printf("Fit magnetometro → %s (%dD, fit %.2f%%)\n",
+              magCal.valid() ? "OK" : "assente", magCal.mode, magCal.fitPct);
+Serial.printf("Curva deviazione → %u campioni, %d ottanti, A=%.1f B=%.1f C=%.1f D=%.1f E=%.1f\n",
+              (unsigned)devModel.n, devModel.octants(), devModel.c[0], devModel.c[1], devModel.c[2], devModel.c[3], devModel.c[4]);
 
-// Default/range: adatta se usi altri limiti nella UI
-V_min      = readParamOrDefault(10, /*def*/100, /*min*/0,   /*max*/255);
-V_max      = readParamOrDefault(12, /*def*/255, /*min*/0,   /*max*/255);
-E_min      = readParamOrDefault(14, /*def*/5,   /*min*/0,   /*max*/180);
-E_max      = readParamOrDefault(16, /*def*/40,  /*min*/0,   /*max*/180);
-E_tol      = readParamOrDefault(18, /*def*/1,   /*min*/0,   /*max*/20);
-T_pause    = readParamOrDefault(24, /*def*/0,   /*min*/0,   /*max*/9);
-T_risposta = readParamOrDefault(26, /*def*/10,  /*min*/3,   /*max*/12);
 Serial.printf("[PARAM] Vmin=%d Vmax=%d Emin=%d Emax=%d Etol=%d Tpause=%d Trisp=%d\n",
               V_min, V_max, E_min, E_max, E_tol, T_pause, T_risposta);
+Serial.printf("[PARAM] Ctrl=%s Kp=%d Ki=%d Kd=%d\n",
+              controlMode == CTRL_MODE_PID ? "PID" : "3STATI", PID_Kp, PID_Ki, PID_Kd);
 
 
-  // GPS
-  Serial2.begin(9600, SERIAL_8N1, 16, 17);
+  // GPS: UART a eventi; baud, rate e front end (NMEA/UBX) li imposta il task gps_cfg
+  loadGpsFromEEPROM();
+  loadRouteFromEEPROM();   // rotta a bordo: si riprende solo con ROUTE=START
+  if (!startGpsIngest(Serial2)) Serial.println("[GPS] Task configurazione non avviato!");
 //dns
 // if (MDNS.begin("euno-client")) {
 //   Serial.println("mDNS responder started: http://euno-client.local");
@@ -744,25 +1378,50 @@ Serial.printf("[PARAM] Vmin=%d Vmax=%d Emin=%d Emax=%d Etol=%d Tpause=%d Trisp=%
 
 
 
+  // Avvio a fasi: prima acquisizione e controllo (time-to-steer), la rete e
+  // il BLE salgono poi dal loop() (taskBoot, EunoNetwork::beginStep)
+
+  // FIFO ICM + task di acquisizione; se fallisce la fusion usa lo snapshot.
+  // Prima del task di controllo: la FIFO si configura col bus I2C libero
+  if (startIcmAcquisition(compass)) {
+    Serial.printf("[ICM] FIFO attiva @%.0f Hz (INT pin %d)\n", compass.fifoRateHz(), ICM_INT_PIN);
+  } else {
+    Serial.println("[ICM] FIFO non disponibile, lettura a snapshot");
+  }
+
+  // Scheduler: rate dichiarate + priorità (più alta = prima)
+  ctrlSched.add("fusion",  FUSION_TASK_HZ,  2, taskFusion);
+  ctrlSched.add("control", CONTROL_TASK_HZ, 1, taskControl);
+
+  if (!startEunoRtTask(ctrlSched, "euno_ctrl")) {
+    Serial.println("[SCHED] Task controllo non avviato!");
+  }
+
+  loopSched.add("boot",      10.0f,         5, taskBoot);
+  loopSched.add("telemetry", TELEM_TASK_HZ, 3, taskTelemetry);
+  loopSched.add("legacy",    1.0f,          2, taskLegacyTelemetry);
+  loopSched.add("cal",       20.0f,         4, taskCalibration);
+  loopSched.add("deviation", 5.0f,          1, taskDeviation);
+  loopSched.add("config",    5.0f,          0, taskConfig);
+  loopSched.add("tilt_dbg",  0.5f,          0, taskTiltDebug);
+  loopSched.add("sched_dbg", 0.1f,          0, taskSchedStats);
+  loopSched.add("stat",      1.0f,          1, taskStatFrame);
+  loopSched.add("route",     5.0f,          4, taskRoute);
+  loopSched.add("wind",      2.0f,          1, taskWind);
+
   // === Rete/UI: STA(EUNOAP→OP) con fallback AP; mDNS, HTTP(/), WS(:81), UDP(:10110)
+  // Solo configurazione e callback qui: l'avvio vero lo fa net.loop() a passi
   EUNO_LOAD_OP_CREDS(net);
   net.cfg.sta1_ssid = "";
   net.cfg.sta1_pass = "";
 
-  net.begin();
-udp.begin(serverPort); // abilita UDP in ingresso
-
-
   net.onUdpLine   = [](const String& s){ EUNO_PARSE(s); };
+  net.onStatsJson = [](bool reset){ return buildStatsJson(reset); };
   net.onUiCommand = [](const String& s){
     Serial.println("[WS RX] " + s);   // <--- debug: stampa i comandi che arrivano dal TFT via WS
     EUNO_PARSE(s);
   };
 
-
-
-
-
   // Collega callback API
   api.onDelta            = [](int v){ api_cmdDelta_internal(v); };
   api.onToggle           = [](){ api_cmdToggle_internal(); };
@@ -771,277 +1430,60 @@ udp.begin(serverPort); // abilita UDP in ingresso
   api.onCal              = [](const String& w){ api_cmdCal_internal(w); };
   api.onExtBrg           = [](bool on){ api_cmdExtBrg_internal(on); };
   api.onExternalBearing  = [](int brg){ api_cmdExternalBearing_internal(brg); };
+  api.onNavTarget        = [](const EunoNavTarget& t){ api_onNavTarget_internal(t); };
+  api.onTrack            = [](bool on){ api_cmdTrack_internal(on); };
+  api.onRoute            = [](const String& v){ api_cmdRoute_internal(v); };
+  api.onWind             = [](const EunoWindObs& w){ api_onWind_internal(w); };
+  api.onWindMode         = [](const String& v){ api_cmdWindMode_internal(v); };
+  api.onAwa              = [](int a){ windSetTarget((float)a); };
+  net.onFastLine         = [](const char* s){ return parseNMEAFast(s, api); };
+  api.onWpt              = [](const String& v){ api_cmdWpt_internal(v); };
+  net.onRouteJson        = [](){ return routeJson(); };
+  net.onRoutePost        = [](const String& b){ return api_routePost_internal(b); };
+  api.onStat             = [](bool on){ api_cmdStat_internal(on); };
+  api.onGps              = [](const String& fe){ api_cmdGps_internal(fe); };
   api.onOpenPlotterFrame = [](const String& kind,const String& raw){ api_onOpenPlotterFrame_internal(kind,raw); };
 
-ble.begin();
-ble.onPeunoCmd = [](const char* line){
-  Serial.printf("[BLE→PEUNO] %s\n", line);   // debug: vedi cosa entra
-  extern EunoNetwork net;                    // <-- metti il NOME reale della tua istanza rete
-  net.onUdpLine(String(line));               // stesso ingresso dei comandi da rete
-};
-
+  // ble.begin() lo chiama taskBoot() a rete su
+  ble.onPeunoCmd = [](const char* line){
+    Serial.printf("[BLE→PEUNO] %s\n", line);   // debug: vedi cosa entra
+    extern EunoNetwork net;                    // <-- metti il NOME reale della tua istanza rete
+    net.onUdpLine(String(line));               // stesso ingresso dei comandi da rete
+  };
 
+  Serial.printf("[BOOT] setup() finito @%lu ms (controllo avviato, rete in background)\n", millis());
 }
 
 void loop() {
+  PROF_SCOPE(PROF_LOOP);
+
   // Servizi di rete non bloccanti
-  net.loop();
+  {
+    PROF_SCOPE(PROF_NET);
+    net.loop();
+  }
   // enow.loop();
 
-ble.loop();
-
-  unsigned long currentMillis = millis();
-// === Sensor Fusion update (100 Hz) ===
-updateSensorFusion();
-
-  // Lettura sensori ogni 100 ms
-  if (currentMillis - lastSensorUpdate >= sensorUpdateInterval) {
-    lastSensorUpdate = currentMillis;
-
-    if (isAdvancedCalibrationMode()) {
-      compass.read();
-      updateAdvancedCalibration(headingGyro, compass.getX(), compass.getY(), compass.getZ());
-
-      if (isAdvancedCalibrationComplete()) {
-        saveAdvCalibrationToEEPROM();
-        debugLog("Calibrazione completata. ADV salvata su EEPROM.");
-        udp.beginPacket(serverIP, serverPort); udp.print("EXPCAL_DONE"); udp.endPacket();
-        debugLog("Risposta EXPCAL_DONE inviata all’AP");
-      }
-    }
-
-    // Aggiorna heading corrente
-    if (useGPSHeading && gps.speed.isValid() && gps.course.isValid()) {
-      currentHeading = (int)round(getFusedHeading());
-    } else {
-      compass.read();
-      currentHeading = getCorrectedHeading();
-    }
-  }
-
-
-
-  // gestione loop adv (non blocca)
-  if (isAdvancedCalibrationMode()) {
-    compass.read();
-    updateAdvancedCalibration(headingGyro, compass.getX(), compass.getY(), compass.getZ());
-    if (isAdvancedCalibrationComplete()) {
-      debugLog("DEBUG: Calibrazione ADVANCED completata");
-    }
+  {
+    PROF_SCOPE(PROF_BLE);
+    ble.loop();
   }
 
   // Gestione comandi UDP in arrivo
-  int packetSize = udp.parsePacket();
-  if (packetSize > 0) {
-    int len = udp.read(incomingPacket, 255);
-    if (len > 0) {
-      incomingPacket[len] = '\0';
-      String command = String(incomingPacket);
-      debugLog(String("DEBUG(Client) UDP -> ") + command);
-      handleCommandClient(command);
-    }
-  }
-
-  // Lettura dati GPS
-  while (Serial2.available()) {
-    char c = Serial2.read();
-    gps.encode(c);
-  }
-
-  // Operazioni a 1Hz
-  static unsigned long last1HzUpdate = 0;
-  if (currentMillis - last1HzUpdate >= 1000) {
-    last1HzUpdate = currentMillis;
-
-    int headingCompass = getCorrectedHeading();
-    float headingFusion = getFusedHeading();
-    updateExperimental(headingFusion);
-    float headingExp = getExperimentalHeading();
-
-    if (headingSourceMode == 0) {
-      currentHeading = getCorrectedHeading();
-    } else if (headingSourceMode == 1) {
-      currentHeading = round(getFusedHeading());
-    } else if (headingSourceMode == 2) {
-      currentHeading = round(getExperimentalHeading());
-    } else if (headingSourceMode == 3) {
-      compass.read();
-      currentHeading = applyAdvCalibration(compass.getX(), compass.getY()); // HEADING=
-    }
-
-    int diff = calculateDifference(currentHeading, headingCommand);
-    sendNMEAData(currentHeading, headingCommand, diff, gps);
-
-    currentHeading = (currentHeading + 360) % 360;
-    diff = calculateDifference(currentHeading, headingCommand);
-    sendNMEAData(currentHeading, headingCommand, diff, gps);
-  }
-
-  // Controllo motore a duty ciclico
-  if (motorControllerState) {
-    int pauseTime = T_pause * 100;
-    int activeTime = 1000 - pauseTime;
-    if (activeTime < 200) activeTime = 200;
-
-    unsigned long now = millis();
-
-    if (motorPhaseActive) {
-      if (now - motorPhaseStartTime >= activeTime) {
-        stopMotor();
-        motorPhaseActive = false;
-        motorPhaseStartTime = now;
-      }
-    } else {
-      if (now - motorPhaseStartTime >= pauseTime) {
-        int errore = abs(calculateDifference(currentHeading, headingCommand));
-
-        lastErrors[erroreIndex % 3] = errore;
-        erroreIndex++;
-
-        if (erroreIndex >= 3) {
-          int e0 = lastErrors[(erroreIndex - 3) % 3];
-          int e1 = lastErrors[(erroreIndex - 2) % 3];
-          int e2 = lastErrors[(erroreIndex - 1) % 3];
-
-          debugLog("DEBUG ERRORI: " + String(e0) + " → " + String(e1) + " → " + String(e2));
-
-          if (e2 < e1 && e1 < e0) {
-            shouldStopMotor = true;
-            debugLog("STOP MOTORE: errore in calo per 3 cicli");
-          } else {
-            shouldStopMotor = false;
-          }
-        }
-
-        if (shouldStopMotor) {
-          stopMotor();
-          motorPhaseActive = false;
-          motorPhaseStartTime = now;
-        } else {
-          int velocita_correzione = calcola_velocita_e_verso(currentHeading, headingCommand);
-          gestisci_attuatore(velocita_correzione);
-          motorPhaseActive = true;
-          motorPhaseStartTime = now;
-        }
+  {
+    PROF_SCOPE(PROF_UDP_RX);
+    int packetSize = udp.parsePacket();
+    if (packetSize > 0) {
+      int len = udp.read(incomingPacket, 255);
+      if (len > 0) {
+        incomingPacket[len] = '\0';
+        String command = String(incomingPacket);
+        debugLog(String("DEBUG(Client) UDP -> ") + command);
+        handleCommandClient(command);
       }
     }
   }
 
-  // Gestione calibrazione se attiva
-  if (calibrationMode) {
-    performCalibration(millis());
-  }
-// Nel loop principale, aggiungi:
-static unsigned long lastTiltDebug = 0;
-if (millis() - lastTiltDebug > 2000) {
-    lastTiltDebug = millis();
-    
-    float pitch, roll;
-    getTiltAngles(pitch, roll);
-    
-    Serial.printf("Tilt: Pitch=%.1f°, Roll=%.1f°\n", 
-                 pitch * 180.0/M_PI, roll * 180.0/M_PI);
-    Serial.printf("Offsets: Pitch=%.3f, Roll=%.3f rad\n", 
-                 accPitchOffset, accRollOffset);
-}
-  // === TELEMETRIA $AUTOPILOT (WS + ESP-NOW + UDP HDT) =====================
-  static unsigned long _lastTel = 0;
-  if (millis() - _lastTel >= 1000) {
-
-    // 1) Heading “di controllo” e errore
-    int hdgOut = getHeadingByMode();
-    int err    = calculateDifference(hdgOut, headingCommand);
-
-    // 2) Compass per UI smussato (1 Hz, media circolare)
-    static float          hdgC_smoothed = NAN;
-    static unsigned long  hdgC_last     = 0;
-    int   hdgC_raw = getCorrectedHeading();
-    unsigned long now = millis();
-    if (isnan(hdgC_smoothed)) { hdgC_smoothed = hdgC_raw; hdgC_last = now; }
-    if (now - hdgC_last >= 1000) {
-      float diff = fmodf((hdgC_raw - hdgC_smoothed + 540.0f), 360.0f) - 180.0f;
-      hdgC_smoothed = fmodf(hdgC_smoothed + 0.3f * diff + 360.0f, 360.0f);
-      hdgC_last = now;
-    }
-    int hdgC = (int)lroundf(hdgC_smoothed);
-
-    // 3) altri heading
-    int hdgF = (int)round(getFusedHeading());
-    updateExperimental(hdgF);
-    int hdgE = (int)round(getExperimentalHeading());
-    int hdgA = hdgC;
-    if (isAdvancedCalibrationComplete()) {
-      compass.read();
-      hdgA = applyAdvCalibrationInterp3D(
-        compass.getX(), compass.getY(), compass.getZ()
-      );
-    }
-
-
-
-    // 5) ESP-NOW per TFT
-  // 4) WebSocket/UI – usa HEADING e ERROR come nel TFT
-// 4) WebSocket/UI – usa HEADING e ERROR come nel TFT
-String telem = String("$AUTOPILOT")
-             + ",HEADING="     + String(hdgOut)
-             + ",COMMAND="     + String(headingCommand)
-             + ",ERROR="       + String(err)
-             + ",GPS_HEADING=" + (gps.course.isValid() ? String((int)gps.course.deg()) : "N/A")
-             + ",GPS_SPEED="   + (gps.speed.isValid()  ? String(gps.speed.knots(),1)    : "N/A")
-             + ",MODE="        + String(headingSourceMode)
-             + ",MOTOR="       + String(motorControllerState ? "ON" : "OFF")
-             // --- headings per UI ---
-             + ",HDG_C="       + String(hdgC)
-             + ",HDG_F="       + String(hdgF)
-             + ",HDG_E="       + String(hdgE)
-             + ",HDG_A="       + String(hdgA)
-             + ",EXTBRG="      + String(externalBearingEnabled ? "ON" : "OFF")
-             // --- PARAMETRI (telemetria) ---
-             + ",V_min="       + String(V_min)
-             + ",V_max="       + String(V_max)
-             + ",E_min="       + String(E_min)
-             + ",E_max="       + String(E_max)
-             + ",Deadband="    + String(E_tol)     // la WebApp usa l’ID 'Deadband'
-             + ",E_tol="       + String(E_tol)     // alias utile a log/retrocompatibilità
-             + ",T_pause="     + String(T_pause)
-             + ",T_risposta="  + String(T_risposta);
-
-net.sendWS(telem);
- net.sendUDP(telem);
-Serial.println("[DEBUG] sendWS: " + telem);
-
-    // 6) NMEA UDP (HDT)
-    String hdt = String("$HDT,") + String(hdgOut) + ",T";
-    net.sendUDP(hdt);
-
-    _lastTel = millis();
-  }
+  // Calibrazioni, telemetria, debug (fusion e motore girano nel task di controllo)
+  loopSched.runDue();
 } // <-- chiude void loop()
-
-// ------------------------------------------------------------
-// Calibrazione avanzata 2D (nearest neighbor su tabella ADV)
-// ------------------------------------------------------------
-int applyAdvCalibration(float x, float y) {
-  if (advPointCount == 0) {
-    float heading = atan2(y, x) * 180.0f / M_PI;
-    if (heading < 0) heading += 360.0f;
-    return (int)lroundf(heading);
-  }
-
-  float bestDist = 1e9f;
-  int   bestHeading = 0;
-
-  for (int i = 0; i < advPointCount; ++i) {
-    float dx = x - advTable[i].rawX;
-    float dy = y - advTable[i].rawY;
-    float dist = sqrtf(dx*dx + dy*dy);
-    if (dist < bestDist) {
-      bestDist    = dist;
-      bestHeading = advTable[i].headingDeg;
-    }
-  }
-
-  bestHeading %= 360;
-  if (bestHeading < 0) bestHeading += 360;
-  return bestHeading;
-}
@@ -0,0 +1,74 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// gps_fix.h — ultimo fix GPS, comune ai due front end (NMEA/TinyGPSPlus e UBX)
+//
+// Chi riceve (task eventi UART, gps_ingest.h) pubblica un EunoGpsFix completo;
+// fusion (task di controllo) e loop() lo leggono con gpsFixGet() (seqlock).
+// Le accuratezze (1σ) ci sono solo con UBX NAV-PVT; con NMEA sono NAN.
+
+#ifndef GPS_FIX_H
+#define GPS_FIX_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <math.h>
+#include <stdint.h>
+
+enum EunoGpsSource : uint8_t { GPS_SRC_NONE = 0, GPS_SRC_NMEA, GPS_SRC_UBX };
+
+struct EunoGpsFix {
+  uint32_t ms       = 0;          // millis() del fix (0 = mai)
+  bool     valid    = false;      // COG e SOG validi
+  bool     posValid = false;
+  uint8_t  source   = GPS_SRC_NONE;
+  uint8_t  numSV    = 0;
+  float    cogDeg   = 0.0f;       // rotta sul fondo, 0..360
+  float    sogKn    = 0.0f;
+  float    cogAccDeg = NAN;       // accuratezza COG (UBX headAcc)
+  float    sogAccKn  = NAN;       // accuratezza SOG (UBX sAcc)
+  double   lat = 0.0, lon = 0.0;
+
+  uint32_t ageMs(uint32_t now) const { return ms ? now - ms : 0xFFFFFFFFu; }
+};
+
+// Seqlock: un solo scrittore, i lettori ripetono la copia se l'hanno presa a
+// metà (niente lock nel task di controllo). Anche per gps_motion.h.
+template <typename T>
+struct EunoSeqlock {
+  T                     val;
+  std::atomic<uint32_t> seq{0};
+
+  void publish(const T& v){
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    val = v;
+    std::atomic_thread_fence(std::memory_order_release);
+    seq.store(s + 2, std::memory_order_relaxed);
+  }
+
+  T get() const {
+    T v;
+    uint32_t s0, s1;
+    do {
+      s0 = seq.load(std::memory_order_acquire);
+      v = val;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      s1 = seq.load(std::memory_order_relaxed);
+    } while ((s0 & 1) || s0 != s1);
+    return v;
+  }
+};
+
+static EunoSeqlock<EunoGpsFix> gpsFixLock;
+
+static inline void       gpsFixPublish(const EunoGpsFix& f){ gpsFixLock.publish(f); }
+static inline EunoGpsFix gpsFixGet(){ return gpsFixLock.get(); }
+static inline void gpsFixReset(){ gpsFixPublish(EunoGpsFix()); }
+
+#endif // GPS_FIX_H
@@ -0,0 +1,385 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// gps_ingest.h — ricezione GPS a eventi UART + configurazione del ricevitore
+//
+// - Serial2 con buffer RX ampio e onReceive(): i byte arrivano a TinyGPSPlus
+//   dal task eventi UART del core, non più da loop() (che a 9600 baud e con
+//   chiamate bloccanti lasciava traboccare la FIFO)
+// - All'avvio un task una tantum (gps_cfg) cerca il baud del ricevitore,
+//   lo porta a GPS_BAUD_TARGET e a GPS_RATE_HZ e lascia solo RMC/VTG/GGA:
+//     u-blox M8 e precedenti: UBX-CFG-PRT / CFG-RATE / CFG-MSG
+//     u-blox M9/M10:          UBX-CFG-VALSET (RAM)
+//     MediaTek/Quectel:       $PMTK251 / $PMTK220 / $PMTK314
+//   Ogni famiglia ignora i comandi delle altre: si mandano tutti. Se al nuovo
+//   baud non arriva NMEA valido si torna al baud trovato a 1 Hz.
+// - Front end selezionabile ($PEUNO,CMD,GPS=NMEA|UBX, record CFG_GPS):
+//     NMEA: TinyGPSPlus, un fix pubblicato a ogni RMC
+//     UBX:  NAV-PVT (gps_ubx.h), NMEA spento sul ricevitore; fix con
+//           accuratezza di COG e SOG. Senza NAV-PVT da GPS_UBX_STALE_MS
+//           (ricevitore non u-blox) torna a pubblicare l'NMEA
+//   Il risultato è sempre un EunoGpsFix (gps_fix.h) per fusion e loop().
+
+#ifndef GPS_INGEST_H
+#define GPS_INGEST_H
+
+#include <Arduino.h>
+#include <TinyGPSPlus.h>
+#include <stdint.h>
+#include <string.h>
+#include "euno_profiler.h"
+#include "euno_config.h"
+#include "gps_fix.h"
+#include "gps_ubx.h"
+
+#define GPS_RX_PIN        16
+#define GPS_TX_PIN        17
+#define GPS_BAUD_TARGET   115200UL
+#define GPS_RATE_HZ       10          // 5..10: RMC+VTG+GGA ≈ 2.4 kB/s @10 Hz
+#define GPS_RX_BUF        2048        // ~0.8 s a 10 Hz: copre commit EEPROM e scan BLE
+#define GPS_PROBE_MS      1500UL      // ascolto per baud candidato
+#define GPS_PROBE_MIN     2           // frasi con checksum valido per dire "trovato"
+#define GPS_UBX_STALE_MS  2000UL      // senza NAV-PVT da... → fix dall'NMEA
+#define GPS_CFG_VER       1           // record CFG_GPS (euno_config.h)
+
+extern TinyGPSPlus gps;
+
+// Scanner NMEA minimo: checksum e id frase ("RMC", "GGA"...), senza parsing
+// dei campi. Serve alla sonda del baud e alla misura del rate dei fix.
+struct EunoNmeaScan {
+  char    id[6] = {0};
+  uint8_t idLen = 0, cs = 0, rxCs = 0;
+  int8_t  state = 0;        // 0 attesa '$', 1 corpo, 2-3 cifre checksum
+
+  static int8_t hexVal(char c){
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+  }
+
+  // true quando si chiude una frase con checksum valido (id in id[])
+  bool feed(char c){
+    if (c == '$') { state = 1; cs = 0; idLen = 0; id[0] = 0; return false; }
+    switch (state) {
+      case 1:
+        if (c == '*') { state = 2; rxCs = 0; return false; }
+        if (c == '\r' || c == '\n' || (uint8_t)c < 0x20) { state = 0; return false; }
+        cs ^= (uint8_t)c;
+        if (idLen < 5 && c != ',') { id[idLen++] = c; id[idLen] = 0; }
+        return false;
+      case 2:
+      case 3: {
+        int8_t v = hexVal(c);
+        if (v < 0) { state = 0; return false; }
+        rxCs = (uint8_t)((rxCs << 4) | v);
+        if (state == 2) { state = 3; return false; }
+        state = 0;
+        return rxCs == cs;
+      }
+      default:
+        return false;
+    }
+  }
+
+  // "GPRMC"/"GNRMC" → "RMC" (talker di 2 lettere)
+  bool is(const char* type) const { return idLen == 5 && strcmp(id + 2, type) == 0; }
+};
+
+// Stato e contatori (/api/stats "gps")
+static volatile uint32_t gpsBaud      = 0;   // 0 = ricevitore non trovato (ancora)
+static volatile uint32_t gpsChars     = 0;
+static volatile uint32_t gpsSentences = 0;   // checksum valido
+static volatile uint32_t gpsOverruns  = 0;   // FIFO/buffer UART pieni
+static volatile float    gpsRateHz    = 0.0f;   // RMC al secondo, misurato
+static volatile bool     gpsConfigured = false; // rate/baud alti confermati
+static volatile bool     gpsCfgRunning = false; // task gps_cfg in corso: la UART è sua
+
+enum EunoGpsFrontEnd : uint8_t { GPS_FE_NMEA = 0, GPS_FE_UBX = 1 };
+static volatile uint8_t  gpsFrontEnd  = GPS_FE_NMEA;
+
+struct EunoGpsCfg {
+  uint8_t frontEnd;
+  uint8_t reserved[3];
+};
+CFG_ASSERT_FITS(CFG_GPS, EunoGpsCfg);
+
+static inline void loadGpsFromEEPROM(){
+  EunoGpsCfg c;
+  if (cfgLoad(CFG_GPS, &c, sizeof(c), GPS_CFG_VER) == CFG_LOAD_OK && c.frontEnd <= GPS_FE_UBX) gpsFrontEnd = c.frontEnd;
+}
+
+static inline void saveGpsToEEPROM(){
+  EunoGpsCfg c = { gpsFrontEnd, {0, 0, 0} };
+  cfgStore(CFG_GPS, &c, sizeof(c), GPS_CFG_VER);
+}
+
+static inline const char* gpsFrontEndName(){ return gpsFrontEnd == GPS_FE_UBX ? "UBX" : "NMEA"; }
+
+// ---- instradamento byte → parser → fix ----------------------------------
+static EunoNmeaScan   gpsScan;
+static EunoUbxParser  gpsUbx;
+static bool           gpsRmcPending = false;
+static uint32_t       gpsUbxLastMs  = 0;
+static uint32_t       gpsFixWin = 0, gpsFixWinStart = 0;
+
+// Fix dai campi TinyGPSPlus (COG/SOG dall'ultima RMC, niente accuratezze)
+static inline void gpsFixFromNmea(const TinyGPSPlus& g, uint32_t now, EunoGpsFix& f){
+  f = EunoGpsFix();
+  f.ms       = now ? now : 1;
+  f.source   = GPS_SRC_NMEA;
+  f.valid    = g.course.isValid() && g.speed.isValid();
+  f.posValid = g.location.isValid();
+  f.numSV    = (uint8_t)g.satellites.value();
+  f.cogDeg   = (float)g.course.deg();
+  f.sogKn    = (float)g.speed.knots();
+  f.lat      = g.location.lat();
+  f.lon      = g.location.lng();
+}
+
+// Un byte dalla UART. I frame UBX (B5 62 ...) non toccano TinyGPSPlus; in
+// modalità UBX l'NMEA è spento sul ricevitore e di fatto non c'è.
+static inline void gpsIngestByte(uint8_t b, uint32_t now){
+  EunoUbxFeed r = gpsUbx.feed(b);
+  if (r == UBX_FRAME) {
+    EunoGpsFix f;
+    if (gpsFrontEnd == GPS_FE_UBX && ubxNavPvtToFix(gpsUbx, now, f)) {
+      gpsFixPublish(f);
+      gpsUbxLastMs = now;
+      gpsFixWin++;
+    }
+    return;
+  }
+  if (r == UBX_BUSY) return;
+
+  char c = (char)b;
+  bool committed = gps.encode(c);
+  if (gpsScan.feed(c)) {
+    gpsSentences++;
+    if (gpsScan.is("RMC")) gpsRmcPending = true;   // TinyGPSPlus la chiude al CR
+  }
+  if (committed && gpsRmcPending) {
+    gpsRmcPending = false;
+    bool ubxLive = gpsFrontEnd == GPS_FE_UBX && gpsUbxLastMs && now - gpsUbxLastMs < GPS_UBX_STALE_MS;
+    if (!ubxLive) {
+      EunoGpsFix f;
+      gpsFixFromNmea(gps, now, f);
+      gpsFixPublish(f);
+      gpsFixWin++;
+    }
+  }
+}
+
+#if defined(ESP32)
+static HardwareSerial* gpsPort = nullptr;
+
+// ---- comandi ricevitore -------------------------------------------------
+static inline void gpsSendNmea(const char* body){
+  uint8_t cs = 0;
+  for (const char* p = body; *p; p++) cs ^= (uint8_t)*p;
+  char tail[6];
+  snprintf(tail, sizeof(tail), "*%02X\r\n", cs);
+  gpsPort->print('$');
+  gpsPort->print(body);
+  gpsPort->print(tail);
+}
+
+static inline void gpsSendUbx(uint8_t cls, uint8_t id, const uint8_t* payload, uint16_t len){
+  uint8_t hdr[6] = { 0xB5, 0x62, cls, id, (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+  uint8_t ckA = 0, ckB = 0;
+  for (int i = 2; i < 6; i++) { ckA += hdr[i]; ckB += ckA; }
+  for (uint16_t i = 0; i < len; i++) { ckA += payload[i]; ckB += ckA; }
+  gpsPort->write(hdr, 6);
+  if (len) gpsPort->write(payload, len);
+  gpsPort->write(ckA);
+  gpsPort->write(ckB);
+}
+
+static inline void gpsPutU16(uint8_t* p, uint16_t v){ p[0] = v & 0xFF; p[1] = v >> 8; }
+static inline void gpsPutU32(uint8_t* p, uint32_t v){ for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xFF; }
+
+// UBX-CFG-VALSET in RAM: una chiave con valore di 1, 2 o 4 byte
+static inline void gpsUbxValset(uint32_t key, uint32_t val, uint8_t size){
+  uint8_t p[12] = { 0x00, 0x01, 0x00, 0x00 };   // versione 0, layer RAM
+  gpsPutU32(p + 4, key);
+  gpsPutU32(p + 8, val);
+  gpsSendUbx(0x06, 0x8A, p, (uint16_t)(8 + size));
+}
+
+// UBX-CFG-PRT UART1: 8N1, in UBX+NMEA; out UBX+NMEA o solo UBX
+static inline void gpsUbxPrt(uint32_t baud, bool nmeaOut){
+  uint8_t prt[20] = {0};
+  prt[0] = 1;
+  gpsPutU32(prt + 4, 0x000008D0);
+  gpsPutU32(prt + 8, baud);
+  gpsPutU16(prt + 12, 0x0003);
+  gpsPutU16(prt + 14, nmeaOut ? 0x0003 : 0x0001);
+  gpsSendUbx(0x06, 0x00, prt, sizeof(prt));
+}
+
+static inline void gpsCmdBaud(uint32_t baud){
+  gpsUbxPrt(baud, gpsFrontEnd != GPS_FE_UBX);
+  gpsUbxValset(0x40520001, baud, 4);             // CFG-UART1-BAUDRATE
+
+  char b[24];
+  snprintf(b, sizeof(b), "PMTK251,%lu", (unsigned long)baud);
+  gpsSendNmea(b);
+}
+
+static inline void gpsCmdRate(int hz){
+  uint16_t ms = (uint16_t)(1000 / hz);
+  uint8_t rate[6];
+  gpsPutU16(rate + 0, ms);                       // measRate
+  gpsPutU16(rate + 2, 1);                        // navRate
+  gpsPutU16(rate + 4, 1);                        // timeRef GPS
+  gpsSendUbx(0x06, 0x08, rate, sizeof(rate));
+  gpsUbxValset(0x30210001, ms, 2);               // CFG-RATE-MEAS
+
+  // via GLL, GSA, GSV: a 10 Hz i satelliti da soli saturerebbero la linea
+  static const uint8_t offIds[] = { 0x01, 0x02, 0x03 };
+  for (uint8_t id : offIds) {
+    uint8_t msg[3] = { 0xF0, id, 0 };
+    gpsSendUbx(0x06, 0x01, msg, sizeof(msg));
+  }
+  gpsUbxValset(0x209100ca, 0, 1);                // CFG-MSGOUT-NMEA_ID_GLL_UART1
+  gpsUbxValset(0x209100c0, 0, 1);                // ..._GSA_UART1
+  gpsUbxValset(0x209100c5, 0, 1);                // ..._GSV_UART1
+
+  char b[24];
+  snprintf(b, sizeof(b), "PMTK220,%u", (unsigned)ms);
+  gpsSendNmea(b);
+  gpsSendNmea("PMTK314,0,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0");   // RMC, VTG, GGA
+}
+
+// NAV-PVT on/off e uscita NMEA secondo il front end (u-blox; gli altri ignorano)
+static inline void gpsCmdFrontEnd(uint8_t fe){
+  bool ubx = (fe == GPS_FE_UBX);
+  uint8_t msg[3] = { UBX_CLS_NAV, UBX_ID_NAV_PVT, (uint8_t)(ubx ? 1 : 0) };
+  gpsSendUbx(0x06, 0x01, msg, sizeof(msg));
+  gpsUbxValset(0x20910007, ubx ? 1 : 0, 1);      // CFG-MSGOUT-UBX_NAV_PVT_UART1
+  gpsUbxPrt(gpsBaud ? gpsBaud : GPS_BAUD_TARGET, !ubx);
+  gpsUbxValset(0x10740002, ubx ? 0 : 1, 1);      // CFG-UART1OUTPROT-NMEA
+}
+
+// Cambio a runtime ($PEUNO,CMD,GPS=...): comandi al ricevitore + record.
+// false mentre gps_cfg sonda il baud e configura il ricevitore: i comandi
+// si mescolerebbero ai suoi (o andrebbero al baud sbagliato), si riprova dopo
+static inline bool gpsSelectFrontEnd(uint8_t fe){
+  if (fe > GPS_FE_UBX || gpsCfgRunning) return false;
+  gpsFrontEnd = fe;
+  if (gpsPort && gpsBaud) gpsCmdFrontEnd(fe);
+  saveGpsToEEPROM();
+  return true;
+}
+
+// ---- sonda --------------------------------------------------------------
+// Ascolta a `baud` per ms: frasi/frame validi e fix (RMC o NAV-PVT) ricevuti,
+// intanto pubblica i fix
+static inline void gpsListen(uint32_t baud, uint32_t ms, int& sentences, int& fixes){
+  gpsPort->updateBaudRate(baud);
+  while (gpsPort->available()) gpsPort->read();
+  uint32_t s0 = gpsSentences, u0 = gpsUbx.frames, f0 = gpsFixWin;
+  uint32_t t0 = millis();
+  while (millis() - t0 < ms) {
+    while (gpsPort->available()) gpsIngestByte((uint8_t)gpsPort->read(), millis());
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+  sentences = (int)(gpsSentences - s0 + gpsUbx.frames - u0);
+  fixes     = (int)(gpsFixWin - f0);
+}
+
+static inline uint32_t gpsFindBaud(){
+  static const uint32_t cands[] = { GPS_BAUD_TARGET, 9600, 38400, 57600, 4800 };
+  for (uint32_t b : cands) {
+    int n, fixes;
+    gpsListen(b, GPS_PROBE_MS, n, fixes);
+    if (n >= GPS_PROBE_MIN) return b;
+  }
+  return 0;
+}
+
+// ---- ricezione a eventi -------------------------------------------------
+static void gpsOnReceive(){
+  PROF_SCOPE(PROF_GPS);
+  uint32_t now = millis();
+  int n = gpsPort->available();
+  for (int i = 0; i < n; i++) gpsIngestByte((uint8_t)gpsPort->read(), now);
+  gpsChars += n;
+  if (now - gpsFixWinStart >= 2000) {
+    gpsRateHz = gpsFixWin * 1000.0f / (float)(now - gpsFixWinStart);
+    gpsFixWin = 0;
+    gpsFixWinStart = now;
+  }
+}
+
+static void gpsOnReceiveError(hardwareSerial_error_t e){
+  if (e == UART_BUFFER_FULL_ERROR || e == UART_FIFO_OVF_ERROR) gpsOverruns++;
+}
+
+// Task una tantum: baud, rate, poi consegna a onReceive() e termina
+static void gpsCfgTaskBody(void*){
+  uint32_t found = gpsFindBaud();
+  if (found) {
+    int n = 0, fixes = 0;
+    bool needRate = true;
+    if (found == GPS_BAUD_TARGET) {
+      // già configurato (RAM con batteria tampone)? basta misurare il rate
+      gpsListen(GPS_BAUD_TARGET, 2000, n, fixes);
+      needRate = fixes < GPS_RATE_HZ * 2 * 8 / 10;
+      if (!needRate) gpsCmdFrontEnd(gpsFrontEnd);   // il front end può essere cambiato
+    } else {
+      gpsCmdBaud(GPS_BAUD_TARGET);
+      gpsPort->flush();
+      vTaskDelay(pdMS_TO_TICKS(150));
+    }
+    if (needRate) {
+      gpsPort->updateBaudRate(GPS_BAUD_TARGET);
+      vTaskDelay(pdMS_TO_TICKS(100));
+      gpsCmdRate(GPS_RATE_HZ);
+      gpsCmdFrontEnd(gpsFrontEnd);
+      gpsPort->flush();
+      gpsListen(GPS_BAUD_TARGET, 2000, n, fixes);
+    }
+    if (n >= GPS_PROBE_MIN) {
+      gpsBaud = GPS_BAUD_TARGET;
+      gpsConfigured = fixes >= GPS_RATE_HZ;   // almeno metà del rate chiesto nei 2 s
+      gpsRateHz = fixes / 2.0f;
+    } else {
+      // il ricevitore non ha seguito: resta dov'era, a 1 Hz
+      gpsPort->updateBaudRate(found);
+      gpsBaud = found;
+    }
+  }
+  if (gpsBaud) {
+    Serial.printf("[GPS] %lu baud, %.1f Hz, %s%s\n", (unsigned long)gpsBaud, gpsRateHz,
+                  gpsFrontEndName(), gpsConfigured ? "" : " (configurazione non accettata)");
+  } else {
+    Serial.println("[GPS] nessun NMEA: in ascolto @115200");
+    gpsPort->updateBaudRate(GPS_BAUD_TARGET);
+  }
+
+  gpsFixWin = 0;
+  gpsFixWinStart = millis();
+  gpsPort->onReceiveError(gpsOnReceiveError);
+  gpsPort->onReceive(gpsOnReceive, false);    // FIFO piena o fine frase (timeout RX)
+  gpsCfgRunning = false;
+  vTaskDelete(nullptr);
+}
+
+// setup(): apre la UART e avvia la configurazione in background
+static inline bool startGpsIngest(HardwareSerial& port, int rxPin = GPS_RX_PIN, int txPin = GPS_TX_PIN){
+  gpsPort = &port;
+  port.setRxBufferSize(GPS_RX_BUF);              // prima di begin()
+  port.begin(GPS_BAUD_TARGET, SERIAL_8N1, rxPin, txPin);
+  gpsCfgRunning = true;
+  if (xTaskCreatePinnedToCore(gpsCfgTaskBody, "gps_cfg", 4096, nullptr, 1, nullptr, 0) == pdPASS) return true;
+  gpsCfgRunning = false;
+  return false;
+}
+#endif
+
+#endif // GPS_INGEST_H
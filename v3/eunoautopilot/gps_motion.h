@@ -0,0 +1,176 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// gps_motion.h — stima di COG/SOG con filtro di Kalman sul vettore velocità
+//
+// Stato: velocità sul fondo v = (vN, vE) in nodi, modello a velocità costante
+// con accelerazione casuale (σ = MOT_ACC_KNS). Filtrare le componenti invece
+// dell'angolo rende la stima circolare per costruzione: 359° e 1° sono due
+// vettori vicini, non una media che dà 180°.
+// Misura: un fix (COG, SOG) → z = SOG·(cos COG, sin COG). Covarianza nel
+// riferimento della rotta: σ lungo = accuratezza SOG, σ trasversale =
+// SOG·accuratezza COG (almeno σ lungo: da fermi il COG non dice nulla), poi
+// ruotata in N/E. Accuratezze da UBX NAV-PVT o default per NMEA.
+// Gate: fix non valido o più vecchio di MOT_MAX_AGE_MS, sAcc oltre
+// MOT_MAX_SOG_ACC_KN, innovazione oltre il χ² a 2 gradi (MOT_GATE_CHI2).
+// MOT_REJECT_RESET scarti di fila = manovra vera: si riparte dalla misura.
+// Uscita: EunoGpsMotion (SOG, COG, loro σ), pubblicata con seqlock; senza
+// fix accettati da MOT_STALE_MS la stima decade a non valida.
+
+#ifndef GPS_MOTION_H
+#define GPS_MOTION_H
+
+#include <math.h>
+#include <stdint.h>
+#include "gps_fix.h"
+
+#define MOT_ACC_KNS          0.3f      // accelerazione di processo (kn/s): 6 kn a 3°/s ≈ 0.3
+#define MOT_NMEA_SOG_KN      0.2f      // σ SOG senza accuratezze (NMEA)
+#define MOT_NMEA_COG_DEG     3.0f      // σ COG senza accuratezze (NMEA)
+#define MOT_MIN_SOG_SIG_KN   0.05f
+#define MOT_MIN_COG_SIG_DEG  0.5f
+#define MOT_MAX_SOG_ACC_KN   2.0f      // fix con sAcc peggiore: scartato
+#define MOT_MAX_AGE_MS       2000UL
+#define MOT_STALE_MS         5000UL
+#define MOT_GATE_CHI2        13.8f     // χ²(2) al 99.9%
+#define MOT_REJECT_RESET     3
+#define MOT_COG_MIN_KN       0.5f      // sotto, COG non pubblicato
+#define MOT_COG_MAX_SIG_DEG  20.0f
+
+struct EunoGpsMotion {
+  bool     valid     = false;   // SOG stimata da fix recenti
+  bool     cogValid  = false;   // ...e COG significativo (velocità e σ)
+  float    sogKn     = 0.0f;
+  float    cogDeg    = 0.0f;
+  float    sogSigKn  = NAN;
+  float    cogSigDeg = NAN;
+  uint32_t ms        = 0;       // ultimo fix accettato
+};
+
+struct EunoMotionKf {
+  float    vN = 0.0f, vE = 0.0f;
+  float    P[2][2] = {{0, 0}, {0, 0}};
+  bool     init = false;
+  uint32_t tMs = 0;             // istante della stima (ultimo fix accettato)
+  uint32_t lastFixMs = 0;       // ultimo fix visto (accettato o no)
+  uint8_t  rejectRun = 0;
+  uint32_t accepted = 0, rejected = 0, resets = 0;
+
+  // Covarianza di misura in N/E da σ lungo/trasversale alla rotta
+  static void measCov(float cogRad, float sL, float sC, float R[2][2]){
+    float c = cosf(cogRad), s = sinf(cogRad);
+    float l2 = sL * sL, c2 = sC * sC;
+    R[0][0] = c * c * l2 + s * s * c2;
+    R[1][1] = s * s * l2 + c * c * c2;
+    R[0][1] = R[1][0] = c * s * (l2 - c2);
+  }
+
+  void start(float zN, float zE, const float R[2][2], uint32_t ms){
+    vN = zN; vE = zE;
+    for (int i = 0; i < 2; i++) for (int j = 0; j < 2; j++) P[i][j] = R[i][j];
+    tMs = ms; init = true; rejectRun = 0;
+  }
+
+  // true se il fix è stato usato (anche come ripartenza)
+  bool update(const EunoGpsFix& f, uint32_t now){
+    if (!f.ms || f.ms == lastFixMs) return false;
+    lastFixMs = f.ms;
+    if (!f.valid || f.ageMs(now) > MOT_MAX_AGE_MS) return false;
+    if (!isnan(f.sogAccKn) && f.sogAccKn > MOT_MAX_SOG_ACC_KN) { rejected++; return false; }
+
+    float sL = isnan(f.sogAccKn) ? MOT_NMEA_SOG_KN : fmaxf(f.sogAccKn, MOT_MIN_SOG_SIG_KN);
+    float sT = (isnan(f.cogAccDeg) ? MOT_NMEA_COG_DEG : fmaxf(f.cogAccDeg, MOT_MIN_COG_SIG_DEG)) * (float)M_PI / 180.0f;
+    float sC = fmaxf(f.sogKn * sT, sL);
+    float cogRad = f.cogDeg * (float)M_PI / 180.0f;
+    float zN = f.sogKn * cosf(cogRad), zE = f.sogKn * sinf(cogRad);
+    float R[2][2];
+    measCov(cogRad, sL, sC, R);
+
+    if (!init || f.ms - tMs > MOT_STALE_MS) {
+      if (init) resets++;
+      start(zN, zE, R, f.ms);
+      accepted++;
+      return true;
+    }
+
+    // predizione al tempo del fix
+    float dt = (float)(int32_t)(f.ms - tMs) * 1e-3f;
+    if (dt < 0.0f) dt = 0.0f;
+    float q = MOT_ACC_KNS * MOT_ACC_KNS * dt;
+    P[0][0] += q; P[1][1] += q;
+
+    float yN = zN - vN, yE = zE - vE;
+    float S00 = P[0][0] + R[0][0], S01 = P[0][1] + R[0][1], S11 = P[1][1] + R[1][1];
+    float det = S00 * S11 - S01 * S01;
+    if (det <= 1e-12f) { start(zN, zE, R, f.ms); resets++; return true; }
+    float i00 =  S11 / det, i01 = -S01 / det, i11 = S00 / det;
+    float d2 = yN * (i00 * yN + i01 * yE) + yE * (i01 * yN + i11 * yE);
+    if (d2 > MOT_GATE_CHI2) {
+      rejected++;
+      if (++rejectRun >= MOT_REJECT_RESET) { start(zN, zE, R, f.ms); resets++; return true; }
+      return false;
+    }
+    rejectRun = 0;
+
+    // K = P·S⁻¹
+    float K00 = P[0][0] * i00 + P[0][1] * i01, K01 = P[0][0] * i01 + P[0][1] * i11;
+    float K10 = P[1][0] * i00 + P[1][1] * i01, K11 = P[1][0] * i01 + P[1][1] * i11;
+    vN += K00 * yN + K01 * yE;
+    vE += K10 * yN + K11 * yE;
+    float P00 = (1.0f - K00) * P[0][0] - K01 * P[1][0];
+    float P01 = (1.0f - K00) * P[0][1] - K01 * P[1][1];
+    float P11 = -K10 * P[0][1] + (1.0f - K11) * P[1][1];
+    P[0][0] = P00; P[0][1] = P[1][0] = P01; P[1][1] = P11;   // simmetria esplicita
+    tMs = f.ms;
+    accepted++;
+    return true;
+  }
+
+  void output(uint32_t now, EunoGpsMotion& m) const {
+    m = EunoGpsMotion();
+    if (!init || now - tMs > MOT_STALE_MS) return;
+    float sog = sqrtf(vN * vN + vE * vE);
+    m.valid = true;
+    m.ms    = tMs;
+    m.sogKn = sog;
+    if (sog > 1e-3f) {
+      float uN = vN / sog, uE = vE / sog;           // lungo la rotta
+      float vl = uN * (P[0][0] * uN + P[0][1] * uE) + uE * (P[1][0] * uN + P[1][1] * uE);
+      float vt = uE * (P[0][0] * uE - P[0][1] * uN) - uN * (P[1][0] * uE - P[1][1] * uN);
+      m.sogSigKn  = sqrtf(fmaxf(vl, 0.0f));
+      m.cogSigDeg = sqrtf(fmaxf(vt, 0.0f)) / sog * 180.0f / (float)M_PI;
+      float cog = atan2f(vE, vN) * 180.0f / (float)M_PI;
+      m.cogDeg = cog < 0.0f ? cog + 360.0f : cog;
+    } else {
+      m.sogSigKn = sqrtf(fmaxf(P[0][0], 0.0f));
+    }
+    m.cogValid = sog >= MOT_COG_MIN_KN && m.cogSigDeg <= MOT_COG_MAX_SIG_DEG;
+  }
+};
+
+static EunoMotionKf               gpsMotionKf;      // solo task di controllo (fusion)
+static EunoSeqlock<EunoGpsMotion> gpsMotionLock;
+
+static inline EunoGpsMotion gpsMotionGet(){ return gpsMotionLock.get(); }
+
+// Dal tick fusion: nuovo fix → filtro; pubblica la stima (e il suo decadere)
+static inline EunoGpsMotion gpsMotionStep(uint32_t now){
+  static bool lastValid = false;
+  bool used = gpsMotionKf.update(gpsFixGet(), now);
+  EunoGpsMotion m;
+  gpsMotionKf.output(now, m);
+  if (used || m.valid != lastValid) gpsMotionLock.publish(m);
+  lastValid = m.valid;
+  return m;
+}
+
+static inline void gpsMotionReset(){
+  gpsMotionKf = EunoMotionKf();
+  gpsMotionLock.publish(EunoGpsMotion());
+}
+
+#endif // GPS_MOTION_H
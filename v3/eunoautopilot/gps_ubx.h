@@ -0,0 +1,119 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// gps_ubx.h — parser UBX (u-blox) per NAV-PVT, front end alternativo a NMEA
+//
+// Frame: B5 62 | classe | id | lunghezza (LE) | payload | CK_A CK_B (Fletcher)
+// Il parser accumula il payload nel suo buffer e a frame chiuso i campi si
+// leggono lì, a offset fissi (nessuna copia in strutture intermedie, niente
+// String). NAV-PVT (01 07) in un solo messaggio dà fix, posizione, COG/SOG,
+// le loro accuratezze e l'ora: ubxNavPvtToFix() lo converte in EunoGpsFix.
+// I byte che non appartengono a un frame UBX tornano al chiamante (NMEA).
+
+#ifndef GPS_UBX_H
+#define GPS_UBX_H
+
+#include <stdint.h>
+#include <string.h>
+#include "gps_fix.h"
+
+#define UBX_SYNC1          0xB5
+#define UBX_SYNC2          0x62
+#define UBX_CLS_NAV        0x01
+#define UBX_ID_NAV_PVT     0x07
+#define UBX_NAV_PVT_MIN    84       // protocollo 14 (M7); da M8 in poi 92
+#define UBX_MAX_PAYLOAD    100      // frame più lunghi: contati e scartati
+
+enum EunoUbxFeed : uint8_t {
+  UBX_NOT_MINE = 0,   // byte fuori da un frame UBX (al parser NMEA)
+  UBX_BUSY,           // byte consumato, frame in corso
+  UBX_FRAME           // frame completo e con checksum valido in cls/id/buf/len
+};
+
+struct EunoUbxParser {
+  uint8_t  buf[UBX_MAX_PAYLOAD];
+  uint16_t len = 0, idx = 0;
+  uint8_t  cls = 0, id = 0, ckA = 0, ckB = 0;
+  uint8_t  state = 0;
+  uint32_t frames = 0, ckFail = 0, tooLong = 0;
+
+  void reset(){ state = 0; }
+
+  EunoUbxFeed feed(uint8_t b){
+    switch (state) {
+      case 0:
+        if (b != UBX_SYNC1) return UBX_NOT_MINE;
+        state = 1; return UBX_BUSY;
+      case 1:
+        if (b != UBX_SYNC2) { state = 0; return UBX_NOT_MINE; }   // 0xB5 isolato
+        state = 2; ckA = ckB = 0; return UBX_BUSY;
+      case 2: cls = b; ck(b); state = 3; return UBX_BUSY;
+      case 3: id  = b; ck(b); state = 4; return UBX_BUSY;
+      case 4: len = b; ck(b); state = 5; return UBX_BUSY;
+      case 5:
+        len |= (uint16_t)b << 8; ck(b); idx = 0;
+        state = len ? 6 : 7;
+        return UBX_BUSY;
+      case 6:
+        if (idx < UBX_MAX_PAYLOAD) buf[idx] = b;
+        ck(b);
+        if (++idx >= len) state = 7;
+        return UBX_BUSY;
+      case 7:
+        state = (b == ckA) ? 8 : 9;
+        return UBX_BUSY;
+      case 8:
+      case 9: {
+        bool ok = (state == 8 && b == ckB);
+        state = 0;
+        if (!ok) { ckFail++; return UBX_BUSY; }
+        if (len > UBX_MAX_PAYLOAD) { tooLong++; return UBX_BUSY; }
+        frames++;
+        return UBX_FRAME;
+      }
+      default:
+        state = 0; return UBX_NOT_MINE;
+    }
+  }
+
+  bool is(uint8_t c, uint8_t i) const { return cls == c && id == i; }
+
+  uint8_t  u1(int o) const { return buf[o]; }
+  uint32_t u4(int o) const { return (uint32_t)buf[o] | ((uint32_t)buf[o+1] << 8) | ((uint32_t)buf[o+2] << 16) | ((uint32_t)buf[o+3] << 24); }
+  int32_t  i4(int o) const { return (int32_t)u4(o); }
+
+private:
+  void ck(uint8_t b){ ckA += b; ckB += ckA; }
+};
+
+// NAV-PVT → EunoGpsFix. false se il frame non è NAV-PVT o è troppo corto.
+// Valido = gnssFixOK e fix 2D/3D/GNSS+DR; COG = headMot (moto, non prua).
+static inline bool ubxNavPvtToFix(const EunoUbxParser& u, uint32_t now, EunoGpsFix& f){
+  if (!u.is(UBX_CLS_NAV, UBX_ID_NAV_PVT) || u.len < UBX_NAV_PVT_MIN) return false;
+  const float MMS_TO_KN = 1.0f / 514.444f;
+  uint8_t fixType = u.u1(20);
+  bool    fixOk   = (u.u1(21) & 0x01) != 0;
+  bool    ok      = fixOk && fixType >= 2 && fixType <= 4;
+
+  f = EunoGpsFix();
+  f.ms       = now ? now : 1;
+  f.source   = GPS_SRC_UBX;
+  f.valid    = ok;
+  f.posValid = ok;
+  f.numSV    = u.u1(23);
+  f.lon      = u.i4(24) * 1e-7;
+  f.lat      = u.i4(28) * 1e-7;
+  f.sogKn    = (float)u.i4(60) * MMS_TO_KN;                // gSpeed mm/s
+  float cog  = (float)(u.i4(64) * 1e-5);                    // headMot 1e-5°
+  cog = fmodf(cog, 360.0f);
+  f.cogDeg   = cog < 0.0f ? cog + 360.0f : cog;
+  f.sogAccKn = (float)u.u4(68) * MMS_TO_KN;                 // sAcc mm/s
+  f.cogAccDeg = (float)(u.u4(72) * 1e-5);                   // headAcc 1e-5°
+  return true;
+}
+
+#endif // GPS_UBX_H
@@ -0,0 +1,128 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// icm_acquisition.h — task di acquisizione FIFO ICM-20948 + ring buffer SPSC
+//
+// - ISR su INT1 (data-ready): salva solo micros() e sveglia il task
+// - Il task (prio sopra il controllo) scarica la FIFO a burst e spinge i
+//   campioni in imuRing con timestamp: l'ultimo record = istante dell'ultimo
+//   interrupt, i precedenti a passi di 1/ODR all'indietro
+// - Senza pin INT (ICM_INT_PIN < 0) il task fa polling ogni ICM_ACQ_POLL_MS
+// - updateSensorFusion() consuma imuRing: integra il gyro su ogni campione al
+//   rate nativo anche se loop() è fermo su rete/BLE
+
+#ifndef ICM_ACQUISITION_H
+#define ICM_ACQUISITION_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <stdint.h>
+#include "icm_compass.h"
+
+#ifndef ICM_INT_PIN
+#define ICM_INT_PIN      -1      // GPIO collegato a INT1 (-1 = polling)
+#endif
+#define ICM_ACQ_POLL_MS  5
+#define ICM_FIFO_DIV     4       // 1125/5 = 225 Hz
+
+struct EunoImuSample {
+  uint32_t tUs;
+  float ax, ay, az;   // m/s²
+  float gx, gy, gz;   // rad/s
+};
+
+// Coda lock-free un produttore / un consumatore, N potenza di 2
+template <typename T, uint16_t N>
+class EunoSpscRing {
+  static_assert((N & (N - 1)) == 0, "N deve essere potenza di 2");
+public:
+  bool push(const T& v){
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= N) { drops++; return false; }
+    buf[h & (N - 1)] = v;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+  bool pop(T& v){
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return false;
+    v = buf[t & (N - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+  uint32_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+  uint32_t dropped() const { return drops; }
+private:
+  T buf[N];
+  std::atomic<uint32_t> head{0}, tail{0};
+  volatile uint32_t drops = 0;
+};
+
+static EunoSpscRing<EunoImuSample, 128> imuRing;   // ~0.57 s @225 Hz
+static volatile uint32_t icmIrqUs     = 0;
+static volatile uint32_t icmAcqSamples = 0;
+static volatile uint32_t icmAcqOverflows = 0;
+
+// Un giro di scarico: FIFO → imuRing. Ritorna i campioni spinti.
+static inline int icmAcqDrain(ICMCompass& c){
+  ICMFifoRecord rec[32];
+  int n = c.readFifo(rec, 32);
+  if (n < 0) { icmAcqOverflows++; return 0; }
+  if (n == 0) return 0;
+
+  uint32_t tLast = ICM_INT_PIN >= 0 ? icmIrqUs : micros();
+  uint32_t tsUs  = (uint32_t)(1e6f / c.fifoRateHz());
+  for (int i = 0; i < n; i++) {
+    EunoImuSample s;
+    s.tUs = tLast - (uint32_t)(n - 1 - i) * tsUs;
+    s.ax = rec[i].ax; s.ay = rec[i].ay; s.az = rec[i].az;
+    s.gx = rec[i].gx; s.gy = rec[i].gy; s.gz = rec[i].gz;
+    imuRing.push(s);
+  }
+  icmAcqSamples += n;
+  return n;
+}
+
+#if defined(ESP32)
+static TaskHandle_t icmAcqTask = nullptr;
+
+static void IRAM_ATTR icmDataReadyIsr(){
+  icmIrqUs = micros();
+  BaseType_t woke = pdFALSE;
+  if (icmAcqTask) vTaskNotifyGiveFromISR(icmAcqTask, &woke);
+  if (woke) portYIELD_FROM_ISR();
+}
+
+static void icmAcqTaskBody(void* arg){
+  ICMCompass* c = static_cast<ICMCompass*>(arg);
+  for (;;) {
+    // con INT: sveglia a ogni data-ready (timeout = rete di sicurezza)
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ICM_INT_PIN >= 0 ? 20 : ICM_ACQ_POLL_MS));
+    icmAcqDrain(*c);
+  }
+}
+
+// Configura FIFO + INT e avvia il task; false → resta la lettura a snapshot
+static inline bool startIcmAcquisition(ICMCompass& c, UBaseType_t prio = 4, BaseType_t core = 1){
+  if (!c.beginFifo(ICM_FIFO_DIV)) return false;
+  if (xTaskCreatePinnedToCore(icmAcqTaskBody, "icm_acq", 4096, &c, prio, &icmAcqTask, core) != pdPASS) {
+    icmAcqTask = nullptr;
+    c.endFifo();          // nessuno scarica la FIFO: la fusion torna allo snapshot
+    return false;
+  }
+  if (ICM_INT_PIN >= 0) {
+    pinMode(ICM_INT_PIN, INPUT);
+    attachInterrupt(digitalPinToInterrupt(ICM_INT_PIN), icmDataReadyIsr, RISING);
+  }
+  return true;
+}
+#endif
+
+// Acquisizione FIFO attiva (task avviato e chip configurato)
+static inline bool icmAcqActive(ICMCompass& c){ return c.fifoActive(); }
+
+#endif // ICM_ACQUISITION_H
@@ -1,4 +1,14 @@
 // icm_compass.h — robust auto-address + accel/gyro helpers + mag fallback
+//
+// Snapshot: sample() legge i 9 assi in un'unica transazione I2C (getEvent a
+// 4 sensori della libreria Adafruit = un burst da ACCEL_XOUT a EXT_SENS_DATA)
+// e li salva con timestamp. read(), getAccelEvent() e getGyroEvent() servono
+// lo snapshot finché è più recente di ICM_SNAPSHOT_MAX_AGE_US: il tick fusion
+// (100 Hz) campiona, tutti gli altri leggono lo stesso istante senza bus.
+//
+// FIFO: beginFifo() programma ODR accel/gyro e mette i due sensori nella FIFO
+// del chip (12 byte/record) con interrupt data-ready su INT1; readFifo()
+// scarica i record in burst. Il task che li consuma è in icm_acquisition.h.
 
 #ifndef ICM_COMPASS_H
 #define ICM_COMPASS_H
@@ -7,16 +17,86 @@
 #include <Adafruit_Sensor.h>
 #include <Wire.h>
 #include <math.h>
+#include "euno_fastmath.h"
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#endif
+
+#define ICM_SNAPSHOT_MAX_AGE_US  15000UL   // > periodo fusion (10 ms) + jitter
+
+// Registri ICM-20948 per FIFO/interrupt (bank 0 salvo dove indicato)
+#define ICM_REG_BANK_SEL     0x7F
+#define ICM_REG_USER_CTRL    0x03
+#define ICM_REG_INT_PIN_CFG  0x0F
+#define ICM_REG_INT_ENABLE_1 0x11
+#define ICM_REG_FIFO_EN_2    0x67
+#define ICM_REG_FIFO_RST     0x68
+#define ICM_REG_FIFO_MODE    0x69
+#define ICM_REG_FIFO_COUNTH  0x70
+#define ICM_REG_FIFO_R_W     0x72
+
+#define ICM_FIFO_RECORD      12         // accel XYZ + gyro XYZ, big endian
+#define ICM_FIFO_BYTES       512
+#define ICM_FIFO_CHUNK       10         // record per requestFrom (buffer Wire 128 B)
+#define ICM_ODR_BASE_HZ      1125.0f    // ODR = 1125 / (1 + div)
+#define ICM_ACC_LSB_PER_G    16384.0f   // ±2 g (come tryBegin)
+#define ICM_GYRO_LSB_PER_DPS 131.0f     // ±250 °/s
+
+struct ICMFifoRecord {
+  float ax, ay, az;   // m/s²
+  float gx, gy, gz;   // rad/s
+};
+
+struct ICMSnapshot {
+  uint32_t tUs   = 0;       // micros() della lettura
+  uint32_t seq   = 0;       // contatore letture burst
+  bool     valid = false;
+  float ax = 0, ay = 0, az = 0;   // m/s²
+  float gx = 0, gy = 0, gz = 0;   // rad/s
+  float mx = 0, my = 0, mz = 0;   // µT
+};
 
 class ICMCompass {
 private:
   Adafruit_ICM20948 icm;
   Adafruit_Sensor *magSensor = nullptr;
+#if defined(ESP32)
+  SemaphoreHandle_t busMtx = nullptr;   // I2C condiviso tra task di controllo e loop()
+#endif
 
   float mx = 0.0f, my = 0.0f, mz = 0.0f;
-  float heading = 0.0f;
   uint8_t used_addr = 0x00;
   bool inited = false;
+  ICMSnapshot snap;
+  TwoWire *bus = &Wire;
+  bool fifoOn = false;
+  float odrHz = 0.0f;
+  uint32_t fifoResets = 0;
+
+  bool writeReg(uint8_t reg, uint8_t val){
+    bus->beginTransmission(used_addr);
+    bus->write(reg);
+    bus->write(val);
+    return bus->endTransmission() == 0;
+  }
+  bool readRegs(uint8_t reg, uint8_t *buf, int n){
+    bus->beginTransmission(used_addr);
+    bus->write(reg);
+    if (bus->endTransmission(false) != 0) return false;
+    if (bus->requestFrom((int)used_addr, n) != n) return false;
+    for (int i = 0; i < n; i++) buf[i] = (uint8_t)bus->read();
+    return true;
+  }
+  bool resetFifo(){
+    fifoResets++;
+    return writeReg(ICM_REG_FIFO_RST, 0x1F) && writeReg(ICM_REG_FIFO_RST, 0x00);
+  }
+
+  // Burst se lo snapshot è vuoto o vecchio (chiamare con il bus preso)
+  void refresh(){
+    if (!snap.valid || (uint32_t)(micros() - snap.tUs) > ICM_SNAPSHOT_MAX_AGE_US) sample();
+  }
 
   void ensureBus(TwoWire *w, uint32_t hz){
     w->begin(8, 9);        // SDA=9, SCL=8 nel tuo wiring
@@ -35,6 +115,7 @@ private:
     magSensor = icm.getMagnetometerSensor();
 
     used_addr = addr;
+    bus = w;
     inited = true;
     ensureBus(w, 400000);          // then speed up
     return true;
@@ -63,6 +144,9 @@ private:
 public:
   // Try the provided address (default 0x68). Returns true on success.
   bool begin(uint8_t addr = 0x68, TwoWire *w = &Wire){
+#if defined(ESP32)
+    if (!busMtx) busMtx = xSemaphoreCreateRecursiveMutex();
+#endif
     inited = false;
     return tryBegin(w, addr);
   }
@@ -75,58 +159,184 @@ public:
     return false;
   }
 
+  // Mutex ricorsivo sul bus: le letture lo prendono da sole, chi deve
+  // leggere più sensori in modo coerente lo tiene per tutta la sequenza
+  void lock(){
+#if defined(ESP32)
+    if (busMtx) xSemaphoreTakeRecursive(busMtx, portMAX_DELAY);
+#endif
+  }
+  void unlock(){
+#if defined(ESP32)
+    if (busMtx) xSemaphoreGiveRecursive(busMtx);
+#endif
+  }
+
   bool isInitialized() const { return inited; }
   uint8_t getAddress() const { return used_addr; }
 
-  // Read just the magnetometer (con fallback)
-  void read(){
-    if (!inited) return;
-    sensors_event_t mag;
-
-    bool ok = false;
-    if (magSensor) {
-      magSensor->getEvent(&mag);
-      mx = mag.magnetic.x;
-      my = mag.magnetic.y;
-      mz = mag.magnetic.z;
-      ok = true;
-    } 
-    else {
-      float rx, ry, rz;
-      if (readMagRaw(rx, ry, rz)) {
-        mx = rx; my = ry; mz = rz;
-        ok = true;
+  // Lettura burst dei 9 assi → snapshot (mag con fallback EXT_SENS_DATA)
+  bool sample(){
+    if (!inited) return false;
+    lock();
+    sensors_event_t a, g, t, m;
+    bool ok = icm.getEvent(&a, &g, &t, magSensor ? &m : nullptr);
+    if (ok) {
+      snap.ax = a.acceleration.x; snap.ay = a.acceleration.y; snap.az = a.acceleration.z;
+      snap.gx = g.gyro.x;         snap.gy = g.gyro.y;         snap.gz = g.gyro.z;
+      if (magSensor) {
+        snap.mx = m.magnetic.x; snap.my = m.magnetic.y; snap.mz = m.magnetic.z;
+      } else {
+        float rx, ry, rz;
+        if (readMagRaw(rx, ry, rz)) { snap.mx = rx; snap.my = ry; snap.mz = rz; }
       }
-    }
+      snap.tUs = micros();
+      snap.seq++;
+      snap.valid = true;
 
-    if (ok) {
-      float h = atan2f(my, mx) * 180.0f / (float)M_PI;
-      if (h < 0) h += 360.0f;
-      heading = h;
+      mx = snap.mx; my = snap.my; mz = snap.mz;
     }
+    unlock();
+    return ok;
+  }
+
+  // Copia coerente dello snapshot (campiona se vecchio)
+  ICMSnapshot snapshot(){
+    ICMSnapshot s;
+    if (!inited) return s;
+    lock();
+    refresh();
+    s = snap;
+    unlock();
+    return s;
   }
 
-  // Helpers for fusion code
+  // Magnetometro dallo snapshot → getX/getY/getZ
+  void read(){
+    if (!inited) return;
+    lock();
+    refresh();
+    unlock();
+  }
+
+  // Helpers for fusion code (stesso istante dello snapshot)
   bool getAccelEvent(sensors_event_t &out){
     if (!inited) return false;
-    auto s = icm.getAccelerometerSensor();
-    if (!s) return false;
-    s->getEvent(&out);
-    return true;
+    lock();
+    refresh();
+    memset(&out, 0, sizeof(out));
+    out.timestamp = (int32_t)(snap.tUs / 1000UL);
+    out.acceleration.x = snap.ax; out.acceleration.y = snap.ay; out.acceleration.z = snap.az;
+    bool ok = snap.valid;
+    unlock();
+    return ok;
   }
   bool getGyroEvent(sensors_event_t &out){
     if (!inited) return false;
-    auto s = icm.getGyroSensor();
-    if (!s) return false;
-    s->getEvent(&out);
-    return true;
+    lock();
+    refresh();
+    memset(&out, 0, sizeof(out));
+    out.timestamp = (int32_t)(snap.tUs / 1000UL);
+    out.gyro.x = snap.gx; out.gyro.y = snap.gy; out.gyro.z = snap.gz;
+    bool ok = snap.valid;
+    unlock();
+    return ok;
   }
 
   // Accessors
   float getX() const { return mx; }
   float getY() const { return my; }
   float getZ() const { return mz; }
-  float getHeading() const { return heading; }
+  // heading grezzo (senza calibrazione): calcolato solo se qualcuno lo chiede
+  float getHeading() const { return fm_atan2_deg360(my, mx); }
+  uint32_t sampleCount() const { return snap.seq; }
+
+  // Accel+gyro in FIFO a ODR = 1125/(1+div) Hz, interrupt data-ready su INT1
+  // (push-pull, attivo alto, impulso 50 µs). Il mag resta nello snapshot.
+  bool beginFifo(uint8_t div = 4){
+    if (!inited) return false;
+    lock();
+    icm.setGyroRateDivisor(div);
+    icm.setAccelRateDivisor(div);
+    uint8_t v = 0;
+    bool ok = writeReg(ICM_REG_BANK_SEL, 0x00)
+           && readRegs(ICM_REG_USER_CTRL, &v, 1)
+           && writeReg(ICM_REG_USER_CTRL, v | 0x40)          // FIFO_EN (I2C_MST_EN invariato)
+           && writeReg(ICM_REG_FIFO_MODE, 0x00)              // stream
+           && writeReg(ICM_REG_FIFO_EN_2, 0x1E)              // ACCEL + GYRO_Z/Y/X
+           && readRegs(ICM_REG_INT_PIN_CFG, &v, 1)
+           && writeReg(ICM_REG_INT_PIN_CFG, v & 0x1F)        // attivo alto, push-pull, no latch
+           && writeReg(ICM_REG_INT_ENABLE_1, 0x01)           // RAW_DATA_0_RDY_EN
+           && resetFifo();
+    fifoOn = ok;
+    odrHz = ICM_ODR_BASE_HZ / (1.0f + div);
+    unlock();
+    return ok;
+  }
+
+  // Torna alla sola lettura a snapshot (task di acquisizione non partito):
+  // fifoOn a false anche se il chip non risponde, la fusion non aspetta la FIFO
+  void endFifo(){
+    if (!inited) return;
+    lock();
+    uint8_t v = 0;
+    if (writeReg(ICM_REG_BANK_SEL, 0x00)
+        && writeReg(ICM_REG_INT_ENABLE_1, 0x00)
+        && writeReg(ICM_REG_FIFO_EN_2, 0x00)
+        && readRegs(ICM_REG_USER_CTRL, &v, 1))
+      writeReg(ICM_REG_USER_CTRL, v & ~0x40);
+    fifoOn = false;
+    unlock();
+  }
+
+  bool  fifoActive() const { return fifoOn; }
+  float fifoRateHz() const { return odrHz; }
+  uint32_t fifoResetCount() const { return fifoResets; }
+
+  // Scarica fino a maxN record; -1 se la FIFO è andata in overflow (resettata)
+  int readFifo(ICMFifoRecord *out, int maxN){
+    if (!fifoOn) return 0;
+    lock();
+    uint8_t c[2];
+    int n = 0;
+    if (readRegs(ICM_REG_FIFO_COUNTH, c, 2)) {
+      int bytes = ((c[0] & 0x1F) << 8) | c[1];
+      if (bytes % ICM_FIFO_RECORD != 0 || bytes >= ICM_FIFO_BYTES - ICM_FIFO_RECORD) {
+        resetFifo();
+        n = -1;
+      } else {
+        int avail = bytes / ICM_FIFO_RECORD;
+        if (avail > maxN) avail = maxN;
+        uint8_t buf[ICM_FIFO_CHUNK * ICM_FIFO_RECORD];
+        while (n < avail) {
+          int k = min(avail - n, ICM_FIFO_CHUNK);
+          if (!readRegs(ICM_REG_FIFO_R_W, buf, k * ICM_FIFO_RECORD)) break;
+          for (int i = 0; i < k; i++) {
+            const uint8_t *r = buf + i * ICM_FIFO_RECORD;
+            const float aS = 9.80665f / ICM_ACC_LSB_PER_G;
+            const float gS = (float)M_PI / 180.0f / ICM_GYRO_LSB_PER_DPS;
+            ICMFifoRecord &o = out[n + i];
+            o.ax = (int16_t)((r[0]  << 8) | r[1])  * aS;
+            o.ay = (int16_t)((r[2]  << 8) | r[3])  * aS;
+            o.az = (int16_t)((r[4]  << 8) | r[5])  * aS;
+            o.gx = (int16_t)((r[6]  << 8) | r[7])  * gS;
+            o.gy = (int16_t)((r[8]  << 8) | r[9])  * gS;
+            o.gz = (int16_t)((r[10] << 8) | r[11]) * gS;
+          }
+          n += k;
+        }
+      }
+    }
+    unlock();
+    return n;
+  }
+};
+
+// RAII: tiene il bus per tutta una sequenza di letture
+struct ICMLock {
+  ICMCompass& c;
+  explicit ICMLock(ICMCompass& cc) : c(cc) { c.lock(); }
+  ~ICMLock() { c.unlock(); }
 };
 
 #endif // ICM_COMPASS_H
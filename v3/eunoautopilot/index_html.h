@@ -226,6 +226,7 @@ button:active{transform:translateY(1px)}
                 <option>FUSION</option>
                 <option>EXPERIMENTAL</option>
                 <option>ADV</option>
+                <option>AHRS</option>
                 <option>OPENPLOTTER</option>
               </select>
               <button class="btn-acc" onclick="send('$PEUNO,CMD,CAL=MAG')">CAL MAG</button>
@@ -420,6 +421,7 @@ async function saveNet(){
 
 /* ===== Telemetry ===== */
 function kv(line){
+  line = line.replace(/\*[0-9A-Fa-f]{2}\s*$/,'');   // checksum NMEA in coda
   const m={}; line.split(',').slice(1).forEach(p=>{ const i=p.indexOf('='); if(i>0) m[p.slice(0,i)]=p.slice(i+1); });
   return m;
 }
@@ -0,0 +1,327 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// mag_ellipsoid.h — calibrazione magnetometro a ellissoide (minimi quadrati)
+//
+// I campioni grezzi stanno su un ellissoide (hard-iron = centro, soft-iron =
+// deformazione e rotazione). Si stima la quadrica
+//   A x² + B y² + C z² + 2D xy + 2E xz + 2F yz + 2G x + 2H y + 2I z = 1
+// ai minimi quadrati. DᵀD e Dᵀ1 contengono solo momenti dei campioni fino al
+// 4° grado: si accumulano quei 35 momenti (nessun buffer di campioni per
+// quanto duri la finestra) e a fine finestra si costruisce il sistema attorno
+// al centro min/max. Il centro serve al condizionamento e soprattutto alla
+// forma "= 1", che non rappresenta superfici passanti per l'origine: senza
+// spostamento un offset hard-iron grande quanto il campo la rende singolare.
+// Alla fine:  m_cal = W · (m_raw − off)   con W 3×3 simmetrica che riporta
+// l'ellissoide a una sfera di raggio pari alla media geometrica dei semiassi
+// (le unità restano µT).
+//
+// A bordo si ruota quasi solo attorno alla verticale: se Z non ha escursione
+// sufficiente l'ellissoide è mal condizionato e si risolve il sottoproblema
+// 2D (ellisse XY, stessi accumulatori). L'offset Z resta quello precedente:
+// il centro di un'escursione Z di pochi gradi di sbandamento non è l'hard-iron.
+// Un filtro mediano a 3 campioni per asse toglie gli spike isolati.
+
+#ifndef MAG_ELLIPSOID_H
+#define MAG_ELLIPSOID_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MAGCAL_MAGIC          0xE11Au
+#define MAGCAL_SCALE          0.02     // µT → unità ~1 per il condizionamento
+#define MAGCAL_MIN_SAMPLES    100
+#define MAGCAL_MAX_AXIS_RATIO 2.0f     // semiasse max/min accettato
+#define MAGCAL_MAX_FIT_PCT    10.0f    // errore radiale RMS accettato (%)
+#define MAGCAL_Z_SPAN_3D      0.5f     // escursione Z / XY minima per il fit 3D
+
+// Risultato persistente (EEPROM, vedi calibration.h)
+struct EunoMagCal {
+  uint16_t magic  = 0;
+  uint8_t  mode   = 0;          // 2 = ellisse XY, 3 = ellissoide
+  uint8_t  pad    = 0;
+  float    off[3] = {0, 0, 0};  // µT
+  float    W[9]   = {1, 0, 0, 0, 1, 0, 0, 0, 1};   // riga per riga
+  float    fitPct = 0.0f;       // errore radiale RMS (% del raggio)
+
+  bool valid() const { return magic == MAGCAL_MAGIC && (mode == 2 || mode == 3); }
+  void apply(float &mx, float &my, float &mz) const {
+    float dx = mx - off[0], dy = my - off[1], dz = mz - off[2];
+    mx = W[0]*dx + W[1]*dy + W[2]*dz;
+    my = W[3]*dx + W[4]*dy + W[5]*dz;
+    mz = W[6]*dx + W[7]*dy + W[8]*dz;
+  }
+};
+
+// Autovalori/vettori di una 3×3 simmetrica (Jacobi ciclico). a viene distrutta,
+// v riceve gli autovettori per colonna.
+static inline void magcalJacobi3(double a[3][3], double v[3][3], double d[3]){
+  for (int i = 0; i < 3; i++) for (int j = 0; j < 3; j++) v[i][j] = (i == j) ? 1.0 : 0.0;
+  for (int sweep = 0; sweep < 16; sweep++) {
+    double off = fabs(a[0][1]) + fabs(a[0][2]) + fabs(a[1][2]);
+    if (off < 1e-15) break;
+    for (int p = 0; p < 2; p++) for (int q = p + 1; q < 3; q++) {
+      if (fabs(a[p][q]) < 1e-300) continue;
+      double th = 0.5 * (a[q][q] - a[p][p]) / a[p][q];
+      double t  = (th >= 0 ? 1.0 : -1.0) / (fabs(th) + sqrt(th * th + 1.0));
+      double c  = 1.0 / sqrt(t * t + 1.0), s = t * c;
+      for (int k = 0; k < 3; k++) {           // a = Jᵀ a J
+        double akp = a[k][p], akq = a[k][q];
+        a[k][p] = c * akp - s * akq;
+        a[k][q] = s * akp + c * akq;
+      }
+      for (int k = 0; k < 3; k++) {
+        double apk = a[p][k], aqk = a[q][k];
+        a[p][k] = c * apk - s * aqk;
+        a[q][k] = s * apk + c * aqk;
+      }
+      for (int k = 0; k < 3; k++) {
+        double vkp = v[k][p], vkq = v[k][q];
+        v[k][p] = c * vkp - s * vkq;
+        v[k][q] = s * vkp + c * vkq;
+      }
+    }
+  }
+  for (int i = 0; i < 3; i++) d[i] = a[i][i];
+}
+
+// Risolve A x = b (n ≤ 9) con pivoting parziale; false se singolare
+static inline bool magcalSolve(double A[9][9], double b[9], int n, double x[9]){
+  double amax = 0.0;
+  for (int i = 0; i < n; i++) if (fabs(A[i][i]) > amax) amax = fabs(A[i][i]);
+  if (amax <= 0.0) return false;
+  for (int c = 0; c < n; c++) {
+    int p = c;
+    for (int r = c + 1; r < n; r++) if (fabs(A[r][c]) > fabs(A[p][c])) p = r;
+    if (fabs(A[p][c]) < 1e-10 * amax) return false;
+    if (p != c) {
+      for (int k = 0; k < n; k++) { double t = A[c][k]; A[c][k] = A[p][k]; A[p][k] = t; }
+      double t = b[c]; b[c] = b[p]; b[p] = t;
+    }
+    for (int r = c + 1; r < n; r++) {
+      double f = A[r][c] / A[c][c];
+      for (int k = c; k < n; k++) A[r][k] -= f * A[c][k];
+      b[r] -= f * b[c];
+    }
+  }
+  for (int r = n - 1; r >= 0; r--) {
+    double s = b[r];
+    for (int k = r + 1; k < n; k++) s -= A[r][k] * x[k];
+    x[r] = s / A[r][r];
+  }
+  return true;
+}
+
+class MagEllipsoidFit {
+public:
+  void reset(){
+    memset(mom, 0, sizeof(mom));
+    n = 0; nMed = 0;
+    for (int i = 0; i < 3; i++) { lo[i] = 1e9f; hi[i] = -1e9f; }
+  }
+
+  // Un campione grezzo (µT). Ritorna true se accumulato (dopo il mediano).
+  bool add(float x, float y, float z){
+    if (!(x == x) || !(y == y) || !(z == z)) return false;   // NaN
+    if (x == 0.0f && y == 0.0f && z == 0.0f) return false;   // lettura fallita
+    hist[nMed % 3][0] = x; hist[nMed % 3][1] = y; hist[nMed % 3][2] = z;
+    nMed++;
+    if (nMed < 3) return false;
+    float m[3];
+    for (int a = 0; a < 3; a++) {
+      m[a] = med3(hist[0][a], hist[1][a], hist[2][a]);
+      if (m[a] < lo[a]) lo[a] = m[a];
+      if (m[a] > hi[a]) hi[a] = m[a];
+    }
+    double pu[5], pv[5], pw[5];
+    pu[0] = pv[0] = pw[0] = 1.0;
+    for (int e = 1; e < 5; e++) {
+      pu[e] = pu[e - 1] * (m[0] * MAGCAL_SCALE);
+      pv[e] = pv[e - 1] * (m[1] * MAGCAL_SCALE);
+      pw[e] = pw[e - 1] * (m[2] * MAGCAL_SCALE);
+    }
+    for (int a = 0; a < 5; a++)
+      for (int b = 0; a + b < 5; b++)
+        for (int c = 0; a + b + c < 5; c++)
+          mom[a][b][c] += pu[a] * pv[b] * pw[c];
+    n++;
+    return true;
+  }
+
+  uint32_t count() const { return n; }
+  float minAxis(int a) const { return lo[a]; }
+  float maxAxis(int a) const { return hi[a]; }
+
+  // Fit 3D se Z ha escursione, altrimenti (o se il 3D fallisce) ellisse XY;
+  // zOffPrior = offset Z da tenere nel caso 2D
+  bool solve(EunoMagCal& out, float zOffPrior) const {
+    if (n < MAGCAL_MIN_SAMPLES) return false;
+    float spanXY = 0.5f * ((hi[0] - lo[0]) + (hi[1] - lo[1]));
+    if ((hi[2] - lo[2]) >= MAGCAL_Z_SPAN_3D * spanXY && solve3D(out)) return true;
+    return solve2D(out, zOffPrior);
+  }
+
+private:
+  double   mom[5][5][5];   // Σ uᵃ vᵇ wᶜ, a+b+c ≤ 4 (coordinate × MAGCAL_SCALE)
+  uint32_t n = 0;
+  uint32_t nMed = 0;
+  float    hist[3][3];
+  float    lo[3], hi[3];
+
+  // Monomi del regressore d = [x², y², z², 2xy, 2xz, 2yz, 2x, 2y, 2z]
+  static const uint8_t* dExp(int i){
+    static const uint8_t e[9][3] = { {2,0,0}, {0,2,0}, {0,0,2}, {1,1,0}, {1,0,1},
+                                     {0,1,1}, {1,0,0}, {0,1,0}, {0,0,1} };
+    return e[i];
+  }
+  static double dCoef(int i){ return (i < 3) ? 1.0 : 2.0; }
+
+  static float med3(float a, float b, float c){
+    if (a > b) { float t = a; a = b; b = t; }
+    if (b > c) b = c;
+    return (a > b) ? a : b;
+  }
+
+  static double binom(int n, int k){
+    static const double t[5][5] = { {1}, {1,1}, {1,2,1}, {1,3,3,1}, {1,4,6,4,1} };
+    return t[n][k];
+  }
+
+  // Momento Σ (u−su)ᵃ (v−sv)ᵇ (w−sw)ᶜ dai momenti grezzi
+  double shifted(int a, int b, int c, const double s[3]) const {
+    double sum = 0.0;
+    for (int i = 0; i <= a; i++)
+      for (int j = 0; j <= b; j++)
+        for (int k = 0; k <= c; k++)
+          sum += binom(a, i) * binom(b, j) * binom(c, k)
+               * pow(-s[0], a - i) * pow(-s[1], b - j) * pow(-s[2], c - k) * mom[i][j][k];
+    return sum;
+  }
+
+  // Centro min/max (unità scalate), attorno a cui si risolve
+  void shiftCenter(double s[3]) const {
+    for (int i = 0; i < 3; i++) s[i] = 0.5 * (lo[i] + hi[i]) * MAGCAL_SCALE;
+  }
+
+  // Sottosistema sugli indici idx attorno a sh: soluzione p e residuo RMS
+  bool solveSub(const int* idx, int k, const double sh[3], double p[9], double& rms) const {
+    double A[9][9], b[9], r[9];
+    for (int i = 0; i < k; i++) {
+      const uint8_t* ei = dExp(idx[i]);
+      r[i] = dCoef(idx[i]) * shifted(ei[0], ei[1], ei[2], sh);
+      for (int j = 0; j < k; j++) {
+        const uint8_t* ej = dExp(idx[j]);
+        A[i][j] = dCoef(idx[i]) * dCoef(idx[j])
+                * shifted(ei[0] + ej[0], ei[1] + ej[1], ei[2] + ej[2], sh);
+      }
+    }
+    double N[9][9];
+    memcpy(N, A, sizeof(N));
+    memcpy(b, r, sizeof(b));
+    if (!magcalSolve(A, b, k, p)) return false;
+    // Σ(dᵀp − 1)² = pᵀNp − 2pᵀr + n
+    double pNp = 0.0, pr = 0.0;
+    for (int i = 0; i < k; i++) {
+      pr += p[i] * r[i];
+      for (int j = 0; j < k; j++) pNp += p[i] * p[j] * N[i][j];
+    }
+    double res = pNp - 2.0 * pr + (double)n;
+    rms = sqrt(res > 0.0 ? res / (double)n : 0.0);
+    return true;
+  }
+
+  bool solve3D(EunoMagCal& out) const {
+    static const int idx[9] = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+    double sh[3], p[9], rms;
+    shiftCenter(sh);
+    if (!solveSub(idx, 9, sh, p, rms)) return false;
+    double M[3][3] = { {p[0], p[3], p[4]}, {p[3], p[1], p[5]}, {p[4], p[5], p[2]} };
+    double g[3] = { p[6], p[7], p[8] };
+
+    // centro: M c = −g
+    double Mi[9][9], gi[9], c[9];
+    for (int i = 0; i < 3; i++) { gi[i] = -g[i]; for (int j = 0; j < 3; j++) Mi[i][j] = M[i][j]; }
+    if (!magcalSolve(Mi, gi, 3, c)) return false;
+    double k = 1.0;
+    for (int i = 0; i < 3; i++) for (int j = 0; j < 3; j++) k += c[i] * M[i][j] * c[j];
+    if (fabs(k) < 1e-12) return false;
+
+    double a[3][3], V[3][3], lam[3];
+    for (int i = 0; i < 3; i++) for (int j = 0; j < 3; j++) a[i][j] = M[i][j] / k;
+    magcalJacobi3(a, V, lam);
+    double rMin = 1e300, rMax = 0.0, rGeo = 1.0;
+    for (int i = 0; i < 3; i++) {
+      if (lam[i] <= 0.0) return false;             // non è un ellissoide
+      double ri = 1.0 / sqrt(lam[i]);
+      if (ri < rMin) rMin = ri;
+      if (ri > rMax) rMax = ri;
+      rGeo *= ri;
+    }
+    if (rMax / rMin > MAGCAL_MAX_AXIS_RATIO) return false;
+    rGeo = cbrt(rGeo);
+
+    // W = rGeo · V diag(√λ) Vᵀ  (la scala MAGCAL_SCALE si semplifica)
+    for (int i = 0; i < 3; i++) for (int j = 0; j < 3; j++) {
+      double s = 0.0;
+      for (int e = 0; e < 3; e++) s += V[i][e] * sqrt(lam[e]) * V[j][e];
+      out.W[i * 3 + j] = (float)(rGeo * s);
+    }
+    for (int i = 0; i < 3; i++) out.off[i] = (float)((c[i] + sh[i]) / MAGCAL_SCALE);
+    out.fitPct = (float)(50.0 * rms);              // dᵀp − 1 ≈ 2·δr/r
+    out.mode   = 3;
+    out.magic  = MAGCAL_MAGIC;
+    return out.fitPct <= MAGCAL_MAX_FIT_PCT;
+  }
+
+  bool solve2D(EunoMagCal& out, float zOff) const {
+    static const int idx[5] = {0, 1, 3, 6, 7};    // x², y², 2xy, 2x, 2y
+    double sh[3], p[9], rms;
+    shiftCenter(sh);
+    if (!solveSub(idx, 5, sh, p, rms)) return false;
+    double A = p[0], B = p[1], D = p[2], G = p[3], H = p[4];
+    double det = A * B - D * D;
+    if (det <= 0.0) return false;
+    double cx = (-G * B + H * D) / det;
+    double cy = (-H * A + G * D) / det;
+    double k  = 1.0 + A * cx * cx + 2.0 * D * cx * cy + B * cy * cy;
+    if (fabs(k) < 1e-12 || A / k <= 0.0) return false;
+
+    double a[3][3] = { {A / k, D / k, 0.0}, {D / k, B / k, 0.0}, {0.0, 0.0, 1.0} };
+    double V[3][3], lam[3];
+    magcalJacobi3(a, V, lam);
+    double rMin = 1e300, rMax = 0.0, rGeo = 1.0;
+    for (int i = 0; i < 3; i++) {
+      if (lam[i] <= 0.0) return false;
+      if (fabs(V[2][i]) > 0.5) continue;           // asse Z fittizio
+      double ri = 1.0 / sqrt(lam[i]);
+      if (ri < rMin) rMin = ri;
+      if (ri > rMax) rMax = ri;
+      rGeo *= ri;
+    }
+    if (rMax / rMin > MAGCAL_MAX_AXIS_RATIO) return false;
+    rGeo = sqrt(rGeo);
+
+    for (int i = 0; i < 2; i++) for (int j = 0; j < 2; j++) {
+      double s = 0.0;
+      for (int e = 0; e < 3; e++)
+        if (fabs(V[2][e]) <= 0.5) s += V[i][e] * sqrt(lam[e]) * V[j][e];
+      out.W[i * 3 + j] = (float)(rGeo * s);
+    }
+    out.W[2] = out.W[5] = out.W[6] = out.W[7] = 0.0f;
+    out.W[8] = 1.0f;
+    out.off[0] = (float)((cx + sh[0]) / MAGCAL_SCALE);
+    out.off[1] = (float)((cy + sh[1]) / MAGCAL_SCALE);
+    out.off[2] = zOff;
+    out.fitPct = (float)(50.0 * rms);
+    out.mode   = 2;
+    out.magic  = MAGCAL_MAGIC;
+    return out.fitPct <= MAGCAL_MAX_FIT_PCT;
+  }
+};
+
+#endif // MAG_ELLIPSOID_H
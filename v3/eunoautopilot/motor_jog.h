@@ -0,0 +1,133 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// motor_jog.h — jog manuale dell'attuatore in standby, senza delay()
+//
+// ACTION:±1/±10 a pilota spento mettono in coda un impulso (JOG_PULSE_MS a
+// V_max). jogTick() gira nel task di controllo e comanda il motore:
+//   - pressioni ripetute nello stesso verso allungano l'impulso in corso
+//     (fino a JOG_MAX_MS di residuo) → tenere premuto = movimento continuo
+//   - inversione: pausa JOG_REVERSE_MS a motore fermo prima del verso opposto
+//   - autopilota inserito → coda svuotata e motore fermo
+// La coda è SPSC (loop() produce, task controllo consuma): niente lock.
+
+#ifndef MOTOR_JOG_H
+#define MOTOR_JOG_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#define JOG_PULSE_MS     700UL    // come il vecchio delay(700)
+#define JOG_MAX_MS       3000UL   // residuo massimo con pressioni accumulate
+#define JOG_REVERSE_MS   150UL    // motore fermo tra due versi opposti
+#define JOG_QUEUE_LEN    8
+
+extern int V_max;
+void extendMotor(int speed);
+void retractMotor(int speed);
+void stopMotor();
+
+enum EunoJogState : uint8_t { JOG_IDLE = 0, JOG_EXTEND, JOG_RETRACT, JOG_PAUSE };
+
+static volatile int8_t   jogQueue[JOG_QUEUE_LEN];   // +1 estendi, -1 ritrai
+static volatile uint8_t  jogHead = 0;               // scritto da loop()
+static volatile uint8_t  jogTail = 0;               // scritto dal task controllo
+
+static volatile EunoJogState jogState = JOG_IDLE;
+static int8_t        jogDir     = 0;
+static int8_t        jogNextDir = 0;      // verso in attesa dopo la pausa
+static unsigned long jogEndMs   = 0;
+
+// Mette in coda un impulso; false se la coda è piena (pressione scartata)
+static inline bool jogRequest(int dir){
+  uint8_t h = jogHead;
+  uint8_t n = (uint8_t)((h + 1) % JOG_QUEUE_LEN);
+  if (n == jogTail) return false;
+  jogQueue[h] = (dir > 0) ? 1 : -1;
+  jogHead = n;
+  return true;
+}
+
+static inline int jogQueued(){
+  return (int)((jogHead + JOG_QUEUE_LEN - jogTail) % JOG_QUEUE_LEN);
+}
+
+static inline bool jogPop(int8_t& dir){
+  uint8_t t = jogTail;
+  if (t == jogHead) return false;
+  dir = jogQueue[t];
+  jogTail = (uint8_t)((t + 1) % JOG_QUEUE_LEN);
+  return true;
+}
+
+static inline void jogDrive(int8_t dir, unsigned long now){
+  if (dir > 0) { extendMotor(V_max);  jogState = JOG_EXTEND;  }
+  else         { retractMotor(V_max); jogState = JOG_RETRACT; }
+  jogDir   = dir;
+  jogEndMs = now + JOG_PULSE_MS;
+}
+
+// Un passo della macchina a stati (task di controllo, pilota in standby)
+static inline void jogTick(unsigned long now, bool autopilotOn){
+  if (autopilotOn) {
+    int8_t d;
+    while (jogPop(d)) {}
+    if (jogState != JOG_IDLE) {
+      stopMotor();               // con pilota inserito il controllore riprende subito dopo
+      jogState = JOG_IDLE;
+      jogDir = jogNextDir = 0;
+    }
+    return;
+  }
+
+  // stesso verso dell'impulso in corso: allunga
+  int8_t d;
+  while ((jogState == JOG_EXTEND || jogState == JOG_RETRACT) && jogHead != jogTail
+         && jogQueue[jogTail] == jogDir) {
+    jogPop(d);
+    unsigned long left = (long)(jogEndMs - now) > 0 ? jogEndMs - now : 0;
+    jogEndMs = now + min(left + JOG_PULSE_MS, JOG_MAX_MS);
+  }
+
+  switch (jogState) {
+    case JOG_EXTEND:
+    case JOG_RETRACT:
+      if ((long)(now - jogEndMs) < 0) return;
+      stopMotor();
+      if (jogPop(d)) {
+        if (d == jogDir) { jogDrive(d, now); return; }
+        jogNextDir = d;
+        jogEndMs   = now + JOG_REVERSE_MS;
+        jogState   = JOG_PAUSE;
+      } else {
+        jogState = JOG_IDLE;
+        jogDir   = 0;
+      }
+      return;
+
+    case JOG_PAUSE:
+      if ((long)(now - jogEndMs) < 0) return;
+      jogDrive(jogNextDir, now);
+      jogNextDir = 0;
+      return;
+
+    default:
+      if (jogPop(d)) jogDrive(d, now);
+      return;
+  }
+}
+
+static inline const char* jogStateStr(){
+  switch (jogState) {
+    case JOG_EXTEND:  return "EXT";
+    case JOG_RETRACT: return "RET";
+    case JOG_PAUSE:   return "PAUSE";
+    default:          return "IDLE";
+  }
+}
+
+#endif // MOTOR_JOG_H
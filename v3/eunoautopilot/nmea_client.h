@@ -1,5 +1,7 @@
 #pragma once
 #include <Arduino.h>
+#include "track_mode.h"
+#include "wind_vane.h"
 
 // Callback che devi “collegare” alle tue funzioni reali:
 struct EunoCmdAPI {
@@ -10,6 +12,15 @@ struct EunoCmdAPI {
   std::function<void(const String&)> onCal  = [](const String&){};
   std::function<void(bool)> onExtBrg = [](bool){};
   std::function<void(int)> onExternalBearing = [](int){};
+  std::function<void(const EunoNavTarget&)> onNavTarget = [](const EunoNavTarget&){};   // RMB/APB decodificate
+  std::function<void(bool)> onTrack = [](bool){};   // modo TRACK (XTE) on/off
+  std::function<void(const EunoWindObs&)> onWind = [](const EunoWindObs&){};   // MWV/VWR apparente
+  std::function<void(const String&)> onWindMode = [](const String&){};        // ON/OFF
+  std::function<void(int)> onAwa = [](int){};                                  // AWA obiettivo (con segno)
+  std::function<void(const String&)> onRoute = [](const String&){};   // START/STOP/CLEAR/NEXT/PREV/ARRIVE:<m>
+  std::function<void(const String&)> onWpt   = [](const String&){};   // <lat>:<lon>[:<nome>] in coda alla rotta
+  std::function<void(bool)> onStat = [](bool){};
+  std::function<void(const String&)> onGps = [](const String&){};   // front end GPS: NMEA/UBX
   std::function<void(const String&,const String&)> onOpenPlotterFrame = [](const String&,const String&){}; // raw pass-through if needed
 };
 
@@ -22,21 +33,22 @@ static inline String nmeaGet(const String& line, const String& key){
   return line.substring(s + key.length() + 1, e);
 }
 
+// Percorso veloce per le frasi ad alto ritmo (vento 5–10 Hz): direttamente
+// sul buffer della riga, nessuna String. true = gestita.
+static inline bool parseNMEAFast(const char* s, EunoCmdAPI& api){
+  if (s[0] != '$') return false;
+  EunoWindObs w;
+  if (windParseMwv(s, millis(), w) || windParseVwr(s, millis(), w)) { api.onWind(w); return true; }
+  return nmeaIsType(s, "MWV") || nmeaIsType(s, "VWR");   // vero/non valido: ignorato qui
+}
+
 static inline void parseNMEAClientLine(const String& line, EunoCmdAPI& api){
-  // 1) Bearing esterno da RMB/APB
-  if (line.startsWith("$GPRMB") || line.startsWith("$GNRMB")){
-    // campo 11 = bearing to dest (°true)
-    int comma=0, start=0; String f11="";
-    for (int i=0;i<(int)line.length();i++){
-      if (line[i]==','){ comma++; if (comma==10){ start=i+1; } else if (comma==11){ f11 = line.substring(start,i); break; } }
-    }
-    int brg = (int)round(f11.toFloat());
-    if (brg>=0 && brg<360) api.onExternalBearing(brg);
-    api.onOpenPlotterFrame("RMB", line);
-    return;
-  }
-  if (line.startsWith("$GPAPB") || line.startsWith("$GNAPB")){
-    api.onOpenPlotterFrame("APB", line);
+  if (parseNMEAFast(line.c_str(), api)) return;
+  // 1) Waypoint da RMB/APB (qualsiasi talker): XTE, BOD/BTW/HTS, arrivo
+  EunoNavTarget nav;
+  if (navParseRmb(line.c_str(), millis(), nav) || navParseApb(line.c_str(), millis(), nav)){
+    api.onNavTarget(nav);
+    api.onOpenPlotterFrame(nav.src == NAV_SRC_APB ? "APB" : "RMB", line);
     return;
   }
   if (line.startsWith("$HDT") || line.startsWith("$HDG") || line.startsWith("$GPRMC") || line.startsWith("$GNRMC")){
@@ -53,6 +65,13 @@ static inline void parseNMEAClientLine(const String& line, EunoCmdAPI& api){
     // $PEUNO,CMD,MODE=COMPASS
     // $PEUNO,CMD,CAL=MAG
     // $PEUNO,CMD,EXTBRG=ON
+    // $PEUNO,CMD,STAT=ON
+    // $PEUNO,CMD,GPS=UBX
+    // $PEUNO,CMD,TRACK=ON
+    // $PEUNO,CMD,ROUTE=START
+    // $PEUNO,CMD,WPT=45.4312:12.3401:LIDO
+    // $PEUNO,CMD,WIND=ON
+    // $PEUNO,CMD,AWA=-40
 
     if (line.indexOf("DELTA=")>0){
       int v = nmeaGet(line, "DELTA").toInt();
@@ -79,5 +98,28 @@ static inline void parseNMEAClientLine(const String& line, EunoCmdAPI& api){
       String s = nmeaGet(line, "EXTBRG");
       api.onExtBrg(s=="ON"||s=="on"||s=="1"); return;
     }
+    if (line.indexOf("STAT=")>0){
+      String s = nmeaGet(line, "STAT");
+      api.onStat(s=="ON"||s=="on"||s=="1"); return;
+    }
+    if (line.indexOf(",WIND=")>0){
+      api.onWindMode(nmeaGet(line, "WIND")); return;
+    }
+    if (line.indexOf(",AWA=")>0){
+      api.onAwa(nmeaGet(line, "AWA").toInt()); return;
+    }
+    if (line.indexOf(",ROUTE=")>0){
+      api.onRoute(nmeaGet(line, "ROUTE")); return;
+    }
+    if (line.indexOf(",WPT=")>0){
+      api.onWpt(nmeaGet(line, "WPT")); return;
+    }
+    if (line.indexOf("TRACK=")>0){
+      String s = nmeaGet(line, "TRACK");
+      api.onTrack(s=="ON"||s=="on"||s=="1"); return;
+    }
+    if (line.indexOf(",GPS=")>0){
+      api.onGps(nmeaGet(line, "GPS")); return;
+    }
   }
 }
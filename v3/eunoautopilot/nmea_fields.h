@@ -0,0 +1,99 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// nmea_fields.h — campi di una frase NMEA letti sul buffer della riga
+//
+// Niente String né copie della riga: si scorre fino all'n-esima virgola e si
+// converte il campo (al massimo 15 caratteri, copiati sullo stack). Usato
+// dalle frasi che arrivano a ritmo alto (MWV 5–10 Hz) e da RMB/APB.
+
+#ifndef NMEA_FIELDS_H
+#define NMEA_FIELDS_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Campo n (0 = "$--XXX") della frase: inizio e lunghezza, false se non c'è
+static inline bool nmeaFieldSpan(const char* s, int n, const char*& b, int& len){
+  const char* p = s;
+  for (int i = 0; i < n; i++) {
+    p = strchr(p, ',');
+    if (!p) return false;
+    p++;
+  }
+  const char* e = p;
+  while (*e && *e != ',' && *e != '*' && *e != '\r' && *e != '\n') e++;
+  b = p; len = (int)(e - p);
+  return true;
+}
+
+static inline float nmeaFieldFloat(const char* s, int n){
+  const char* b; int len;
+  if (!nmeaFieldSpan(s, n, b, len) || len <= 0 || len > 15) return NAN;
+  char tmp[16];
+  memcpy(tmp, b, len); tmp[len] = 0;
+  char* end;
+  float v = strtof(tmp, &end);
+  return end == tmp ? NAN : v;
+}
+
+static inline char nmeaFieldChar(const char* s, int n){
+  const char* b; int len;
+  return (nmeaFieldSpan(s, n, b, len) && len > 0) ? b[0] : 0;
+}
+
+// true se manca il checksum o se torna
+static inline bool nmeaChecksumOk(const char* s){
+  const char* star = strchr(s, '*');
+  if (!star) return true;
+  if (*s != '$' && *s != '!') return false;
+  uint8_t x = 0;
+  for (const char* p = s + 1; p < star; p++) x ^= (uint8_t)*p;
+  char hex[3] = { star[1], star[1] ? star[2] : (char)0, 0 };
+  return hex[0] && hex[1] && (uint8_t)strtoul(hex, nullptr, 16) == x;
+}
+
+// Lettura in un solo passaggio, campo dopo campo (frasi ad alto ritmo)
+struct EunoNmeaCursor {
+  const char* p;
+  const char* b = nullptr;
+  int         len = 0;
+
+  explicit EunoNmeaCursor(const char* s) : p(s) {}
+
+  // passa al campo successivo; false a fine frase
+  bool next(){
+    if (!p) return false;
+    const char* c = p;
+    while (*c && *c != ',' && *c != '*' && *c != '\r' && *c != '\n') c++;
+    if (*c != ',') { p = nullptr; return false; }
+    b = ++c;
+    const char* e = b;
+    while (*e && *e != ',' && *e != '*' && *e != '\r' && *e != '\n') e++;
+    len = (int)(e - b);
+    p = b;
+    return true;
+  }
+
+  char  ch() const { return len > 0 ? b[0] : 0; }
+  float num() const {
+    if (len <= 0 || len > 15) return NAN;
+    char tmp[16];
+    memcpy(tmp, b, len); tmp[len] = 0;
+    char* end;
+    float v = strtof(tmp, &end);
+    return end == tmp ? NAN : v;
+  }
+};
+
+static inline bool nmeaIsType(const char* s, const char* type3){
+  return s[0] == '$' && s[1] && s[2] && strncmp(s + 3, type3, 3) == 0 && s[6] == ',';
+}
+
+#endif // NMEA_FIELDS_H
@@ -0,0 +1,226 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// route_engine.h — rotta a bordo: waypoint in EEPROM, navigazione per ortodromia
+//
+// La rotta (fino a ROUTE_MAX_WP waypoint) arriva da HTTP (/api/route) o da
+// WS/UDP ($PEUNO,CMD,WPT=...) e sta nel record CFG_ROUTE, con il waypoint
+// attivo: dopo un riavvio ROUTE=START riprende dalla stessa tratta.
+// A ogni nuovo fix (gps_fix.h, posizione valida e recente) la tratta
+// origine → waypoint attivo dà, sulla sfera:
+//   BTW/DTW     bearing e distanza al waypoint
+//   XTE         distanza dal cerchio massimo della tratta (+ = a dritta per rientrare)
+//   traccia     direzione del cerchio massimo nel punto più vicino della tratta
+// e ne esce un EunoNavTarget, lo stesso di RMB/APB: il comando lo calcola
+// EunoTrackCtl (track_mode.h) e va direttamente in headingCommand, senza
+// plotter né bearing via rete.
+// Arrivo: dentro il cerchio (arriveM) o oltre la perpendicolare al waypoint;
+// si passa da solo al successivo, all'ultimo la rotta finisce e resta la
+// prua corrente. Origine della prima tratta (e dopo NEXT/PREV) = posizione
+// di quel momento, poi il waypoint appena raggiunto.
+
+#ifndef ROUTE_ENGINE_H
+#define ROUTE_ENGINE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gps_fix.h"
+#include "track_mode.h"
+
+#define ROUTE_MAX_WP       32
+#define ROUTE_CFG_VER      1          // record CFG_ROUTE (euno_config.h)
+#define ROUTE_ARRIVE_M     50         // raggio d'arrivo di default
+#define ROUTE_ARRIVE_MIN_M 10
+#define ROUTE_ARRIVE_MAX_M 2000
+#define ROUTE_FIX_AGE_MS   3000UL     // posizione più vecchia: niente passo
+#define GEO_R_NM           3440.065   // raggio terrestre medio (nm)
+#define GEO_M_PER_NM       1852.0
+
+struct EunoWaypoint {
+  int32_t lat = 0, lon = 0;           // 1e-7 °
+  char    name[8] = "";
+};
+
+// Record CFG_ROUTE (4 + 32·16 = 516 byte)
+struct EunoRoute {
+  uint8_t      count   = 0;
+  uint8_t      active  = 0;           // waypoint verso cui si naviga
+  uint16_t     arriveM = ROUTE_ARRIVE_M;
+  EunoWaypoint wp[ROUTE_MAX_WP];
+};
+
+static inline double geo_rad(double d){ return d * (M_PI / 180.0); }
+static inline double geo_deg(double r){ return r * (180.0 / M_PI); }
+static inline double geo_wrap360(double a){ a = fmod(a, 360.0); return a < 0.0 ? a + 360.0 : a; }
+
+// Gradi decimali da testo (lat: lim 90, lon: lim 180). Tutta la stringa
+// dev'essere il numero (a parte spazi ai bordi): "45.1x" o "" → false,
+// mentre String::toDouble() darebbe un waypoint a 0° senza dirlo.
+static inline bool geoParseDeg(const char* s, double lim, double& out){
+  char* end;
+  double v = strtod(s, &end);
+  if (end == s) return false;
+  while (*end == ' ' || *end == '\t' || *end == '\r') end++;
+  if (*end || !isfinite(v) || fabs(v) > lim) return false;
+  out = v;
+  return true;
+}
+
+// Distanza angolare (rad, haversine) e bearing iniziale (°) da 1 a 2
+static inline double geoDistRad(double lat1, double lon1, double lat2, double lon2){
+  double p1 = geo_rad(lat1), p2 = geo_rad(lat2);
+  double dp = p2 - p1, dl = geo_rad(lon2 - lon1);
+  double a = sin(dp / 2) * sin(dp / 2) + cos(p1) * cos(p2) * sin(dl / 2) * sin(dl / 2);
+  if (a > 1.0) a = 1.0;
+  return 2.0 * atan2(sqrt(a), sqrt(1.0 - a));
+}
+
+static inline double geoBearingDeg(double lat1, double lon1, double lat2, double lon2){
+  double p1 = geo_rad(lat1), p2 = geo_rad(lat2), dl = geo_rad(lon2 - lon1);
+  double y = sin(dl) * cos(p2);
+  double x = cos(p1) * sin(p2) - sin(p1) * cos(p2) * cos(dl);
+  return geo_wrap360(geo_deg(atan2(y, x)));
+}
+
+// Punto a distanza angolare d (rad) lungo il bearing brg (°)
+static inline void geoDestination(double lat, double lon, double brg, double d, double& lat2, double& lon2){
+  double p1 = geo_rad(lat), l1 = geo_rad(lon), th = geo_rad(brg);
+  double p2 = asin(sin(p1) * cos(d) + cos(p1) * sin(d) * cos(th));
+  double l2 = l1 + atan2(sin(th) * sin(d) * cos(p1), cos(d) - sin(p1) * sin(p2));
+  lat2 = geo_deg(p2);
+  lon2 = fmod(geo_deg(l2) + 540.0, 360.0) - 180.0;
+}
+
+struct EunoRouteLeg {
+  float btwDeg   = NAN;
+  float dtwNm    = NAN;
+  float trackDeg = NAN;    // direzione della tratta nel punto più vicino
+  float xteNm    = 0.0f;   // + = governare a dritta
+  float atdNm    = 0.0f;   // percorso lungo la tratta (dall'origine)
+  float legNm    = 0.0f;
+};
+
+// Geometria della tratta o→w vista dalla posizione p
+static inline void routeLegGeometry(double oLat, double oLon, double wLat, double wLon,
+                                    double lat, double lon, EunoRouteLeg& g){
+  g = EunoRouteLeg();
+  g.btwDeg = (float)geoBearingDeg(lat, lon, wLat, wLon);
+  g.dtwNm  = (float)(geoDistRad(lat, lon, wLat, wLon) * GEO_R_NM);
+  double d12 = geoDistRad(oLat, oLon, wLat, wLon);
+  g.legNm  = (float)(d12 * GEO_R_NM);
+  if (d12 < 1.0 / (GEO_R_NM * GEO_M_PER_NM)) {   // tratta < 1 m: solo BTW
+    g.trackDeg = g.btwDeg;
+    return;
+  }
+  double d13 = geoDistRad(oLat, oLon, lat, lon);
+  double t12 = geoBearingDeg(oLat, oLon, wLat, wLon);
+  double t13 = geoBearingDeg(oLat, oLon, lat, lon);
+  double dxt = asin(sin(d13) * sin(geo_rad(t13 - t12)));     // + = a destra della tratta
+  double c   = cos(dxt) > 1e-12 ? cos(d13) / cos(dxt) : 1.0;
+  if (c > 1.0)  c = 1.0;
+  if (c < -1.0) c = -1.0;
+  double dat = acos(c) * (cos(geo_rad(t13 - t12)) < 0.0 ? -1.0 : 1.0);
+  g.xteNm = (float)(-dxt * GEO_R_NM);
+  g.atdNm = (float)(dat * GEO_R_NM);
+  double pLat, pLon;
+  geoDestination(oLat, oLon, t12, dat, pLat, pLon);
+  g.trackDeg = (dat < d12 - 1e-9) ? (float)geoBearingDeg(pLat, pLon, wLat, wLon) : g.btwDeg;
+}
+
+enum EunoRouteStep : uint8_t { ROUTE_STEP_NONE = 0, ROUTE_STEP_STEER, ROUTE_STEP_ADVANCED, ROUTE_STEP_DONE };
+
+struct EunoRouteNav {
+  EunoRoute    r;
+  bool         running   = false;
+  bool         hasOrigin = false;
+  double       oLat = 0.0, oLon = 0.0;
+  uint32_t     lastFixMs = 0;
+  EunoRouteLeg leg;
+
+  static double wpLat(const EunoWaypoint& w){ return w.lat * 1e-7; }
+  static double wpLon(const EunoWaypoint& w){ return w.lon * 1e-7; }
+
+  bool add(double lat, double lon, const char* name){
+    if (r.count >= ROUTE_MAX_WP || isnan(lat) || isnan(lon) ||
+        fabs(lat) > 90.0 || fabs(lon) > 180.0) return false;
+    EunoWaypoint& w = r.wp[r.count];
+    w.lat = (int32_t)lround(lat * 1e7);
+    w.lon = (int32_t)lround(lon * 1e7);
+    memset(w.name, 0, sizeof(w.name));
+    if (name) strncpy(w.name, name, sizeof(w.name) - 1);
+    r.count++;
+    return true;
+  }
+
+  void clear(){ stop(); uint16_t a = r.arriveM; r = EunoRoute(); r.arriveM = a; }
+
+  void setArrive(int m){
+    if (m < ROUTE_ARRIVE_MIN_M) m = ROUTE_ARRIVE_MIN_M;
+    if (m > ROUTE_ARRIVE_MAX_M) m = ROUTE_ARRIVE_MAX_M;
+    r.arriveM = (uint16_t)m;
+  }
+
+  // Riprende dal waypoint attivo: origine = quello prima, se c'è
+  bool start(){
+    if (!r.count) return false;
+    if (r.active >= r.count) r.active = 0;
+    hasOrigin = r.active > 0;
+    if (hasOrigin) { oLat = wpLat(r.wp[r.active - 1]); oLon = wpLon(r.wp[r.active - 1]); }
+    running = true;
+    return true;
+  }
+
+  void stop(){ running = false; hasOrigin = false; leg = EunoRouteLeg(); }
+
+  // Salto manuale: la nuova tratta parte dalla posizione attuale
+  bool select(int idx){
+    if (idx < 0 || idx >= r.count) return false;
+    r.active = (uint8_t)idx;
+    hasOrigin = false;
+    return true;
+  }
+
+  const EunoWaypoint* activeWp() const { return (running && r.active < r.count) ? &r.wp[r.active] : nullptr; }
+
+  // Nuovo fix → target per EunoTrackCtl. ADVANCED/DONE: il waypoint attivo è
+  // cambiato (da salvare)
+  EunoRouteStep step(const EunoGpsFix& f, uint32_t now, EunoNavTarget& t){
+    if (!running || !f.posValid || f.ms == lastFixMs || f.ageMs(now) > ROUTE_FIX_AGE_MS) return ROUTE_STEP_NONE;
+    lastFixMs = f.ms;
+    if (!hasOrigin) { oLat = f.lat; oLon = f.lon; hasOrigin = true; }
+
+    EunoRouteStep res = ROUTE_STEP_STEER;
+    const EunoWaypoint* w = &r.wp[r.active];
+    routeLegGeometry(oLat, oLon, wpLat(*w), wpLon(*w), f.lat, f.lon, leg);
+    bool arrived = leg.dtwNm * GEO_M_PER_NM <= r.arriveM ||
+                   (leg.legNm * GEO_M_PER_NM > r.arriveM && leg.atdNm >= leg.legNm);
+    if (arrived) {
+      if (r.active + 1 >= r.count) { running = false; return ROUTE_STEP_DONE; }
+      oLat = wpLat(*w); oLon = wpLon(*w);
+      r.active++;
+      w = &r.wp[r.active];
+      routeLegGeometry(oLat, oLon, wpLat(*w), wpLon(*w), f.lat, f.lon, leg);
+      res = ROUTE_STEP_ADVANCED;
+    }
+
+    t = EunoNavTarget();
+    t.ms     = f.ms;
+    t.src    = NAV_SRC_ROUTE;
+    t.valid  = true;
+    t.hasXte = true;
+    t.xteNm  = leg.xteNm;
+    t.bodDeg = leg.trackDeg;
+    t.btwDeg = leg.btwDeg;
+    if (w->name[0]) strncpy(t.dest, w->name, sizeof(t.dest) - 1);
+    else { t.dest[0] = '#'; t.dest[1] = (char)('0' + r.active / 10); t.dest[2] = (char)('0' + r.active % 10); t.dest[3] = 0; }
+    return res;
+  }
+};
+
+#endif // ROUTE_ENGINE_H
@@ -0,0 +1,251 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// sensor_ahrs.h — assetto completo a quaternione (Mahony) per headingSourceMode 4
+//
+// La fusion di sensor_fusion.h integra solo il gyro Z: con la barca sbandata
+// la rotazione attorno alla verticale non è più gz e il heading oscilla col
+// rollio. Qui il filtro integra i tre assi del gyro e corregge:
+//   - tilt  con l'accelerometro (scartato se |a| lontano da g: onde/accostate)
+//   - rotta con il magnetometro, solo sulla componente verticale dell'errore
+//     (un disturbo magnetico non sporca pitch/roll)
+//   - bias gyro sui tre assi con il termine integrale (stimato online)
+// Il vettore gravità stimato serve anche la compensazione tilt della bussola
+// (getTiltSinCos/getTiltAngles in calibration.h) al posto dell'accel grezzo.
+//
+// Frame interno: body FLU (x prua, y sinistra, z alto), terra NWU. Gli assi
+// del sensore sono mappati come li usa già il resto del firmware (heading =
+// atan2(mx, my) a barca piana, gz + = orario, az = +g a riposo): se il modulo
+// è montato diversamente basta cambiare ahrsImuToBody()/ahrsMagToBody().
+// Costo: ~90 ns/update sull'host, qualche µs sull'S3 (v3/host/bench_ahrs).
+
+#ifndef SENSOR_AHRS_H
+#define SENSOR_AHRS_H
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdint.h>
+#include "euno_fastmath.h"
+
+#define AHRS_KP_ACC       0.5f     // richiamo tilt (1/s)
+#define AHRS_KP_MAG       0.2f     // richiamo rotta (1/s)
+#define AHRS_KI           0.01f    // stima bias gyro
+#define AHRS_KP_BOOT      10.0f    // guadagno alto nei primi secondi (convergenza)
+#define AHRS_BOOT_S       2.0f
+#define AHRS_WARM_BOOT_S  0.5f     // con bias ripristinati basta la convergenza dell'assetto
+#define AHRS_ACC_GATE     0.15f    // | |a|/g − 1 | oltre cui l'accel è ignorato
+#define AHRS_BIAS_MAX_RPS 0.1f     // ~6 °/s: limite della stima bias
+#define AHRS_BIAS_RATE_RPS 0.35f   // niente stima bias in accostata veloce (~20 °/s)
+#define AHRS_G            9.80665f
+
+// Mappa sensore → body FLU. accel/gyro e magnetometro hanno funzioni separate
+// perché nell'ICM-20948 l'AK09916 ha assi propri (Y e Z opposti sul die): se
+// il driver li passa così come sono, correggere ahrsMagToBody().
+static inline void ahrsImuToBody(float sx, float sy, float sz, float &bx, float &by, float &bz){
+  bx = sy; by = sx; bz = sz;
+}
+static inline void ahrsMagToBody(float sx, float sy, float sz, float &bx, float &by, float &bz){
+  bx = sy; by = sx; bz = sz;
+}
+// Il gyro è uno pseudo-vettore: la mappa sopra scambia due assi (det = −1),
+// quindi cambia segno
+static inline void ahrsGyroToBody(float sx, float sy, float sz, float &bx, float &by, float &bz){
+  bx = -sy; by = -sx; bz = -sz;
+}
+
+struct EunoAhrs {
+  float q0 = 1.0f, q1 = 0.0f, q2 = 0.0f, q3 = 0.0f;   // terra → body
+  float biasX = 0.0f, biasY = 0.0f, biasZ = 0.0f;     // bias gyro body (rad/s)
+  float bootS = 0.0f;                                  // tempo integrato dall'avvio
+  uint32_t updates = 0;
+  uint32_t accRejects = 0;
+
+  void reset(){
+    q0 = 1.0f; q1 = q2 = q3 = 0.0f;
+    bootS = 0.0f; updates = 0; accRejects = 0;
+  }
+
+  // Riavvio con bias noti (checkpoint): fase a guadagno alto ridotta
+  void warmStart(float bx, float by, float bz){
+    reset();
+    biasX = constrain(bx, -AHRS_BIAS_MAX_RPS, AHRS_BIAS_MAX_RPS);
+    biasY = constrain(by, -AHRS_BIAS_MAX_RPS, AHRS_BIAS_MAX_RPS);
+    biasZ = constrain(bz, -AHRS_BIAS_MAX_RPS, AHRS_BIAS_MAX_RPS);
+    bootS = AHRS_BOOT_S - AHRS_WARM_BOOT_S;
+  }
+
+  bool ready() const { return bootS >= AHRS_BOOT_S; }
+
+  // Assetto iniziale diretto da accel + mag (body): righe di R = nord, ovest,
+  // alto in body, poi quaternione. Senza, il filtro parte da prua a nord e
+  // impiega la fase di boot per girare.
+  bool align(float ax, float ay, float az, float mx, float my, float mz){
+    float a2 = ax*ax + ay*ay + az*az;
+    if (a2 <= 0.0f) return false;
+    float ra = 1.0f / sqrtf(a2);
+    float ux = ax*ra, uy = ay*ra, uz = az*ra;
+    float wx = uy*mz - uz*my, wy = uz*mx - ux*mz, wz = ux*my - uy*mx;   // alto × m = ovest
+    float w2 = wx*wx + wy*wy + wz*wz;
+    if (w2 <= 1e-12f) return false;
+    float rw = 1.0f / sqrtf(w2);
+    wx *= rw; wy *= rw; wz *= rw;
+    float nx = wy*uz - wz*uy, ny = wz*ux - wx*uz, nz = wx*uy - wy*ux;    // ovest × alto = nord
+    // R = [n; w; u] (body → terra), quaternione (Shepperd)
+    float tr = nx + wy + uz;
+    if (tr > 0.0f) {
+      float k = 0.5f / sqrtf(tr + 1.0f);
+      q0 = 0.25f / k; q1 = (uy - wz) * k; q2 = (nz - ux) * k; q3 = (wx - ny) * k;
+    } else if (nx > wy && nx > uz) {
+      float k = 0.5f / sqrtf(1.0f + nx - wy - uz);
+      q0 = (uy - wz) * k; q1 = 0.25f / k; q2 = (wx + ny) * k; q3 = (ux + nz) * k;
+    } else if (wy > uz) {
+      float k = 0.5f / sqrtf(1.0f + wy - nx - uz);
+      q0 = (nz - ux) * k; q1 = (wx + ny) * k; q2 = 0.25f / k; q3 = (uy + wz) * k;
+    } else {
+      float k = 0.5f / sqrtf(1.0f + uz - nx - wy);
+      q0 = (wx - ny) * k; q1 = (ux + nz) * k; q2 = (uy + wz) * k; q3 = 0.25f / k;
+    }
+    float rq = 1.0f / sqrtf(q0*q0 + q1*q1 + q2*q2 + q3*q3);
+    q0 *= rq; q1 *= rq; q2 *= rq; q3 *= rq;
+    return true;
+  }
+
+  // Un passo: gyro rad/s, accel m/s², mag µT (già hard/soft-iron), tutto in body
+  void update(float gx, float gy, float gz,
+              float ax, float ay, float az,
+              float mx, float my, float mz, float dt){
+    float kpA = AHRS_KP_ACC, kpM = AHRS_KP_MAG;
+    if (bootS < AHRS_BOOT_S) { kpA = kpM = AHRS_KP_BOOT; bootS += dt; }
+
+    gx -= biasX; gy -= biasY; gz -= biasZ;
+
+    // direzione stimata dell'alto in body (terza colonna di R), metà
+    float hvx = q1*q3 - q0*q2;
+    float hvy = q0*q1 + q2*q3;
+    float hvz = q0*q0 - 0.5f + q3*q3;
+
+    float ex = 0.0f, ey = 0.0f, ez = 0.0f;   // errore pesato (richiamo)
+    float ix = 0.0f, iy = 0.0f, iz = 0.0f;   // errore grezzo (integrale bias)
+
+    // tilt: errore tra accel misurato e alto stimato
+    float a2 = ax*ax + ay*ay + az*az;
+    if (a2 > 0.0f) {
+      float ra = 1.0f / sqrtf(a2);
+      float dev = a2 * ra * (1.0f / AHRS_G) - 1.0f;
+      if (fabsf(dev) < AHRS_ACC_GATE) {
+        ax *= ra; ay *= ra; az *= ra;
+        float eax = ay*hvz - az*hvy;
+        float eay = az*hvx - ax*hvz;
+        float eaz = ax*hvy - ay*hvx;
+        ex += kpA * eax; ey += kpA * eay; ez += kpA * eaz;
+        ix += eax;       iy += eay;       iz += eaz;
+      } else {
+        accRejects++;
+      }
+    }
+
+    // rotta: campo orizzontale riportato a nord, errore proiettato sull'alto
+    float m2 = mx*mx + my*my + mz*mz;
+    if (m2 > 0.0f) {
+      float rm = 1.0f / sqrtf(m2);
+      mx *= rm; my *= rm; mz *= rm;
+      float hx = 2.0f * (mx*(0.5f - q2*q2 - q3*q3) + my*(q1*q2 - q0*q3) + mz*(q1*q3 + q0*q2));
+      float hy = 2.0f * (mx*(q1*q2 + q0*q3) + my*(0.5f - q1*q1 - q3*q3) + mz*(q2*q3 - q0*q1));
+      float bxE = sqrtf(hx*hx + hy*hy);
+      float bzE = 2.0f * (mx*(q1*q3 - q0*q2) + my*(q2*q3 + q0*q1) + mz*(0.5f - q1*q1 - q2*q2));
+      float hwx = bxE*(0.5f - q2*q2 - q3*q3) + bzE*(q1*q3 - q0*q2);
+      float hwy = bxE*(q1*q2 - q0*q3)        + bzE*(q0*q1 + q2*q3);
+      float hwz = bxE*(q0*q2 + q1*q3)        + bzE*(0.5f - q1*q1 - q2*q2);
+      float emx = my*hwz - mz*hwy;
+      float emy = mz*hwx - mx*hwz;
+      float emz = mx*hwy - my*hwx;
+      // solo la componente lungo la verticale (|hv| = 1/2 → fattore 4)
+      float p = 4.0f * (emx*hvx + emy*hvy + emz*hvz);
+      ex += kpM * p * hvx; ey += kpM * p * hvy; ez += kpM * p * hvz;
+      ix += p * hvx;       iy += p * hvy;       iz += p * hvz;
+    }
+
+    // bias: integrale dell'errore, fermo in accostata veloce e nei primi secondi
+    if (bootS >= AHRS_BOOT_S && gx*gx + gy*gy + gz*gz < AHRS_BIAS_RATE_RPS * AHRS_BIAS_RATE_RPS) {
+      float k = 2.0f * AHRS_KI * dt;
+      biasX = constrain(biasX - k * ix, -AHRS_BIAS_MAX_RPS, AHRS_BIAS_MAX_RPS);
+      biasY = constrain(biasY - k * iy, -AHRS_BIAS_MAX_RPS, AHRS_BIAS_MAX_RPS);
+      biasZ = constrain(biasZ - k * iz, -AHRS_BIAS_MAX_RPS, AHRS_BIAS_MAX_RPS);
+    }
+
+    gx += 2.0f * ex; gy += 2.0f * ey; gz += 2.0f * ez;
+
+    // q̇ = ½ q ⊗ ω
+    float h = 0.5f * dt;
+    float a = q0, b = q1, c = q2;
+    q0 += (-b*gx - c*gy - q3*gz) * h;
+    q1 += ( a*gx + c*gz - q3*gy) * h;
+    q2 += ( a*gy - b*gz + q3*gx) * h;
+    q3 += ( a*gz + b*gy - c*gx) * h;
+    float rq = 1.0f / sqrtf(q0*q0 + q1*q1 + q2*q2 + q3*q3);
+    q0 *= rq; q1 *= rq; q2 *= rq; q3 *= rq;
+    updates++;
+  }
+
+  // Heading bussola (0 = N, orario +), gradi 0..360
+  float headingDeg() const {
+    float yawNWU = fm_atan2_deg360(2.0f * (q1*q2 + q0*q3), 1.0f - 2.0f * (q2*q2 + q3*q3));
+    float h = 360.0f - yawNWU;
+    return (h >= 360.0f) ? h - 360.0f : h;
+  }
+
+  // Versore "alto" in body (= accel a riposo, senza onde/accostata)
+  void upBody(float &ux, float &uy, float &uz) const {
+    ux = 2.0f * (q1*q3 - q0*q2);
+    uy = 2.0f * (q0*q1 + q2*q3);
+    uz = 1.0f - 2.0f * (q1*q1 + q2*q2);
+  }
+
+  // Sbandamento (+ a dritta) e beccheggio (+ prua su), gradi
+  float heelDeg() const {
+    float ux, uy, uz; upBody(ux, uy, uz);
+    return fm_atan2(uy, uz) * FM_RAD2DEG;
+  }
+  float pitchDeg() const {
+    float ux, uy, uz; upBody(ux, uy, uz);
+    return fm_atan2(ux, sqrtf(uy*uy + uz*uz)) * FM_RAD2DEG;
+  }
+};
+
+static EunoAhrs ahrs;   // aggiornato dal tick fusion (task di controllo)
+
+// Un passo con i campioni negli assi del sensore (come li dà ICMCompass)
+static inline void ahrsUpdateSensor(float gx, float gy, float gz,
+                                    float ax, float ay, float az,
+                                    float mx, float my, float mz, float dt){
+  float bgx, bgy, bgz, bax, bay, baz, bmx, bmy, bmz;
+  ahrsGyroToBody(gx, gy, gz, bgx, bgy, bgz);
+  ahrsImuToBody(ax, ay, az, bax, bay, baz);
+  ahrsMagToBody(mx, my, mz, bmx, bmy, bmz);
+  ahrs.update(bgx, bgy, bgz, bax, bay, baz, bmx, bmy, bmz, dt);
+}
+
+// Allineamento iniziale con accel e mag negli assi del sensore
+static inline bool ahrsAlignSensor(float ax, float ay, float az, float mx, float my, float mz){
+  float bax, bay, baz, bmx, bmy, bmz;
+  ahrsImuToBody(ax, ay, az, bax, bay, baz);
+  ahrsMagToBody(mx, my, mz, bmx, bmy, bmz);
+  return ahrs.align(bax, bay, baz, bmx, bmy, bmz);
+}
+
+// Alto stimato negli assi del sensore (stessa convenzione dell'accel)
+static inline void ahrsUpSensor(float &sx, float &sy, float &sz){
+  float ux, uy, uz; ahrs.upBody(ux, uy, uz);
+  // ahrsImuToBody è uno scambio x↔y: è la sua stessa inversa
+  ahrsImuToBody(ux, uy, uz, sx, sy, sz);
+}
+
+// Bias Z del sensore (rad/s, convenzione di gyroBiasZ_radps in sensor_fusion.h)
+static inline float ahrsSensorBiasZ(){ return -ahrs.biasZ; }
+static inline void  ahrsSeedSensorBiasZ(float b){ ahrs.biasZ = -b; }
+
+#endif // SENSOR_AHRS_H
@@ -19,19 +19,26 @@
 
 #include <Arduino.h>
 #include <math.h>
-#include <TinyGPSPlus.h>
 
 #define EUNO_IS_CLIENT
 #include "euno_debug.h"
 #include "icm_compass.h"   // tua classe per ICM-20948
+#include "icm_acquisition.h" // FIFO + task di acquisizione (imuRing)
+#include "euno_fastmath.h"
+#include "sensor_ahrs.h"      // assetto a quaternione (MODE 4)
+#include "compass_deviation.h" // curva di deviazione appresa dal COG
+#include "gps_fix.h"          // ultimo fix GPS (front end NMEA o UBX)
+#include "gps_motion.h"       // COG/SOG filtrati (Kalman), aggiornati qui
+#include "euno_config.h"      // checkpoint (record CFG_FUSION)
 
 // ====== DICHIARAZIONI ESTERNE (già nel progetto) ======================
 extern ICMCompass   compass;          // dal .ino
-extern TinyGPSPlus  gps;              // dal .ino
-extern float        smoothedSpeed;    // nodi (dal .ino)
+extern float        smoothedSpeed;    // nodi (dal .ino), SOG filtrata da gpsMotionStep
 
 // Bussola tilt-compensata (tua) da calibration.h
 extern int getCorrectedHeading();
+extern void getCalibratedMag(float &mx, float &my, float &mz);
+extern int headingOffset;        // offset C-GPS (anche per l'AHRS)
 
 // ====== VARIABILI USATE NEL .INO =====================================
 // Le tieni così: il .ino le usa direttamente in setup()/loop().
@@ -58,6 +65,17 @@ static inline float sf_angDiff(float to, float from){
   return sf_wrap180(to - from);
 }
 
+// Incertezza 1σ del COG come riferimento di prua (°); NAN senza accuratezze
+static inline float sf_cogSigmaDeg(const EunoGpsFix& f){
+  if (isnan(f.cogAccDeg)) return NAN;
+  float s2 = f.cogAccDeg * f.cogAccDeg;
+  if (!isnan(f.sogAccKn) && f.sogKn > 0.1f) {
+    float sv = f.sogAccKn / f.sogKn * (180.0f / (float)M_PI);   // velocità incerta → direzione incerta
+    s2 += sv * sv;
+  }
+  return sqrtf(s2);
+}
+
 // ====== PARAMETRI “STILE ANDROID” ====================================
 static const float FUSION_HZ         = 100.0f;
 static const float ALPHA_SLOW        = 0.98f;   // richiamo magnete 2%/step @100Hz
@@ -66,22 +84,29 @@ static const float VEL_MIN_KN        = 1.0f;
 static const float VEL_MAX_KN        = 4.0f;
 static const float TURN_FAST_DEGPS   = 15.0f;
 static const uint32_t GPS_CORR_MS    = 10000;
-static const float    GPS_CORR_GAIN  = 0.10f;
+static const float    GPS_CORR_GAIN  = 0.10f;   // senza accuratezze (NMEA)
+// Con UBX NAV-PVT il guadagno segue l'incertezza del COG (headAcc, più la
+// parte angolare di sAcc rispetto alla velocità):
+//   gain = GPS_CORR_GAIN_MAX / (1 + (σ / GPS_COG_ACC_REF)²)
+// σ = GPS_COG_ACC_REF dà il GPS_CORR_GAIN fisso; oltre GPS_COG_ACC_MAX niente richiamo
+static const float    GPS_CORR_GAIN_MAX = 0.20f;
+static const float    GPS_COG_ACC_REF   = 2.0f;    // °
+static const float    GPS_COG_ACC_MAX   = 15.0f;   // °
 
 // ====== STATO INTERNO =================================================
 static bool      fusionInit        = false;
 static uint32_t  lastMicrosFusion  = 0;
+static uint32_t  lastGyroSampleUs  = 0;   // ultimo campione FIFO integrato
 
 float headingGyro         = 0.0f;  // integrazione gyro (°)
 float headingExperimental = 0.0f;  // EXPERIMENTAL = heading fuso
+float rateOfTurnDegps     = 0.0f;  // ROT gyro Z compensato (°/s, + = verso dritta)
 
 // bias/scala gyro (calib GYRO)
 static float gyroBiasZ_radps = 0.0f;
 static float gyroScale       = 1.0f;
 
-// buffer media COG per richiamo lento GPS
-static float      gpsHBuf[5]   = {0,0,0,0,0};
-static int        gpsHIdx      = 0;
+// richiamo lento GPS (COG filtrato da gps_motion.h)
 static bool       gpsLatched   = false;
 static uint32_t   lastGpsCorr  = 0;
 
@@ -103,6 +128,105 @@ static inline bool readAccel(float &ax, float &ay, float &az){
   ax = ay = az = NAN; return false;
 }
 
+// ====== WARM START (checkpoint in EEPROM) =============================
+// Dopo un riavvio (calo di tensione) la fusion ripartiva da zero: bias gyro
+// nullo fino a un nuovo CAL=GYRO, heading = bussola, latch GPS da rifare.
+// Un checkpoint periodico (record CFG_FUSION) salva bias e scala gyro, offset
+// tilt, bias AHRS sui 3 assi e l'heading fuso con la sua differenza dalla
+// bussola. Al boot i bias tornano subito; heading e latch GPS solo se la
+// bussola + differenza salvata ritrova l'heading del checkpoint (barca non
+// girata nel frattempo), altrimenti si riparte dalla bussola.
+#define FUSION_CKPT_VER        1
+#define FUSION_CKPT_MS         600000UL   // al massimo ogni 10 min (usura flash)
+#define FUSION_CKPT_BIAS_RADPS 0.0002f    // ~0.01 °/s: variazione che merita un checkpoint
+#define FUSION_CKPT_HDG_DEG    10.0f
+#define FUSION_WARM_HDG_DEG    20.0f      // tolleranza bussola ↔ heading salvato
+
+struct EunoFusionCkpt {
+  float   gyroBiasZ;                 // rad/s, assi sensore (CAL=GYRO)
+  float   gyroScale;
+  float   accPitchOffset, accRollOffset;
+  float   ahrsBias[3];               // rad/s, body
+  float   heading;                   // heading fuso
+  float   fusedMinusCompass;         // ° (richiamo COG accumulato)
+  uint8_t gpsLatched;
+  uint8_t pad[3];
+};
+CFG_ASSERT_FITS(CFG_FUSION, EunoFusionCkpt);
+
+static EunoFusionCkpt fusionWarm;            // letto in setup(), usato al primo tick
+static bool           fusionWarmValid = false;
+static bool           fusionWarmUsed  = false;   // heading/latch ripresi (telemetria)
+static float          fusionLastCompass = NAN;   // ultima bussola vista dal tick
+
+static inline bool loadFusionCheckpoint(){
+  fusionWarmValid = cfgLoad(CFG_FUSION, &fusionWarm, sizeof(fusionWarm), FUSION_CKPT_VER) == CFG_LOAD_OK &&
+                    !isnan(fusionWarm.heading) && fusionWarm.gyroScale > 0.5f && fusionWarm.gyroScale < 1.5f;
+  if (fusionWarmValid) {
+    // offset tilt e bias Z servono già prima del primo tick (getTiltAngles)
+    gyroBiasZ_radps = fusionWarm.gyroBiasZ;
+    gyroScale       = fusionWarm.gyroScale;
+    accPitchOffset  = fusionWarm.accPitchOffset;
+    accRollOffset   = fusionWarm.accRollOffset;
+  }
+  return fusionWarmValid;
+}
+
+// Dal primo tick (initSensorFusion), h = bussola di questo istante
+static inline void fusionApplyWarmStart(float h){
+  if (!fusionWarmValid) return;
+  ahrs.warmStart(fusionWarm.ahrsBias[0], fusionWarm.ahrsBias[1], fusionWarm.ahrsBias[2]);
+
+  float predicted = sf_wrap360(h + fusionWarm.fusedMinusCompass);
+  fusionWarmUsed = fabsf(sf_wrap180(predicted - fusionWarm.heading)) < FUSION_WARM_HDG_DEG;
+  if (fusionWarmUsed) {
+    headingGyro = headingExperimental = predicted;
+    gpsLatched = fusionWarm.gpsLatched != 0;
+  }
+  debugLog("Fusion warm start: biasZ=" + String(gyroBiasZ_radps, 5) +
+           (fusionWarmUsed ? " heading " + String(predicted, 1) + (gpsLatched ? " +latch GPS" : "")
+                           : String(" (heading da bussola)")));
+}
+
+static inline void fusionFillCheckpoint(EunoFusionCkpt& c){
+  memset(&c, 0, sizeof(c));
+  c.gyroBiasZ      = gyroBiasZ_radps;
+  c.gyroScale      = gyroScale;
+  c.accPitchOffset = accPitchOffset;
+  c.accRollOffset  = accRollOffset;
+  c.ahrsBias[0] = ahrs.biasX; c.ahrsBias[1] = ahrs.biasY; c.ahrsBias[2] = ahrs.biasZ;
+  c.heading           = headingExperimental;
+  c.fusedMinusCompass = isnan(fusionLastCompass) ? 0.0f : sf_wrap180(headingExperimental - fusionLastCompass);
+  c.gpsLatched        = gpsLatched ? 1 : 0;
+}
+
+static inline bool fusionCkptDiffers(const EunoFusionCkpt& a, const EunoFusionCkpt& b){
+  if (a.gpsLatched != b.gpsLatched) return true;
+  if (fabsf(a.gyroBiasZ - b.gyroBiasZ) > FUSION_CKPT_BIAS_RADPS) return true;
+  for (int i = 0; i < 3; i++)
+    if (fabsf(a.ahrsBias[i] - b.ahrsBias[i]) > FUSION_CKPT_BIAS_RADPS) return true;
+  if (fabsf(a.gyroScale - b.gyroScale) > 1e-3f) return true;
+  if (fabsf(a.accPitchOffset - b.accPitchOffset) > 0.005f || fabsf(a.accRollOffset - b.accRollOffset) > 0.005f) return true;
+  if (fabsf(sf_wrap180(a.heading - b.heading)) > FUSION_CKPT_HDG_DEG) return true;
+  return fabsf(a.fusedMinusCompass - b.fusedMinusCompass) > 1.0f;
+}
+
+// Dal loop: scrive il record (commit raggruppato da euno_config) se lo stato
+// è cambiato, al massimo ogni FUSION_CKPT_MS; force = subito (fine CAL=GYRO)
+static inline bool fusionCheckpointService(unsigned long nowMs, bool force){
+  static EunoFusionCkpt last;
+  static bool           haveLast = false;
+  static unsigned long  lastMs   = 0;
+  if (!fusionInit || !ahrs.ready()) return false;
+  if (!force && haveLast && nowMs - lastMs < FUSION_CKPT_MS) return false;
+  EunoFusionCkpt c;
+  fusionFillCheckpoint(c);
+  if (haveLast && !fusionCkptDiffers(c, last)) { lastMs = nowMs; return false; }
+  cfgStore(CFG_FUSION, &c, sizeof(c), FUSION_CKPT_VER);
+  last = c; haveLast = true; lastMs = nowMs;
+  return true;
+}
+
 // ====== INIZIALIZZAZIONE =============================================
 static inline void initSensorFusion(){
   float h = (float)getCorrectedHeading();
@@ -112,66 +236,163 @@ static inline void initSensorFusion(){
   lastMicrosFusion = micros();
   lastGpsCorr      = millis();
 
-  for (int i=0;i<5;i++) gpsHBuf[i] = h;
-  gpsHIdx    = 0;
   gpsLatched = false;
 
-  debugLog("Fusion init: H=" + String(h));
+  ahrs.reset();
+  ahrsSeedSensorBiasZ(gyroBiasZ_radps);
+  fusionApplyWarmStart(h);
+  {
+    float ax, ay, az, mx, my, mz;
+    if (readAccel(ax, ay, az)) {
+      getCalibratedMag(mx, my, mz);
+      ahrsAlignSensor(ax, ay, az, mx, my, mz);
+    }
+  }
+
+  debugLog("Fusion init: H=" + String(headingGyro));
 }
 
-// ====== CALIBRAZIONE COMPLETA (chiamata dal tuo .ino) ================
-static inline void performSensorFusionCalibration(){
-  // 1) stima bias gyro Z a fermo
-  const int N = 500;
-  double sumZ = 0; int ok = 0;
-  for (int i=0;i<N;i++){
-    float gz; if (readGyroZ_radps(gz)) { sumZ += gz; ok++; }
-    delay(3);
-  }
-  if (ok>0) gyroBiasZ_radps = (float)(sumZ/ok);
-
-  // 2) tilt offset (pitch/roll) — opzionale per debug
-  double sP=0, sR=0; ok=0;
-  for (int i=0;i<N;i++){
-    float ax,ay,az; if (readAccel(ax,ay,az)){
-      float pitch = atan2f(-ax, sqrtf(ay*ay + az*az));
-      float roll  = atan2f(ay, az);
-      sP += pitch; sR += roll; ok++;
-    }
-    delay(3);
+// ====== CALIBRAZIONE GYRO/TILT INCREMENTALE ==========================
+// Prima: 2×500 campioni con delay(3) → ~3 s di firmware bloccato.
+// Ora: startSensorFusionCalibration() arma la richiesta, il tick fusion
+// (100 Hz) accumula un campione gyro+accel per volta (Welford) e a fine
+// finestra applica bias Z e offset pitch/roll. Se la barca si muove
+// (campione fuori soglia o deviazione standard troppo alta) la prova è
+// scartata e i valori precedenti restano.
+#define FCAL_SAMPLES        500      // 5 s @100 Hz
+#define FCAL_GZ_SPIKE_RADPS 0.05f    // ~3 °/s dal valor medio → movimento
+#define FCAL_GZ_STD_RADPS   0.01f    // ~0.6 °/s
+#define FCAL_ACC_STD_MS2    0.25f
+
+enum FusionCalState : uint8_t { FCAL_IDLE = 0, FCAL_RUN, FCAL_DONE, FCAL_FAILED };
+
+static volatile bool           fusionCalRequest = false;   // da loop()/UI
+static volatile FusionCalState fusionCalState   = FCAL_IDLE;
+static volatile int            fusionCalCount   = 0;
+static volatile bool           fusionCalStill   = true;    // ultimo campione fermo
+
+struct SfWelford {
+  uint32_t n = 0; double mean = 0, m2 = 0;
+  void add(double x){ n++; double d = x - mean; mean += d / n; m2 += d * (x - mean); }
+  float std() const { return n > 1 ? (float)sqrt(m2 / (n - 1)) : 0.0f; }
+};
+static SfWelford fcalGz, fcalPitch, fcalRoll, fcalAcc;
+
+static inline void startSensorFusionCalibration(){
+  fusionCalRequest = true;
+}
+
+static inline bool isSensorFusionCalibrating(){
+  return fusionCalRequest || fusionCalState == FCAL_RUN;
+}
+
+// Avanzamento 0..100 (%)
+static inline int getSensorFusionCalProgress(){
+  return (int)(100L * fusionCalCount / FCAL_SAMPLES);
+}
+
+static inline void sfCalFail(const char* why){
+  fusionCalState = FCAL_FAILED;
+  debugLog(String("CAL FUSION: scartata (") + why + "), n=" + String((int)fusionCalCount));
+}
+
+// Un campione per tick fusion (gz in rad/s, NAN se lettura fallita)
+static inline void stepSensorFusionCalibration(float gz){
+  if (fusionCalRequest){
+    fusionCalRequest = false;
+    fcalGz = SfWelford(); fcalPitch = SfWelford(); fcalRoll = SfWelford(); fcalAcc = SfWelford();
+    fusionCalCount = 0;
+    fusionCalStill = true;
+    fusionCalState = FCAL_RUN;
+    debugLog("CAL FUSION: avvio (" + String(FCAL_SAMPLES) + " campioni)");
   }
-  if (ok>0){ accPitchOffset = (float)(sP/ok); accRollOffset = (float)(sR/ok); }
+  if (fusionCalState != FCAL_RUN) return;
+
+  float ax, ay, az;
+  if (isnan(gz) || !readAccel(ax, ay, az)) return;
+
+  bool still = !(fcalGz.n > 50 && fabsf(gz - (float)fcalGz.mean) > FCAL_GZ_SPIKE_RADPS);
+  fusionCalStill = still;
+  if (!still){ sfCalFail("movimento"); return; }
+
+  fcalGz.add(gz);
+  fcalPitch.add(fm_atan2(-ax, sqrtf(ay*ay + az*az)));
+  fcalRoll.add(fm_atan2(ay, az));
+  fcalAcc.add(sqrtf(ax*ax + ay*ay + az*az));
+  fusionCalCount = fcalGz.n;
+  if (fusionCalCount < FCAL_SAMPLES) return;
+
+  if (fcalGz.std() > FCAL_GZ_STD_RADPS)  { sfCalFail("gyro std");  return; }
+  if (fcalAcc.std() > FCAL_ACC_STD_MS2)  { sfCalFail("accel std"); return; }
+
+  gyroBiasZ_radps = (float)fcalGz.mean;
+  accPitchOffset  = (float)fcalPitch.mean;
+  accRollOffset   = (float)fcalRoll.mean;
 
   // riallineo al valore bussola
   float h = (float)getCorrectedHeading();
   headingGyro = headingExperimental = h;
+  ahrsSeedSensorBiasZ(gyroBiasZ_radps);
+  fusionCalState = FCAL_DONE;
 
   debugLog("CAL FUSION: biasZ=" + String(gyroBiasZ_radps,6) +
            " pitchOff=" + String(accPitchOffset,3) +
-           " rollOff="  + String(accRollOffset,3));
+           " rollOff="  + String(accRollOffset,3) +
+           " gzStd="    + String(fcalGz.std(),5));
 }
 
-// ====== UPDATE FUSION (100 Hz) =======================================
+// ====== UPDATE FUSION (100 Hz, task di controllo) ====================
 static inline void updateSensorFusion(){
   if (!fusionInit){ initSensorFusion(); return; }
+  ICMLock guard(compass);
 
-  uint32_t now = micros();
+  // un solo burst I2C per tick: gyro, bussola e tilt leggono questo istante
+  compass.sample();
+  ICMSnapshot snap = compass.snapshot();
+  uint32_t now = snap.tUs;
   float dt = (now - lastMicrosFusion) / 1e6f;
   lastMicrosFusion = now;
   if (dt <= 0.0f || dt > 0.2f) dt = 1.0f / FUSION_HZ;
 
-  // 1) integrazione gyro Z
-  float gz;
-  if (readGyroZ_radps(gz)){
+  // campo magnetico calibrato di questo tick (l'AK09916 va a 100 Hz)
+  float mx, my, mz;
+  getCalibratedMag(mx, my, mz);
+
+  // 1) integrazione gyro Z: ogni campione FIFO col suo dt, altrimenti snapshot.
+  //    Lo stesso campione avanza l'AHRS sui tre assi.
+  float gz = NAN;
+  EunoImuSample smp;
+  int nFifo = 0;
+  while (imuRing.pop(smp)){
+    float dts = (smp.tUs - lastGyroSampleUs) / 1e6f;
+    if (nFifo == 0 && (lastGyroSampleUs == 0 || dts <= 0.0f || dts > 0.1f))
+      dts = 1.0f / compass.fifoRateHz();
+    lastGyroSampleUs = smp.tUs;
+    float rate_degps = (smp.gz - gyroBiasZ_radps) * 180.0f / (float)M_PI * gyroScale;
+    headingGyro = sf_wrap360(headingGyro + rate_degps * dts);
+    rateOfTurnDegps = rate_degps;
+    gz = smp.gz;
+    ahrsUpdateSensor(smp.gx, smp.gy, smp.gz, smp.ax, smp.ay, smp.az, mx, my, mz, dts);
+    nFifo++;
+  }
+  // con FIFO attiva il tempo è già coperto dai campioni: niente doppia integrazione
+  if (nFifo == 0 && !compass.fifoActive() && readGyroZ_radps(gz)){
     float rate_degps = (gz - gyroBiasZ_radps) * 180.0f / (float)M_PI;
     rate_degps *= gyroScale;
+    rateOfTurnDegps = rate_degps;
     headingGyro = sf_wrap360(headingGyro + rate_degps * dt);
+    if (snap.valid)
+      ahrsUpdateSensor(snap.gx, snap.gy, snap.gz, snap.ax, snap.ay, snap.az, mx, my, mz, dt);
   }
+  stepSensorFusionCalibration(gz);
 
   // 2) bussola tilt-compensata (già dalla tua pipeline)
   float hCompass = (float)getCorrectedHeading();
+  fusionLastCompass = hCompass;
 
   // 3) alpha dinamico con velocità e booster in accostata
+  EunoGpsMotion motion = gpsMotionStep(millis());
+  smoothedSpeed = motion.valid ? motion.sogKn : 0.0f;
   float v = smoothedSpeed; // nodi
   float wVel = 0.0f;
   if (v <= VEL_MIN_KN) wVel = 0.0f;
@@ -190,29 +411,27 @@ static inline void updateSensorFusion(){
   // 5) EXPERIMENTAL = heading fuso
   headingExperimental = headingGyro;
 
-  // 6) richiamo lento a COG ogni 10s se >2 kn
-  if (gps.speed.isValid() && gps.course.isValid() && gps.speed.knots() > 2.0f){
-    float cog = gps.course.deg();
+  // 6) richiamo lento al COG filtrato ogni 10s se >2 kn; gate e guadagno
+  //    dall'accuratezza dell'ultimo fix (NAV-PVT)
+  float cogSigma = sf_cogSigmaDeg(gpsFixGet());
+  if (motion.cogValid && motion.sogKn > 2.0f && !(cogSigma > GPS_COG_ACC_MAX)){   // NAN (NMEA) passa
+    float cog = motion.cogDeg;
 
     if (!gpsLatched){
       headingGyro = sf_wrap360(cog);
       headingExperimental = headingGyro;
-      for (int i=0;i<5;i++) gpsHBuf[i] = cog;
-      gpsHIdx=0; gpsLatched=true; lastGpsCorr=millis();
+      gpsLatched=true; lastGpsCorr=millis();
       debugLog("Fusion latch to GPS COG: " + String(cog));
     } else {
-      gpsHBuf[gpsHIdx] = cog;
-      gpsHIdx = (gpsHIdx + 1) % 5;
-      float sum=0; for (int i=0;i<5;i++) sum += gpsHBuf[i];
-      float cogAvg = sum / 5.0f;
-
       uint32_t ms = millis();
       if (ms - lastGpsCorr >= GPS_CORR_MS){
-        float d = sf_angDiff(cogAvg, headingGyro);
-        headingGyro = sf_wrap360(headingGyro + GPS_CORR_GAIN * d);
+        float d = sf_angDiff(cog, headingGyro);
+        float k = isnan(cogSigma) ? GPS_CORR_GAIN
+                : GPS_CORR_GAIN_MAX / (1.0f + (cogSigma * cogSigma) / (GPS_COG_ACC_REF * GPS_COG_ACC_REF));
+        headingGyro = sf_wrap360(headingGyro + k * d);
         headingExperimental = headingGyro;
         lastGpsCorr = ms;
-        debugLog("Fusion GPS slow corr: d=" + String(d) + " → " + String(headingGyro));
+        debugLog("Fusion GPS slow corr: d=" + String(d) + " k=" + String(k, 3) + " → " + String(headingGyro));
       }
     }
   }
@@ -238,6 +457,17 @@ static inline float getGyroOnlyHeading(){
   return headingGyro;
 }
 
+// Heading dall'AHRS (MODE 4), con offset C-GPS e curva di deviazione come la bussola
+static inline float getAhrsHeading(){
+  if (!fusionInit) initSensorFusion();
+  float h = ahrs.headingDeg();
+  return sf_wrap360(h + (float)headingOffset + devCorrectionDeg(h));
+}
+
+static inline float getRateOfTurn(){
+  return rateOfTurnDegps;
+}
+
 static inline void setGyroBiasZ_radps(float b){ gyroBiasZ_radps = b; }
 static inline void setGyroScale(float s){ gyroScale = s; }
 
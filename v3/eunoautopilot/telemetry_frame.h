@@ -0,0 +1,113 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// telemetry_frame.h — righe di telemetria in un buffer fisso, senza heap
+//
+// La riga $AUTOPILOT (~400 byte, 40+ campi) costruita a String voleva dire
+// decine di allocazioni a ogni invio, più le copie per WS/UDP/Serial: heap
+// frammentato su un apparecchio che resta acceso per settimane.
+// EunoFrame scrive in un char[] statico: interi e decimali a virgola fissa
+// convertiti a mano (stesso testo di String(v) e String(v, dec)), niente
+// printf. finish() chiude con il checksum NMEA "*XX" (XOR tra '$' e '*').
+// Una riga troppo lunga non viene troncata a metà campo: finish() → false.
+//
+// I campi stanno in una tabella { chiave, funzione } (EunoTelemField): la
+// funzione scrive solo il valore, leggendo uno snapshot preso una volta per
+// tick (Ctx), così l'ordine della riga è quello della tabella.
+
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define TELEM_FRAME_MAX 768       // $AUTOPILOT completa ≈ 450 byte
+
+struct EunoFrame {
+  char   buf[TELEM_FRAME_MAX];
+  size_t len = 0;
+  bool   ovf = false;
+
+  void begin(const char* head){ len = 0; ovf = false; buf[0] = 0; puts(head); }
+
+  void put(char c){
+    if (len + 1 >= sizeof(buf)) { ovf = true; return; }
+    buf[len++] = c;
+    buf[len] = 0;
+  }
+
+  void puts(const char* s){ while (*s) put(*s++); }
+
+  void putU(uint64_t v){
+    char tmp[20];
+    int n = 0;
+    do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+    while (n) put(tmp[--n]);
+  }
+
+  void putInt(long v){
+    if (v < 0) { put('-'); putU((uint64_t)(-(int64_t)v)); }
+    else putU((uint64_t)v);
+  }
+
+  // Come String(v, dec): arrotondamento all'ultima cifra, "nan"/"inf"/"ovf"
+  void putFixed(float v, uint8_t dec){
+    if (isnan(v)) { puts("nan"); return; }
+    if (isinf(v)) { puts("inf"); return; }
+    if (fabsf(v) > 4294967040.0f) { puts("ovf"); return; }
+    if (dec > 6) dec = 6;
+    uint64_t p = 1;
+    for (uint8_t i = 0; i < dec; i++) p *= 10;
+    if (v < 0.0f) { put('-'); v = -v; }
+    uint64_t x = (uint64_t)((double)v * (double)p + 0.5);
+    putU(x / p);
+    if (!dec) return;
+    put('.');
+    uint64_t f = x % p;
+    for (uint64_t q = p / 10; q; q /= 10) { put((char)('0' + f / q)); f %= q; }
+  }
+
+  void na(){ puts("N/A"); }
+
+  // ",KEY="
+  void key(const char* k){ put(','); puts(k); put('='); }
+
+  // "*XX": false se la riga non ci sta (da non inviare)
+  bool finish(){
+    static const char hex[] = "0123456789ABCDEF";
+    uint8_t x = 0;
+    for (size_t i = (buf[0] == '$' ? 1 : 0); i < len; i++) x ^= (uint8_t)buf[i];
+    put('*');
+    put(hex[x >> 4]);
+    put(hex[x & 0x0F]);
+    return !ovf;
+  }
+
+  const char* c_str() const { return buf; }
+};
+
+template <typename Ctx>
+struct EunoTelemField {
+  const char* key;
+  void (*put)(EunoFrame& f, const Ctx& c);
+};
+
+// head + ",KEY=valore" per ogni campo della tabella + checksum
+template <typename Ctx, size_t N>
+static inline bool telemBuild(EunoFrame& f, const char* head,
+                              const EunoTelemField<Ctx> (&tab)[N], const Ctx& c){
+  f.begin(head);
+  for (size_t i = 0; i < N; i++) {
+    f.key(tab[i].key);
+    tab[i].put(f, c);
+  }
+  return f.finish();
+}
+
+#endif // TELEMETRY_FRAME_H
@@ -0,0 +1,172 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// track_mode.h — modo TRACK: seguire la traccia del plotter, non solo il bearing
+//
+// Dal plotter (OpenCPN, chartplotter) arrivano $--RMB e/o $--APB:
+//   RMB: status, XTE, L/R, origine, destinazione, lat/lon, range, bearing
+//        alla destinazione (BTW, vero), velocità, arrivo
+//   APB: status, status, XTE, L/R, unità, arrivo (cerchio), perpendicolare,
+//        bearing origine→destinazione (BOD), M/T, destinazione, BTW, M/T,
+//        heading to steer (HTS), M/T
+// Puntare al BTW con corrente al traverso porta fuori traccia e la riprende
+// solo a ridosso del waypoint. Qui il comando è
+//   cmd = rotta base + Kp·XTE + Ki·∫XTE dt        (limitati, vedi TRK_*)
+// con rotta base = BOD (APB) oppure BTW (solo RMB). Il termine integrale è
+// l'angolo di deriva che serve a restare in traccia. Si azzera al cambio di
+// waypoint, all'arrivo e dopo TRK_STALE_MS senza frasi; se il plotter manda
+// sia APB sia RMB vale APB (ha il BOD).
+// Il comando si ricalcola a ogni frase, cioè al ritmo del plotter.
+// Rotte M usate come sono (senza declinazione a bordo): l'heading EUNO è
+// allineato al COG (vero) con C-GPS, quindi il plotter va impostato in T.
+// Parsing sul buffer della riga (nmea_fields.h, niente String), checksum
+// verificato se c'è.
+
+#ifndef TRACK_MODE_H
+#define TRACK_MODE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "nmea_fields.h"
+
+#define TRK_KP_DEG_NM   300.0f    // 0.05 nm (≈90 m) fuori traccia → 15°
+#define TRK_KI_DEG_NMS  2.0f      // 0.05 nm costanti → +0.1°/s
+#define TRK_I_MAX_DEG   20.0f     // deriva massima compensata
+#define TRK_MAX_CORR    30.0f     // angolo massimo di rientro sulla traccia
+#define TRK_STALE_MS    5000UL    // oltre: integrale azzerato alla prossima frase
+#define TRK_APB_PREF_MS 3000UL    // RMB ignorata se c'è APB recente
+#define TRK_MAX_DT_S    2.0f
+
+enum EunoNavSource : uint8_t { NAV_SRC_NONE = 0, NAV_SRC_RMB, NAV_SRC_APB, NAV_SRC_ROUTE };
+
+struct EunoNavTarget {
+  uint32_t ms       = 0;
+  uint8_t  src      = NAV_SRC_NONE;
+  bool     valid    = false;      // status A
+  bool     arrived  = false;      // cerchio d'arrivo
+  bool     hasXte   = false;
+  float    xteNm    = 0.0f;       // + = governare a dritta per rientrare
+  float    bodDeg   = NAN;        // origine → destinazione (APB)
+  float    btwDeg   = NAN;        // posizione → destinazione
+  float    htsDeg   = NAN;        // heading to steer del plotter (APB)
+  char     dest[8]  = "";
+};
+
+static inline float trk_wrap360(float a){
+  a = fmodf(a, 360.0f);
+  return a < 0.0f ? a + 360.0f : a;
+}
+
+static inline float trk_bearing(float v){
+  return (isnan(v) || v < 0.0f || v > 360.0f) ? NAN : trk_wrap360(v);
+}
+
+static inline void trk_copyDest(const char* s, int n, char* dest){
+  const char* b; int len;
+  dest[0] = 0;
+  if (!nmeaFieldSpan(s, n, b, len) || len <= 0) return;
+  if (len > 7) len = 7;
+  memcpy(dest, b, len); dest[len] = 0;
+}
+
+static inline void trk_setXte(EunoNavTarget& t, float mag, char dir, float scale){
+  if (isnan(mag) || (dir != 'L' && dir != 'R')) return;
+  t.hasXte = true;
+  t.xteNm  = (dir == 'R' ? 1.0f : -1.0f) * fabsf(mag) * scale;
+}
+
+// $--RMB → target; false se non è RMB o il checksum non torna
+static inline bool navParseRmb(const char* s, uint32_t now, EunoNavTarget& t){
+  if (!nmeaIsType(s, "RMB") || !nmeaChecksumOk(s)) return false;
+  t = EunoNavTarget();
+  t.ms      = now ? now : 1;
+  t.src     = NAV_SRC_RMB;
+  t.valid   = nmeaFieldChar(s, 1) == 'A';
+  trk_setXte(t, nmeaFieldFloat(s, 2), nmeaFieldChar(s, 3), 1.0f);
+  trk_copyDest(s, 5, t.dest);
+  t.btwDeg  = trk_bearing(nmeaFieldFloat(s, 11));
+  t.arrived = nmeaFieldChar(s, 13) == 'A';
+  return true;
+}
+
+// $--APB → target; XTE in km (unità K) convertito in nm
+static inline bool navParseApb(const char* s, uint32_t now, EunoNavTarget& t){
+  if (!nmeaIsType(s, "APB") || !nmeaChecksumOk(s)) return false;
+  t = EunoNavTarget();
+  t.ms      = now ? now : 1;
+  t.src     = NAV_SRC_APB;
+  t.valid   = nmeaFieldChar(s, 1) == 'A';
+  trk_setXte(t, nmeaFieldFloat(s, 3), nmeaFieldChar(s, 4),
+             nmeaFieldChar(s, 5) == 'K' ? 1.0f / 1.852f : 1.0f);
+  t.arrived = nmeaFieldChar(s, 6) == 'A';
+  t.bodDeg  = trk_bearing(nmeaFieldFloat(s, 8));
+  trk_copyDest(s, 10, t.dest);
+  t.btwDeg  = trk_bearing(nmeaFieldFloat(s, 11));
+  t.htsDeg  = trk_bearing(nmeaFieldFloat(s, 13));
+  return true;
+}
+
+// Bearing per il modo "bearing esterno" (senza traccia): HTS, altrimenti BTW
+static inline float navPlainBearing(const EunoNavTarget& t){
+  return !isnan(t.htsDeg) ? t.htsDeg : t.btwDeg;
+}
+
+struct EunoTrackCtl {
+  float    integDeg = 0.0f;   // termine integrale (°)
+  float    corrDeg  = 0.0f;   // ultima correzione applicata (telemetria)
+  float    xteNm    = NAN;    // ultimo XTE usato (telemetria)
+  uint32_t lastMs   = 0;
+  uint32_t apbMs    = 0;
+  char     dest[8]  = "";
+
+  void reset(){ integDeg = corrDeg = 0.0f; xteNm = NAN; lastMs = 0; dest[0] = 0; }
+
+  // Nuova frase: true e cmd se c'è un comando da applicare
+  bool step(const EunoNavTarget& t, float& cmd){
+    if (t.src == NAV_SRC_APB) apbMs = t.ms;
+    else if (t.src == NAV_SRC_RMB && apbMs && t.ms - apbMs < TRK_APB_PREF_MS) return false;
+    if (!t.valid) return false;
+
+    float base = !isnan(t.bodDeg) ? t.bodDeg : t.btwDeg;
+    if (isnan(base)) return false;
+
+    bool fresh = lastMs && t.ms - lastMs <= TRK_STALE_MS;
+    if (!fresh || strcmp(dest, t.dest) != 0) {
+      integDeg = 0.0f;
+      strcpy(dest, t.dest);
+    }
+    float dt = fresh ? (float)(t.ms - lastMs) * 1e-3f : 0.0f;
+    if (dt > TRK_MAX_DT_S) dt = TRK_MAX_DT_S;
+    lastMs = t.ms;
+
+    if (t.arrived || !t.hasXte) {           // all'arrivo: dritti al waypoint
+      integDeg = corrDeg = 0.0f;
+      xteNm = t.hasXte ? t.xteNm : NAN;
+      cmd = isnan(t.btwDeg) ? base : t.btwDeg;
+      return true;
+    }
+
+    xteNm = t.xteNm;
+    float p = TRK_KP_DEG_NM * t.xteNm;
+    float u = p + integDeg;
+    // anti-windup: niente integrazione se già saturi nello stesso verso
+    if (!(fabsf(u) >= TRK_MAX_CORR && (u > 0.0f) == (t.xteNm > 0.0f))) {
+      integDeg += TRK_KI_DEG_NMS * t.xteNm * dt;
+      if (integDeg >  TRK_I_MAX_DEG) integDeg =  TRK_I_MAX_DEG;
+      if (integDeg < -TRK_I_MAX_DEG) integDeg = -TRK_I_MAX_DEG;
+      u = p + integDeg;
+    }
+    if (u >  TRK_MAX_CORR) u =  TRK_MAX_CORR;
+    if (u < -TRK_MAX_CORR) u = -TRK_MAX_CORR;
+    corrDeg = u;
+    cmd = trk_wrap360(base + u);
+    return true;
+  }
+};
+
+#endif // TRACK_MODE_H
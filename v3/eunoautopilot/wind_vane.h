@@ -0,0 +1,163 @@
+/*
+  EUNO Autopilot – © 2025 Yari Gabbai
+
+  Licensed under CC BY-NC 4.0:
+  Creative Commons Attribution-NonCommercial 4.0 International
+*/
+
+// wind_vane.h — modo WIND: governare a un angolo di vento apparente (AWA)
+//
+// Ingresso: $--MWV (angolo 0..360 dalla prua, R = apparente) o $--VWR
+// (0..180 con lato L/R), 5–10 Hz da UDP/WS. Parsing in un passaggio sul
+// buffer della riga (EunoNmeaCursor), senza String: niente heap a questo ritmo.
+// AWA con segno: + = vento a dritta, − = a sinistra.
+//
+// Filtro: non sull'AWA ma sulla direzione del vento apparente riferita al
+// nord, heading + AWA, come vettore unitario (circolare) con costante di
+// tempo WIND_TAU_S. Così il filtro non vede le accostate della barca e il
+// suo ritardo non entra nell'anello; AWA filtrato = direzione − heading.
+// Raffiche: un campione a più di WIND_GUST_DEG dal filtrato è scartato, a
+// meno che lo scarto duri WIND_GUST_PERSIST campioni di fila (salto vero).
+//
+// Anello esterno: comando = direzione filtrata − AWA obiettivo, a ogni
+// campione, in headingCommand; l'anello interno resta il controllore di
+// rotta (3 stati o PID) con lo stesso attuatore. Senza vento da
+// WIND_STALE_MS il comando resta fermo sull'ultimo valore.
+
+#ifndef WIND_VANE_H
+#define WIND_VANE_H
+
+#include <math.h>
+#include <stdint.h>
+#include "nmea_fields.h"
+
+#define WIND_TAU_S          2.0f      // costante di tempo del filtro direzione
+#define WIND_SPD_TAU_S      3.0f
+#define WIND_GUST_DEG       25.0f     // scarto oltre cui il campione è raffica
+#define WIND_GUST_PERSIST   5         // ...a meno che duri (≈0.5–1 s a 5–10 Hz)
+#define WIND_STALE_MS       3000UL
+#define WIND_MIN_KN         2.0f      // sotto, l'angolo non è affidabile
+#define WIND_AWA_MIN_DEG    15.0f     // obiettivo più stretto ammesso (|AWA|)
+#define WIND_MAX_DT_S       1.0f
+
+static inline float wind_wrap180(float a){
+  a = fmodf(a + 180.0f, 360.0f);
+  if (a < 0.0f) a += 360.0f;
+  return a - 180.0f;
+}
+
+static inline float wind_wrap360(float a){
+  a = fmodf(a, 360.0f);
+  return a < 0.0f ? a + 360.0f : a;
+}
+
+struct EunoWindObs {
+  uint32_t ms     = 0;
+  float    awaDeg = NAN;    // + = dritta
+  float    awsKn  = NAN;
+};
+
+// Velocità → nodi per unità NMEA (N, M = m/s, K = km/h, S = mph)
+static inline float wind_toKn(float v, char unit){
+  switch (unit) {
+    case 'N': return v;
+    case 'M': return v * 1.943844f;
+    case 'K': return v * 0.539957f;
+    case 'S': return v * 0.868976f;
+    default:  return NAN;
+  }
+}
+
+// $--MWV,<ang>,R,<vel>,<unità>,A → true se è vento apparente valido
+static inline bool windParseMwv(const char* s, uint32_t now, EunoWindObs& w){
+  if (!nmeaIsType(s, "MWV") || !nmeaChecksumOk(s)) return false;
+  EunoNmeaCursor c(s);
+  float ang = NAN, spd = NAN;
+  char  ref = 0, unit = 0, st = 0;
+  if (c.next()) ang  = c.num();
+  if (c.next()) ref  = c.ch();
+  if (c.next()) spd  = c.num();
+  if (c.next()) unit = c.ch();
+  if (c.next()) st   = c.ch();
+  if (ref != 'R' || st != 'A' || isnan(ang) || ang < 0.0f || ang > 360.0f) return false;
+  w.ms     = now ? now : 1;
+  w.awaDeg = wind_wrap180(ang);
+  w.awsKn  = isnan(spd) ? NAN : wind_toKn(spd, unit);
+  return true;
+}
+
+// $--VWR,<ang>,L|R,<kn>,N,<m/s>,M,<km/h>,K
+static inline bool windParseVwr(const char* s, uint32_t now, EunoWindObs& w){
+  if (!nmeaIsType(s, "VWR") || !nmeaChecksumOk(s)) return false;
+  EunoNmeaCursor c(s);
+  float ang = NAN, spd = NAN;
+  char  side = 0;
+  if (c.next()) ang  = c.num();
+  if (c.next()) side = c.ch();
+  if (c.next()) {
+    float v = c.num();
+    if (c.next() && !isnan(v)) spd = wind_toKn(v, c.ch());
+  }
+  if (isnan(ang) || ang < 0.0f || ang > 180.0f || (side != 'L' && side != 'R')) return false;
+  w.ms     = now ? now : 1;
+  w.awaDeg = side == 'L' ? -ang : ang;
+  w.awsKn  = spd;
+  return true;
+}
+
+struct EunoWindVane {
+  float    dirS = 0.0f, dirC = 0.0f;  // direzione apparente (nord) come vettore
+  float    awsKn = NAN;
+  bool     init = false;
+  uint32_t lastMs = 0;
+  uint8_t  gustRun = 0;
+  uint32_t samples = 0, gusts = 0;
+
+  void reset(){ init = false; gustRun = 0; awsKn = NAN; }
+
+  bool valid(uint32_t now) const { return init && now - lastMs <= WIND_STALE_MS; }
+
+  // direzione filtrata del vento apparente riferita al nord (0..360)
+  float dirDeg() const { return wind_wrap360(atan2f(dirS, dirC) * 180.0f / (float)M_PI); }
+
+  float awaDeg(float headingDeg) const { return wind_wrap180(dirDeg() - headingDeg); }
+
+  // campione + heading al momento della ricezione; false = scartato (raffica)
+  bool update(const EunoWindObs& w, float headingDeg){
+    float d  = wind_wrap360(headingDeg + w.awaDeg);
+    float dr = d * (float)M_PI / 180.0f;
+    if (!init || w.ms - lastMs > WIND_STALE_MS) {
+      dirS = sinf(dr); dirC = cosf(dr);
+      awsKn = w.awsKn;
+      init = true; lastMs = w.ms; gustRun = 0; samples++;
+      return true;
+    }
+    float dt = (float)(w.ms - lastMs) * 1e-3f;
+    if (dt > WIND_MAX_DT_S) dt = WIND_MAX_DT_S;
+
+    // raffica isolata: scartata; scarto che persiste: accettato finché non
+    // rientra nel gate (il filtro lo insegue)
+    if (fabsf(wind_wrap180(d - dirDeg())) > WIND_GUST_DEG) {
+      if (gustRun < WIND_GUST_PERSIST) gustRun++;
+      if (gustRun < WIND_GUST_PERSIST) { gusts++; return false; }
+    } else {
+      gustRun = 0;
+    }
+    lastMs = w.ms;
+    samples++;
+
+    float k = dt / (WIND_TAU_S + dt);
+    dirS += k * (sinf(dr) - dirS);
+    dirC += k * (cosf(dr) - dirC);
+    if (!isnan(w.awsKn)) {
+      if (isnan(awsKn)) awsKn = w.awsKn;
+      else awsKn += dt / (WIND_SPD_TAU_S + dt) * (w.awsKn - awsKn);
+    }
+    return true;
+  }
+
+  // rotta per tenere targetAwa (con segno)
+  float command(float targetAwa) const { return wind_wrap360(dirDeg() - targetAwa); }
+};
+
+#endif // WIND_VANE_H
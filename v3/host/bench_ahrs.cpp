@@ -0,0 +1,145 @@
+// bench_ahrs.cpp — costo e accuratezza di sensor_ahrs.h (MODE 4)
+//
+//   bench_ahrs [minuti] [sbandamento°] [rollio°]
+//
+// 1) ns per EunoAhrs::update() e per un tick fusion completo (burst mock,
+//    bussola, fusion Z e AHRS), da confrontare col budget di 10 ms @100 Hz.
+// 2) Barca su rotta che oscilla (±30° in 2 min) con sbandamento medio, rollio
+//    e beccheggio d'onda, accelerazione verticale d'onda, accelerazioni del
+//    modulo montato sopra l'asse di rollio, bias sui tre assi gyro e rumore:
+//    IMU mock generata dall'assetto vero, tick fusion @100 Hz.
+//    Stampa RMS/max dell'errore di heading di COMPASS, FUSION e AHRS e la
+//    stima del bias Z.
+
+#include "euno_core.h"
+#include "sensor_ahrs.h"
+
+#include <chrono>
+#include <random>
+
+using bclock = std::chrono::steady_clock;
+
+static volatile float sink;
+
+struct ErrStat {
+  double s2 = 0.0, mx = 0.0; uint64_t n = 0;
+  void add(double e){ s2 += e * e; if (fabs(e) > mx) mx = fabs(e); n++; }
+  double rms() const { return n ? sqrt(s2 / (double)n) : 0.0; }
+};
+
+static const double SENSOR_H_M = 1.5;   // altezza del modulo sull'asse di rollio
+
+static double wrap180(double a){ a = fmod(a + 180.0, 360.0); if (a < 0) a += 360.0; return a - 180.0; }
+
+// Assetto vero (NED, body prua/dritta/giù) → IMU mock negli assi del sensore
+// (sinistra, prua, alto), la convenzione di getCorrectedHeading() e del sim
+static void setImuFromAttitude(double psi, double th, double ph,
+                               double psiD, double thD, double phD, double phDD,
+                               double heaveAcc, const float bias[3],
+                               std::mt19937& rng){
+  std::normal_distribution<float> nG(0.0f, 0.002f), nA(0.0f, 0.05f), nM(0.0f, 0.3f);
+  double cps = cos(psi), sps = sin(psi), cth = cos(th), sth = sin(th), cph = cos(ph), sph = sin(ph);
+  // R = Rz(psi)·Ry(th)·Rx(ph), body → NED; v_body = Rᵀ v_ned
+  double R[3][3] = {
+    { cps*cth, cps*sth*sph - sps*cph, cps*sth*cph + sps*sph },
+    { sps*cth, sps*sth*sph + cps*cph, sps*sth*cph - cps*sph },
+    { -sth,    cth*sph,               cth*cph               } };
+  auto toBody = [&](const double v[3], double b[3]){
+    for (int i = 0; i < 3; i++) b[i] = R[0][i]*v[0] + R[1][i]*v[1] + R[2][i]*v[2];
+  };
+  const double fN[3] = { 0.0, 0.0, -9.80665 + heaveAcc };   // forza specifica
+  const double mN[3] = { 25.0, 0.0, 40.0 };                  // µT, inclinazione ~58°
+  double f[3], m[3];
+  toBody(fN, f); toBody(mN, m);
+  // sensore SENSOR_H_M sopra l'asse di rollio: tangenziale + centripeta
+  f[1] += SENSOR_H_M * phDD;
+  f[2] += SENSOR_H_M * phD * phD;
+  double p = phD - psiD * sth;
+  double q = thD * cph + psiD * sph * cth;
+  double r = -thD * sph + psiD * cph * cth;
+
+  euno_mock_imu.ax = (float)-f[1] + nA(rng); euno_mock_imu.ay = (float)f[0] + nA(rng); euno_mock_imu.az = (float)-f[2] + nA(rng);
+  euno_mock_imu.mx = (float)-m[1] + nM(rng); euno_mock_imu.my = (float)m[0] + nM(rng); euno_mock_imu.mz = (float)-m[2] + nM(rng);
+  euno_mock_imu.gx = (float)q  + bias[0] + nG(rng);
+  euno_mock_imu.gy = (float)-p + bias[1] + nG(rng);
+  euno_mock_imu.gz = (float)r  + bias[2] + nG(rng);
+}
+
+int main(int argc, char** argv){
+  double minutes = (argc > 1) ? atof(argv[1]) : 20.0;
+  double heelDeg = (argc > 2) ? atof(argv[2]) : 15.0;
+  double rollDeg = (argc > 3) ? atof(argv[3]) : 10.0;
+  const double D2R = M_PI / 180.0;
+
+  // ---- costo ----------------------------------------------------------
+  {
+    EunoAhrs f;
+    const size_t n = 5000000;
+    auto t0 = bclock::now();
+    for (size_t i = 0; i < n; i++){
+      float k = (float)(i & 1023) * 1e-3f;
+      f.update(0.01f + k * 0.01f, -0.02f, 0.05f, 0.3f, -0.5f + k, 9.7f, 20.0f, 3.0f + k, -38.0f, 0.01f);
+    }
+    sink = f.q0;
+    double ns = std::chrono::duration<double, std::nano>(bclock::now() - t0).count() / (double)n;
+    printf("EunoAhrs::update(): %.1f ns\n", ns);
+
+    euno_host::reset();
+    euno_mock_imu.ax = 0.3f; euno_mock_imu.ay = -0.5f; euno_mock_imu.az = 9.7f;
+    euno_mock_imu.mx = 12.0f; euno_mock_imu.my = 20.0f; euno_mock_imu.mz = -40.0f;
+    euno_host::fusionInit();
+    const size_t nt = 500000;
+    t0 = bclock::now();
+    for (size_t i = 0; i < nt; i++){ euno_host::advanceUs(10000); euno_host::fusionUpdate(); }
+    ns = std::chrono::duration<double, std::nano>(bclock::now() - t0).count() / (double)nt;
+    printf("tick fusion completo (updateSensorFusion): %.1f ns\n", ns);
+  }
+
+  // ---- accuratezza in mare formato ------------------------------------
+  euno_host::reset();
+  std::mt19937 rng(7);
+  const float bias[3] = { 0.010f, -0.008f, 0.015f };   // rad/s (~0.9 °/s su Z)
+  const double dt = 0.01;
+  const uint64_t steps = (uint64_t)(minutes * 60.0 / dt);
+
+  auto attitude = [&](double t, double& psi, double& th, double& ph, double& psiD, double& thD, double& phD,
+                      double& phDD, double& heave){
+    const double wPsi = 2.0 * M_PI / 120.0, wPh = 2.0 * M_PI / 7.0, wTh = 2.0 * M_PI / 5.0, wH = 2.0 * M_PI / 6.0;
+    psi  = (90.0 + 30.0 * sin(wPsi * t)) * D2R;         psiD = 30.0 * wPsi * cos(wPsi * t) * D2R;
+    ph   = (heelDeg + rollDeg * sin(wPh * t)) * D2R;     phD  = rollDeg * wPh * cos(wPh * t) * D2R;
+    phDD = -rollDeg * wPh * wPh * sin(wPh * t) * D2R;
+    th   = (4.0 * sin(wTh * t + 1.0)) * D2R;             thD  = 4.0 * wTh * cos(wTh * t + 1.0) * D2R;
+    heave = 1.0 * sin(wH * t);
+  };
+
+  double psi, th, ph, psiD, thD, phD, phDD, heave;
+  attitude(0.0, psi, th, ph, psiD, thD, phD, phDD, heave);
+  setImuFromAttitude(psi, th, ph, psiD, thD, phD, phDD, heave, bias, rng);
+  euno_host::fusionInit();
+
+  ErrStat eC, eF, eQ, eHeel;
+  for (uint64_t k = 0; k < steps; k++){
+    double t = (double)(k + 1) * dt;
+    attitude(t, psi, th, ph, psiD, thD, phD, phDD, heave);
+    setImuFromAttitude(psi, th, ph, psiD, thD, phD, phDD, heave, bias, rng);
+    euno_host::advanceUs(10000);
+    euno_host::fusionUpdate();
+    if (t < 60.0) continue;   // primo minuto: convergenza bias
+
+    double truth = psi / D2R;
+    eC.add(wrap180(getCorrectedHeading() - truth));
+    eF.add(wrap180(euno_host::fusedHeading() - truth));
+    eQ.add(wrap180(euno_host::ahrsHeading() - truth));
+    eHeel.add(euno_host::ahrsHeel() - ph / D2R);
+  }
+
+  printf("\n%.0f min, sbandamento %.0f° ± rollio %.0f°, beccheggio ±4°, bias gyro Z %.2f °/s\n",
+         minutes, heelDeg, rollDeg, bias[2] / D2R);
+  printf("%-8s %10s %10s\n", "", "RMS °", "max °");
+  printf("%-8s %10.2f %10.2f\n", "COMPASS", eC.rms(), eC.mx);
+  printf("%-8s %10.2f %10.2f\n", "FUSION",  eF.rms(), eF.mx);
+  printf("%-8s %10.2f %10.2f\n", "AHRS",    eQ.rms(), eQ.mx);
+  printf("sbandamento AHRS: RMS %.2f°  max %.2f°\n", eHeel.rms(), eHeel.mx);
+  printf("bias Z stimato: %.3f °/s (vero %.3f)\n", euno_host::ahrsBiasZ() / D2R, bias[2] / D2R);
+  return 0;
+}
@@ -0,0 +1,57 @@
+// bench_core.cpp — costo delle tre funzioni calde del nucleo
+//
+//   bench_core [N]
+//
+// ns/chiamata di getCorrectedHeading() (snapshot vecchio: un burst mock per
+// chiamata), updateSensorFusion() (tick completo @100 Hz) e
+// calcola_velocita_e_verso() (3 stati, errori su tutto il giro), da
+// confrontare con i budget dei task (fusion 10 ms, controllo 50 ms).
+
+#include "euno_core.h"
+
+#include <chrono>
+
+using bclock = std::chrono::steady_clock;
+
+static volatile int sink;
+
+template <typename F>
+static double nsPerCall(size_t n, F f){
+  auto t0 = bclock::now();
+  int acc = 0;
+  for (size_t i = 0; i < n; i++) acc += f(i);
+  sink = acc;
+  return std::chrono::duration<double, std::nano>(bclock::now() - t0).count() / (double)n;
+}
+
+int main(int argc, char** argv){
+  size_t n = (argc > 1) ? (size_t)atol(argv[1]) : 1000000;
+
+  euno_host::reset();
+  euno_mock_imu.ax = 0.3f; euno_mock_imu.ay = -0.5f; euno_mock_imu.az = 9.7f;
+  euno_mock_imu.mx = 12.0f; euno_mock_imu.my = 20.0f; euno_mock_imu.mz = -40.0f;
+
+  double tH = nsPerCall(n, [](size_t i){
+    euno_mock_imu.mx = 12.0f + (float)(i & 63) * 0.1f;
+    euno_host::advanceUs(20000);
+    return getCorrectedHeading();
+  });
+
+  euno_host::fusionInit();
+  double tF = nsPerCall(n, [](size_t i){
+    euno_mock_imu.gz = (float)(i & 127) * 1e-4f;
+    euno_host::advanceUs(10000);
+    euno_host::fusionUpdate();
+    return (int)euno_host::fusedHeading();
+  });
+
+  double tC = nsPerCall(n * 10, [](size_t i){
+    return calcola_velocita_e_verso((int)(i % 360), (int)((i * 7) % 360));
+  });
+
+  printf("%-28s %10s\n", "", "ns/chiamata");
+  printf("%-28s %10.1f\n", "getCorrectedHeading()",      tH);
+  printf("%-28s %10.1f\n", "updateSensorFusion()",       tF);
+  printf("%-28s %10.1f\n", "calcola_velocita_e_verso()", tC);
+  return 0;
+}
@@ -0,0 +1,77 @@
+// bench_fastmath.cpp — accuratezza e velocità di euno_fastmath.h contro libm
+//
+//   bench_fastmath [N]
+//
+// Stampa l'errore massimo di fm_atan2 / fm_sincos su griglie dense
+// e i ns/chiamata di libm e delle versioni veloci, più il costo di un
+// getCorrectedHeading() completo (snapshot mock, media vettoriale inclusa).
+
+#include "euno_core.h"
+#include "euno_fastmath.h"
+
+#include <chrono>
+#include <vector>
+
+using bclock = std::chrono::steady_clock;
+
+static volatile float sink;
+
+template <typename F>
+static double nsPerCall(size_t n, F f){
+  auto t0 = bclock::now();
+  float acc = 0.0f;
+  for (size_t i = 0; i < n; i++) acc += f(i);
+  sink = acc;
+  return std::chrono::duration<double, std::nano>(bclock::now() - t0).count() / (double)n;
+}
+
+int main(int argc, char** argv){
+  size_t n = (argc > 1) ? (size_t)atol(argv[1]) : 5000000;
+
+  // ---- accuratezza ----------------------------------------------------
+  double eAtan = 0.0;
+  for (int i = 0; i < 720; i++)
+    for (int j = 1; j <= 200; j++){
+      double a = i * M_PI / 360.0, r = j * 0.5;
+      float y = (float)(r * sin(a)), x = (float)(r * cos(a));
+      double d = fabs(remainder((double)fm_atan2(y, x) - atan2((double)y, (double)x), 2 * M_PI));
+      if (d > eAtan) eAtan = d;
+    }
+  double eSin = 0.0;
+  for (int i = -2000000; i <= 2000000; i++){
+    float x = i * 0.005f;
+    float s, c; fm_sincos(x, s, c);
+    double ds = fabs(s - sin((double)x)), dc = fabs(c - cos((double)x));
+    if (ds > eSin) eSin = ds;
+    if (dc > eSin) eSin = dc;
+  }
+  printf("errore max  fm_atan2  = %.2e rad (%.5f°)\n", eAtan, eAtan * 180.0 / M_PI);
+  printf("errore max  fm_sincos = %.2e (|x| <= 1e4)\n", eSin);
+
+  // ---- velocità -------------------------------------------------------
+  std::vector<float> xs(4096), ys(4096);
+  for (int i = 0; i < 4096; i++){ xs[i] = cosf(i * 0.37f) * (1.0f + i % 7); ys[i] = sinf(i * 0.91f) * (1.0f + i % 5); }
+  auto X = [&](size_t i){ return xs[i & 4095]; };
+  auto Y = [&](size_t i){ return ys[i & 4095]; };
+
+  double tA0 = nsPerCall(n, [&](size_t i){ return atan2f(Y(i), X(i)); });
+  double tA1 = nsPerCall(n, [&](size_t i){ return fm_atan2(Y(i), X(i)); });
+  double tS0 = nsPerCall(n, [&](size_t i){ return sinf(X(i) * 3.0f) + cosf(X(i) * 3.0f); });
+  double tS1 = nsPerCall(n, [&](size_t i){ float s, c; fm_sincos(X(i) * 3.0f, s, c); return s + c; });
+
+  printf("%-10s %10s %10s %8s\n", "", "libm ns", "fast ns", "x");
+  printf("%-10s %10.2f %10.2f %8.2f\n", "atan2",  tA0, tA1, tA0 / tA1);
+  printf("%-10s %10.2f %10.2f %8.2f\n", "sincos", tS0, tS1, tS0 / tS1);
+
+  // ---- pipeline completa ----------------------------------------------
+  euno_host::reset();
+  euno_mock_imu.ax = 0.8f; euno_mock_imu.ay = -1.1f; euno_mock_imu.az = 9.7f;
+  size_t nh = n / 10;
+  double tH = nsPerCall(nh, [&](size_t i){
+    euno_mock_imu.mx = xs[i & 4095] * 20.0f; euno_mock_imu.my = ys[i & 4095] * 20.0f;
+    euno_host::advanceUs(20000);      // snapshot vecchio → un burst per chiamata
+    return (float)getCorrectedHeading();
+  });
+  printf("getCorrectedHeading(): %.1f ns/chiamata\n", tH);
+  return 0;
+}
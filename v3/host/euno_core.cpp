@@ -0,0 +1,124 @@
+// euno_core.cpp — TU host equivalente allo sketch: include il nucleo
+// heading/controllo e definisce le globali che il .ino definisce sul device.
+
+#include "euno_core.h"
+
+#include <Wire.h>
+#include <EEPROM.h>
+#include <math.h>
+
+#define EUNO_IS_CLIENT
+#include "euno_debug.h"
+#include "icm_compass.h"
+#include "icm_acquisition.h"
+#include "sensor_fusion.h"
+#include "sensor_ahrs.h"
+#include "autopilot_control.h"
+#include "autopilot_autotune.h"
+#include "motor_jog.h"
+#include "ADV_CALIBRATION.h"
+#include "calibration.h"
+#include "euno_scheduler.h"
+#include "euno_profiler.h"
+
+// ====== GLOBALI (come nel .ino) ======================================
+volatile int headingSourceMode = 0;
+int   headingOffset = 0;
+float smoothedSpeed = 0.0f;
+int   T_pause = 0;
+
+unsigned long motorPhaseStartTime = 0;
+bool motorPhaseActive = false;
+int  lastErrors[3] = {999, 999, 999};
+int  erroreIndex = 0;
+bool shouldStopMotor = false;
+
+bool calibrationMode = false;
+unsigned long calibrationStartTime = 0;
+float minX = 32767, minY = 32767, minZ = 32767;
+float maxX = -32768, maxY = -32768, maxZ = -32768;
+int16_t compassOffsetX = 0, compassOffsetY = 0, compassOffsetZ = 0;
+ICMCompass compass;
+
+volatile int  headingCommand = 0;
+volatile int  currentHeading = 0;
+volatile bool motorControllerState = false;
+TinyGPSPlus gps;
+
+int V_min = 100;
+int V_max = 255;
+int E_min = 5;
+int E_max = 40;
+int E_tol = 1;
+int T_risposta = 10;
+
+float errore_precedente = 0;
+
+int controlMode = CTRL_MODE_3STATE;
+int PID_Kp = 40;
+int PID_Ki = 2;
+int PID_Kd = 800;
+
+namespace euno_host {
+
+void reset(){
+  euno_mock_us  = 0;
+  euno_mock_imu = EunoMockImu();
+  for (int& p : euno_mock_pwm) p = 0;
+  gps = TinyGPSPlus();
+  gpsFixReset();
+  gpsMotionReset();
+  if (!cfgBegin()) cfgFinishMigration();   // EEPROM vergine: già nel formato record
+
+  V_min = 100; V_max = 255; E_min = 5; E_max = 40; E_tol = 1;
+  T_risposta = 10; T_pause = 0;
+  controlModeRequest(CTRL_MODE_3STATE); PID_Kp = 40; PID_Ki = 2; PID_Kd = 800;
+  resetPidState();
+  tuneState = TUNE_IDLE; tuneResultReady = false;
+  errore_precedente = 0;
+  headingSourceMode = 0; headingOffset = 0;
+  headingCommand = currentHeading = 0;
+  motorControllerState = false;
+  motorPhaseStartTime = 0; motorPhaseActive = false;
+  lastErrors[0] = lastErrors[1] = lastErrors[2] = 999;
+  erroreIndex = 0; shouldStopMotor = false;
+  smoothedSpeed = 0.0f;
+
+  if (!compass.isInitialized()) compass.begin(0x68, &Wire);
+}
+
+int motorPwm(){
+  return euno_mock_pwm[MOTOR_PIN_EXTEND] - euno_mock_pwm[MOTOR_PIN_RETRACT];
+}
+
+void  fusionInit()      { initSensorFusion(); }
+void  fusionUpdate()    { updateSensorFusion(); }
+void  fusionCalibrate() { startSensorFusionCalibration(); }
+bool  fusionCalibrating(){ return isSensorFusionCalibrating(); }
+float fusedHeading()    { return getFusedHeading(); }
+float gyroHeading()     { return getGyroOnlyHeading(); }
+float ahrsHeading()     { return getAhrsHeading(); }
+float ahrsHeel()        { return ahrs.heelDeg(); }
+float ahrsPitch()       { return ahrs.pitchDeg(); }
+float ahrsBiasZ()       { return ahrsSensorBiasZ(); }
+bool  fusionCheckpoint() { return fusionCheckpointService(millis(), true); }
+bool  fusionWarmLoad()   { return loadFusionCheckpoint(); }
+
+void tuneStart() { autotuneStart(getFusedHeading(), millis()); }
+
+bool tuneStep(unsigned long now, TuneOutcome& out){
+  if (autotuneActive()) {
+    currentHeading = getControlHeading();
+    autotuneStep(now);
+  }
+  if (!tuneResultReady) return false;
+  tuneResultReady = false;
+  const EunoTuneResult& r = tuneResult;
+  out.ok = (tuneState == TUNE_DONE);
+  out.Pu = r.Pu; out.amp = r.amp; out.Ku = r.Ku;
+  out.T_risposta = r.T_risposta; out.E_min = r.E_min; out.E_max = r.E_max; out.E_tol = r.E_tol;
+  out.PID_Kp = r.PID_Kp; out.PID_Ki = r.PID_Ki; out.PID_Kd = r.PID_Kd;
+  return true;
+}
+
+} // namespace euno_host
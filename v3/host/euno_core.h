@@ -0,0 +1,89 @@
+// euno_core.h — API host del nucleo heading/controllo (libreria euno_core)
+//
+// euno_core.cpp compila gli stessi header dello sketch (sensor_fusion.h,
+// calibration.h, ADV_CALIBRATION.h, autopilot_control.h) in un'unica TU, come
+// fa l'IDE Arduino con il .ino. Qui esponiamo le globali dello sketch e dei
+// wrapper per le funzioni static inline (che non hanno linkage esterno).
+//
+// Mock disponibili dagli shim: euno_mock_us (clock), euno_mock_imu (ICM-20948),
+// gps.mockFix(...) (TinyGPSPlus), EEPROM in RAM, euno_mock_pwm (analogWrite).
+
+#pragma once
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <TinyGPSPlus.h>
+#include <Adafruit_ICM20948.h>
+
+// ====== GLOBALI DELLO SKETCH =========================================
+extern TinyGPSPlus gps;
+extern float smoothedSpeed;
+
+extern int V_min, V_max, E_min, E_max, E_tol, T_risposta, T_pause;
+extern float errore_precedente;
+extern int controlMode, PID_Kp, PID_Ki, PID_Kd;   // 0 = 3 STATI, 1 = PID
+
+extern volatile int  headingSourceMode;
+extern volatile int  headingCommand;
+extern volatile int  currentHeading;
+extern volatile bool motorControllerState;
+extern int  headingOffset;
+extern int16_t compassOffsetX, compassOffsetY, compassOffsetZ;
+extern float minX, minY, minZ, maxX, maxY, maxZ;
+
+// ====== FUNZIONI CON LINKAGE ESTERNO =================================
+int  getCorrectedHeading();
+int  calculateDifference(int heading, int command);
+int  calcola_velocita_e_verso(int rotta_attuale, int rotta_desiderata);
+void gestisci_attuatore(int velocita);
+int  getControlHeading();
+void runMotorDutyCycle(unsigned long now);
+void runPidControl(float headingDeg, unsigned long now);
+void runAutopilotControl(unsigned long now);
+void resetPidState();
+void controlModeRequest(int mode);   // applicato dal passo successivo di runAutopilotControl()
+void stopMotor();
+
+namespace euno_host {
+
+// Azzera clock, mock, stato del controllore e della fusion
+void reset();
+
+// Avanza il clock simulato
+inline void advanceUs(uint32_t us){ euno_mock_us += us; }
+
+// Comando attuatore corrente: >0 estende, <0 ritrae, 0 fermo (duty 0..255)
+int motorPwm();
+
+// sensor_fusion.h
+void  fusionInit();
+void  fusionUpdate();
+// avvia la calibrazione gyro/tilt: avanza a ogni fusionUpdate() (500 tick)
+void  fusionCalibrate();
+bool  fusionCalibrating();
+float fusedHeading();
+float gyroHeading();
+
+// sensor_ahrs.h (avanza con fusionUpdate())
+float ahrsHeading();      // MODE 4, offset C-GPS incluso
+float ahrsHeel();         // °, + a dritta
+float ahrsPitch();        // °, + prua su
+float ahrsBiasZ();        // bias gyro Z stimato (rad/s, assi sensore)
+
+// checkpoint fusion (record CFG_FUSION nella EEPROM in RAM): salva ora, e
+// "riavvio" = rilegge il record; il prossimo fusionInit() fa il warm start
+bool  fusionCheckpoint();
+bool  fusionWarmLoad();
+
+// autopilot_autotune.h: relè attorno al heading fuso corrente
+struct TuneOutcome {
+  bool  ok = false;
+  float Pu = 0.0f, amp = 0.0f, Ku = 0.0f;
+  int   T_risposta = 0, E_min = 0, E_max = 0, E_tol = 0;
+  int   PID_Kp = 0, PID_Ki = 0, PID_Kd = 0;
+};
+void tuneStart();
+// Un tick del task di controllo; true quando la prova è finita (ok o fallita)
+bool tuneStep(unsigned long now, TuneOutcome& out);
+
+} // namespace euno_host
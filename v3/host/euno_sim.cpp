@@ -0,0 +1,238 @@
+// euno_sim.cpp — simulatore in anello chiuso più veloce del tempo reale
+//
+// Accoppia il controllore vero (calcola_velocita_e_verso + guardia 3 cicli +
+// duty-cycle T_pause di runMotorDutyCycle, task controllo @20 Hz) con barca
+// Nomoto, attuatore lineare e disturbi onda/raffica. Per ogni set di parametri
+// stampa una riga CSV con RMS errore, corsa timone e tempo motore.
+//
+//   euno_sim [--hours H] [--mode 0|1|4] [--wave A] [--gust S] [--helm H]
+//            [--noise N] [--step-min M] [--seed S] [--autotune]
+//            [V_min=..,V_max=..,E_min=..,E_max=..,E_tol=..,T_risposta=..,T_pause=..,
+//             CTRL_MODE=..,PID_Kp=..,PID_Ki=..,PID_Kd=..] ...
+//
+// Senza set espliciti esegue una griglia su T_risposta × E_tol × T_pause
+// (3 stati) più i guadagni PID di default. --autotune esegue prima la prova a
+// relè di CAL=TUNE sulla stessa barca e simula i parametri che ne risultano.
+
+#include "euno_core.h"
+#include "vessel_sim.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct ParamSet {
+  int V_min = 100, V_max = 255, E_min = 5, E_max = 40, E_tol = 1, T_risposta = 10, T_pause = 0;
+  int CTRL_MODE = 0, PID_Kp = 40, PID_Ki = 2, PID_Kd = 800;
+};
+
+struct SimConfig {
+  double hours    = 10.0;
+  int    mode     = 0;       // headingSourceMode: 0 = COMPASS, 1 = FUSION, 4 = AHRS
+  float  wave     = 2.0f;
+  float  gust     = 1.0f;
+  float  helm     = 0.5f;
+  float  noiseDeg = 0.5f;    // rumore bussola (σ, °)
+  float  stepMin  = 10.0f;   // cambio rotta ±30° ogni N minuti (0 = mai)
+  uint32_t seed   = 1;
+  bool   autotune = false;
+};
+
+static bool parseSet(const std::string& s, ParamSet& p){
+  size_t i = 0;
+  while (i < s.size()){
+    size_t c = s.find(',', i);
+    std::string kv = s.substr(i, c == std::string::npos ? std::string::npos : c - i);
+    size_t eq = kv.find('=');
+    if (eq == std::string::npos) return false;
+    std::string k = kv.substr(0, eq);
+    int v = atoi(kv.c_str() + eq + 1);
+    if      (k == "V_min")      p.V_min = v;
+    else if (k == "V_max")      p.V_max = v;
+    else if (k == "E_min")      p.E_min = v;
+    else if (k == "E_max")      p.E_max = v;
+    else if (k == "E_tol" || k == "Deadband") p.E_tol = v;
+    else if (k == "T_risposta") p.T_risposta = v;
+    else if (k == "T_pause")    p.T_pause = v;
+    else if (k == "CTRL_MODE")  p.CTRL_MODE = v;
+    else if (k == "PID_Kp")     p.PID_Kp = v;
+    else if (k == "PID_Ki")     p.PID_Ki = v;
+    else if (k == "PID_Kd")     p.PID_Kd = v;
+    else return false;
+    if (c == std::string::npos) break;
+    i = c + 1;
+  }
+  return true;
+}
+
+// Campo magnetico che getCorrectedHeading() legge come heading psi (tilt nullo)
+static void setImuFromVessel(const VesselModel& v, float measPsiDeg){
+  float p = measPsiDeg * (float)M_PI / 180.0f;
+  euno_mock_imu.mx = 25.0f * sinf(p);
+  euno_mock_imu.my = 25.0f * cosf(p);
+  euno_mock_imu.mz = -40.0f;
+  euno_mock_imu.ax = 0.0f; euno_mock_imu.ay = 0.0f; euno_mock_imu.az = 9.81f;
+  euno_mock_imu.gx = 0.0f; euno_mock_imu.gy = 0.0f;
+  euno_mock_imu.gz = v.r * (float)M_PI / 180.0f;
+}
+
+static SimMetrics runOne(const ParamSet& p, const SimConfig& cfg){
+  euno_host::reset();
+  V_min = p.V_min; V_max = p.V_max; E_min = p.E_min; E_max = p.E_max;
+  E_tol = p.E_tol; T_risposta = p.T_risposta; T_pause = p.T_pause;
+  controlModeRequest(p.CTRL_MODE); PID_Kp = p.PID_Kp; PID_Ki = p.PID_Ki; PID_Kd = p.PID_Kd;
+  headingSourceMode = cfg.mode;
+
+  VesselModel   boat;
+  ActuatorModel act;
+  SeaState      sea;
+  sea.waveAmp = cfg.wave; sea.gustSigma = cfg.gust; sea.helm = cfg.helm;
+  sea.seed(cfg.seed);
+  std::normal_distribution<float> noise(0.0f, cfg.noiseDeg > 0.0f ? cfg.noiseDeg : 1e-6f);
+
+  boat.psi = 90.0f;
+  setImuFromVessel(boat, boat.psi);
+  euno_host::fusionInit();
+
+  // FUSION, AHRS o PID (ROT dal gyro): fisica + fusion @100 Hz;
+  // COMPASS a 3 stati: basta il passo del task controllo
+  const bool     fusion    = (cfg.mode == 1) || (cfg.mode == 4) || (p.CTRL_MODE == 1);
+  const uint32_t dtUs      = fusion ? 10000 : 50000;
+  const float    dt        = (float)dtUs * 1e-6f;
+  const int      ctrlEvery = (int)(50000 / dtUs);   // task controllo @20 Hz
+  const uint64_t steps     = (uint64_t)(cfg.hours * 3600.0 / dt);
+  const uint64_t stepEvery = cfg.stepMin > 0.0f ? (uint64_t)(cfg.stepMin * 60.0f / dt) : 0;
+
+  int cmd = 90;
+  headingCommand = cmd;
+  motorControllerState = true;
+
+  SimMetrics m;
+  for (uint64_t k = 0; k < steps; k++){
+    float t = (float)k * dt;
+    if (stepEvery && k > 0 && k % stepEvery == 0){
+      cmd = ((k / stepEvery) & 1) ? cmd + 30 : cmd - 30;
+      cmd = (cmd % 360 + 360) % 360;
+      headingCommand = cmd;
+    }
+
+    setImuFromVessel(boat, boat.psi + noise(sea.rng));
+    euno_host::advanceUs(dtUs);
+    if (fusion) euno_host::fusionUpdate();
+
+    if (k % ctrlEvery == 0) runAutopilotControl(millis());
+
+    int pwm = euno_host::motorPwm();
+    act.step(pwm, dt);
+    boat.step(act.rudderDeg(), sea.step(t, dt), dt);
+
+    float err = (float)calculateDifference((int)lroundf(boat.psi) % 360, headingCommand);
+    m.sample(err, act.rudderDeg(), pwm, dt);
+  }
+  stopMotor();
+  return m;
+}
+
+// Prova a relè di CAL=TUNE (fusion @100 Hz, task controllo @20 Hz), max ~11 min
+static bool runTune(const SimConfig& cfg, euno_host::TuneOutcome& out){
+  euno_host::reset();
+  headingSourceMode = 1;
+
+  VesselModel   boat;
+  ActuatorModel act;
+  SeaState      sea;
+  sea.waveAmp = cfg.wave; sea.gustSigma = cfg.gust; sea.helm = cfg.helm;
+  sea.seed(cfg.seed + 1000);
+  std::normal_distribution<float> noise(0.0f, cfg.noiseDeg > 0.0f ? cfg.noiseDeg : 1e-6f);
+
+  boat.psi = 90.0f;
+  setImuFromVessel(boat, boat.psi);
+  euno_host::fusionInit();
+  headingCommand = 90;
+  motorControllerState = true;
+  euno_host::tuneStart();
+
+  const float dt = 0.01f;
+  for (int k = 0; k < 65000; k++){
+    setImuFromVessel(boat, boat.psi + noise(sea.rng));
+    euno_host::advanceUs(10000);
+    euno_host::fusionUpdate();
+    if (k % 5 == 0 && euno_host::tuneStep(millis(), out)) break;
+    act.step(euno_host::motorPwm(), dt);
+    boat.step(act.rudderDeg(), sea.step(k * dt, dt), dt);
+  }
+  stopMotor();
+  return out.ok;
+}
+
+int main(int argc, char** argv){
+  SimConfig cfg;
+  std::vector<ParamSet> sets;
+
+  for (int i = 1; i < argc; i++){
+    std::string a = argv[i];
+    auto next = [&](){ return (i + 1 < argc) ? argv[++i] : "0"; };
+    if      (a == "--hours")    cfg.hours    = atof(next());
+    else if (a == "--mode")     cfg.mode     = atoi(next());
+    else if (a == "--wave")     cfg.wave     = (float)atof(next());
+    else if (a == "--gust")     cfg.gust     = (float)atof(next());
+    else if (a == "--helm")     cfg.helm     = (float)atof(next());
+    else if (a == "--noise")    cfg.noiseDeg = (float)atof(next());
+    else if (a == "--step-min") cfg.stepMin  = (float)atof(next());
+    else if (a == "--seed")     cfg.seed     = (uint32_t)atoi(next());
+    else if (a == "--autotune") cfg.autotune = true;
+    else if (a == "--verbose")  euno_mock_serial_echo = true;
+    else {
+      ParamSet p;
+      if (!parseSet(a, p)){ fprintf(stderr, "argomento non valido: %s\n", a.c_str()); return 2; }
+      sets.push_back(p);
+    }
+  }
+
+  if (cfg.autotune){
+    euno_host::TuneOutcome t;
+    if (!runTune(cfg, t)){ fprintf(stderr, "[SIM] autotune fallito\n"); return 1; }
+    fprintf(stderr, "[SIM] autotune: Pu=%.1f s a=%.1f° Ku=%.1f\n", t.Pu, t.amp, t.Ku);
+    ParamSet base = sets.empty() ? ParamSet() : sets.front();
+    ParamSet tuned = base;
+    tuned.CTRL_MODE = 0;
+    tuned.T_risposta = t.T_risposta; tuned.E_min = t.E_min; tuned.E_max = t.E_max; tuned.E_tol = t.E_tol;
+    sets.push_back(tuned);
+    tuned.CTRL_MODE = 1;
+    tuned.PID_Kp = t.PID_Kp; tuned.PID_Ki = t.PID_Ki; tuned.PID_Kd = t.PID_Kd;
+    sets.push_back(tuned);
+    if (sets.size() == 2) sets.insert(sets.begin(), base);
+  }
+
+  if (sets.empty()){
+    for (int tr : {4, 8, 12})
+      for (int et : {1, 3})
+        for (int tp : {0, 5}){
+          ParamSet p; p.T_risposta = tr; p.E_tol = et; p.T_pause = tp;
+          sets.push_back(p);
+        }
+    ParamSet pid; pid.CTRL_MODE = 1;    // PID
+    sets.push_back(pid);
+  }
+
+  printf("V_min,V_max,E_min,E_max,E_tol,T_risposta,T_pause,CTRL_MODE,PID_Kp,PID_Ki,PID_Kd,"
+         "err_rms_deg,err_max_deg,rudder_travel_deg_h,motor_on_pct,reversals_h\n");
+
+  auto t0 = std::chrono::steady_clock::now();
+  double simH = 0.0;
+  for (const ParamSet& p : sets){
+    SimMetrics m = runOne(p, cfg);
+    double h = m.hours();
+    simH += h;
+    printf("%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%.2f,%.1f,%.0f,%.1f,%.0f\n",
+           p.V_min, p.V_max, p.E_min, p.E_max, p.E_tol, p.T_risposta, p.T_pause,
+           p.CTRL_MODE, p.PID_Kp, p.PID_Ki, p.PID_Kd,
+           m.errRms(), m.maxErr, m.rudderTravel / h, 100.0 * m.motorOnS / m.simS,
+           (double)m.reversals / h);
+    fflush(stdout);
+  }
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  fprintf(stderr, "[SIM] %.0f ore simulate in %.1f s (%.0f ore/min)\n",
+          simH, wall, wall > 0 ? simH / wall * 60.0 : 0.0);
+  return 0;
+}
@@ -0,0 +1,59 @@
+// Adafruit_ICM20948.h — shim host: ICM-20948 finto, i 9 assi arrivano da
+// euno_mock_imu (impostato dal programma host / simulatore)
+
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "Adafruit_Sensor.h"
+
+struct EunoMockImu {
+  float ax = 0.0f, ay = 0.0f, az = 9.81f;   // m/s²
+  float gx = 0.0f, gy = 0.0f, gz = 0.0f;    // rad/s
+  float mx = 0.0f, my = 20.0f, mz = -40.0f; // µT
+  uint32_t reads = 0;                       // transazioni I2C simulate
+};
+inline EunoMockImu euno_mock_imu;
+
+typedef enum { ICM20948_ACCEL_RANGE_2_G, ICM20948_ACCEL_RANGE_4_G,
+               ICM20948_ACCEL_RANGE_8_G, ICM20948_ACCEL_RANGE_16_G } icm20948_accel_range_t;
+typedef enum { ICM20948_GYRO_RANGE_250_DPS, ICM20948_GYRO_RANGE_500_DPS,
+               ICM20948_GYRO_RANGE_1000_DPS, ICM20948_GYRO_RANGE_2000_DPS } icm20948_gyro_range_t;
+typedef enum { AK09916_MAG_DATARATE_SHUTDOWN, AK09916_MAG_DATARATE_SINGLE,
+               AK09916_MAG_DATARATE_10_HZ, AK09916_MAG_DATARATE_20_HZ,
+               AK09916_MAG_DATARATE_50_HZ, AK09916_MAG_DATARATE_100_HZ } ak09916_data_rate_t;
+
+class Adafruit_ICM20948 {
+public:
+  bool begin_I2C(uint8_t = 0x69, TwoWire* = &Wire, int32_t = 0){ return true; }
+  void setAccelRange(icm20948_accel_range_t){}
+  void setGyroRange(icm20948_gyro_range_t){}
+  bool setMagDataRate(ak09916_data_rate_t){ return true; }
+  void setAccelRateDivisor(uint16_t){}
+  void setGyroRateDivisor(uint8_t){}
+
+  Adafruit_Sensor* getAccelerometerSensor(){ return &acc_; }
+  Adafruit_Sensor* getGyroSensor(){ return &gyr_; }
+  Adafruit_Sensor* getMagnetometerSensor(){ return &mag_; }
+
+  // Lettura unica di tutti i sensori (una transazione)
+  bool getEvent(sensors_event_t* a, sensors_event_t* g, sensors_event_t* t, sensors_event_t* m = nullptr){
+    euno_mock_imu.reads++;
+    fill(a, g, t, m);
+    return true;
+  }
+
+private:
+  static void fill(sensors_event_t* a, sensors_event_t* g, sensors_event_t* t, sensors_event_t* m){
+    const EunoMockImu& s = euno_mock_imu;
+    int32_t ts = (int32_t)millis();
+    if (a){ memset(a, 0, sizeof(*a)); a->timestamp = ts; a->acceleration = { s.ax, s.ay, s.az }; }
+    if (g){ memset(g, 0, sizeof(*g)); g->timestamp = ts; g->gyro = { s.gx, s.gy, s.gz }; }
+    if (t){ memset(t, 0, sizeof(*t)); t->timestamp = ts; t->temperature = 25.0f; }
+    if (m){ memset(m, 0, sizeof(*m)); m->timestamp = ts; m->magnetic = { s.mx, s.my, s.mz }; }
+  }
+
+  struct Acc : Adafruit_Sensor { bool getEvent(sensors_event_t* e) override { euno_mock_imu.reads++; fill(e, nullptr, nullptr, nullptr); return true; } } acc_;
+  struct Gyr : Adafruit_Sensor { bool getEvent(sensors_event_t* e) override { euno_mock_imu.reads++; fill(nullptr, e, nullptr, nullptr); return true; } } gyr_;
+  struct Mag : Adafruit_Sensor { bool getEvent(sensors_event_t* e) override { euno_mock_imu.reads++; fill(nullptr, nullptr, nullptr, e); return true; } } mag_;
+};
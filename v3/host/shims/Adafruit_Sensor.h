@@ -0,0 +1,31 @@
+// Adafruit_Sensor.h — shim host: solo i tipi usati da icm_compass.h
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+  float x, y, z;
+} sensors_vec_t;
+
+typedef struct {
+  int32_t version;
+  int32_t sensor_id;
+  int32_t type;
+  int32_t reserved0;
+  int32_t timestamp;
+  union {
+    float data[4];
+    sensors_vec_t acceleration;   // m/s²
+    sensors_vec_t magnetic;       // µT
+    sensors_vec_t gyro;           // rad/s
+    float temperature;
+  };
+} sensors_event_t;
+
+class Adafruit_Sensor {
+public:
+  virtual ~Adafruit_Sensor() {}
+  virtual bool getEvent(sensors_event_t*) = 0;
+};
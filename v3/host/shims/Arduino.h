@@ -0,0 +1,171 @@
+// Arduino.h — shim host (Linux) per compilare il nucleo heading/controllo
+// - String minimale (sopra std::string), Print/Serial su stdout
+// - clock simulato: millis()/micros() leggono euno_mock_us, delay() lo avanza
+// - analogWrite() registra il duty per pin (euno_mock_pwm)
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+#include <functional>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define PROGMEM
+#define F(s) (s)
+
+using std::min;
+using std::max;
+using std::abs;
+using std::isnan;
+
+template <typename T, typename L, typename H>
+static inline T constrain(T v, L lo, H hi){ return v < (T)lo ? (T)lo : (v > (T)hi ? (T)hi : v); }
+
+// ====== CLOCK SIMULATO ===============================================
+inline uint64_t euno_mock_us = 0;
+
+static inline unsigned long millis(){ return (unsigned long)(euno_mock_us / 1000ULL); }
+static inline unsigned long micros(){ return (unsigned long)euno_mock_us; }
+static inline void delay(unsigned long ms){ euno_mock_us += (uint64_t)ms * 1000ULL; }
+static inline void delayMicroseconds(unsigned int us){ euno_mock_us += us; }
+static inline void yield(){}
+
+// ====== PWM ==========================================================
+inline int euno_mock_pwm[64] = {0};
+static inline void analogWrite(uint8_t pin, int val){ if (pin < 64) euno_mock_pwm[pin] = val; }
+
+// ====== STRING =======================================================
+class String {
+public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s) {}
+  String(char c) : s_(1, c) {}
+  String(int v)                { s_ = std::to_string(v); }
+  String(unsigned int v)       { s_ = std::to_string(v); }
+  String(long v)               { s_ = std::to_string(v); }
+  String(unsigned long v)      { s_ = std::to_string(v); }
+  String(long long v)          { s_ = std::to_string(v); }
+  String(unsigned long long v) { s_ = std::to_string(v); }
+  String(float v, unsigned char dec = 2)  { fmt(v, dec); }
+  String(double v, unsigned char dec = 2) { fmt(v, dec); }
+
+  const char* c_str() const { return s_.c_str(); }
+  unsigned int length() const { return (unsigned int)s_.size(); }
+  bool isEmpty() const { return s_.empty(); }
+  void reserve(unsigned int n){ s_.reserve(n); }
+
+  char charAt(unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  char& operator[](unsigned int i) { return s_[i]; }
+
+  int indexOf(char c, unsigned int from = 0) const { return pos(s_.find(c, from)); }
+  int indexOf(const String& t, unsigned int from = 0) const { return pos(s_.find(t.s_, from)); }
+  int lastIndexOf(char c) const { return pos(s_.rfind(c)); }
+
+  String substring(unsigned int a) const { return a >= s_.size() ? String() : String(s_.substr(a)); }
+  String substring(unsigned int a, unsigned int b) const {
+    if (a > b) std::swap(a, b);
+    if (a >= s_.size()) return String();
+    return String(s_.substr(a, b - a));
+  }
+
+  bool startsWith(const String& p) const { return s_.compare(0, p.s_.size(), p.s_) == 0; }
+  bool endsWith(const String& p) const {
+    return s_.size() >= p.s_.size() && s_.compare(s_.size() - p.s_.size(), p.s_.size(), p.s_) == 0;
+  }
+  bool equals(const String& o) const { return s_ == o.s_; }
+
+  long  toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(s_.c_str(), nullptr); }
+  double toDouble() const { return strtod(s_.c_str(), nullptr); }
+
+  void trim(){
+    size_t a = s_.find_first_not_of(" \t\r\n");
+    size_t b = s_.find_last_not_of(" \t\r\n");
+    s_ = (a == std::string::npos) ? std::string() : s_.substr(a, b - a + 1);
+  }
+  void toUpperCase(){ for (auto& c : s_) c = (char)toupper((unsigned char)c); }
+  void remove(unsigned int idx){ if (idx < s_.size()) s_.erase(idx); }
+  void remove(unsigned int idx, unsigned int n){ if (idx < s_.size()) s_.erase(idx, n); }
+  void replace(const String& a, const String& b){
+    if (a.s_.empty()) return;
+    size_t p = 0;
+    while ((p = s_.find(a.s_, p)) != std::string::npos){ s_.replace(p, a.s_.size(), b.s_); p += b.s_.size(); }
+  }
+
+  String& operator+=(const String& o){ s_ += o.s_; return *this; }
+  String& operator+=(const char* o){ s_ += o; return *this; }
+  String& operator+=(char c){ s_ += c; return *this; }
+  bool concat(const String& o){ s_ += o.s_; return true; }
+
+  bool operator==(const String& o) const { return s_ == o.s_; }
+  bool operator!=(const String& o) const { return s_ != o.s_; }
+  bool operator==(const char* o) const { return s_ == o; }
+  bool operator!=(const char* o) const { return s_ != o; }
+
+  friend String operator+(const String& a, const String& b){ String r(a); r.s_ += b.s_; return r; }
+  friend String operator+(const String& a, const char* b){ String r(a); r.s_ += b; return r; }
+  friend String operator+(const char* a, const String& b){ String r(a); r.s_ += b.s_; return r; }
+  friend String operator+(const String& a, char b){ String r(a); r.s_ += b; return r; }
+
+private:
+  std::string s_;
+  static int pos(size_t p){ return p == std::string::npos ? -1 : (int)p; }
+  void fmt(double v, unsigned char dec){
+    char b[48]; snprintf(b, sizeof(b), "%.*f", (int)dec, v); s_ = b;
+  }
+};
+
+// ====== PRINT / SERIAL ===============================================
+inline bool euno_mock_serial_echo = false;   // true = stampa su stdout
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(const char* s, size_t n){
+    if (euno_mock_serial_echo) fwrite(s, 1, n, stdout);
+    return n;
+  }
+  size_t print(const char* s){ return write(s, strlen(s)); }
+  size_t print(const String& s){ return write(s.c_str(), s.length()); }
+  size_t print(char c){ return write(&c, 1); }
+  size_t print(int v){ return print(String(v)); }
+  size_t print(unsigned int v){ return print(String(v)); }
+  size_t print(long v){ return print(String(v)); }
+  size_t print(unsigned long v){ return print(String(v)); }
+  size_t print(double v, int dec = 2){ return print(String(v, (unsigned char)dec)); }
+  size_t println(){ return write("\n", 1); }
+  template <typename T> size_t println(const T& v){ size_t n = print(v); return n + println(); }
+  size_t println(double v, int dec){ size_t n = print(v, dec); return n + println(); }
+  size_t printf(const char* f, ...) __attribute__((format(printf, 2, 3))){
+    char b[512];
+    va_list ap; va_start(ap, f);
+    int n = vsnprintf(b, sizeof(b), f, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    return write(b, (size_t)n < sizeof(b) ? (size_t)n : sizeof(b) - 1);
+  }
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long, ...) {}
+  int  available(){ return 0; }
+  int  read(){ return -1; }
+  operator bool() const { return true; }
+};
+
+inline HardwareSerial Serial;
+inline HardwareSerial Serial2;
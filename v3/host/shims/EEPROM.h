@@ -0,0 +1,40 @@
+// EEPROM.h — shim host: EEPROM emulata in RAM (come il flash sector su ESP32)
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+class EEPROMClass {
+public:
+  static const int MAX_SIZE = 4096;
+
+  bool begin(int size){
+    if (size <= 0 || size > MAX_SIZE) return false;
+    if (!size_) memset(data_, 0xFF, sizeof(data_));   // flash "vergine"
+    size_ = size;
+    return true;
+  }
+  uint8_t read(int addr) const { return (addr >= 0 && addr < size_) ? data_[addr] : 0xFF; }
+  void write(int addr, uint8_t v){ if (addr >= 0 && addr < size_) data_[addr] = v; }
+  bool commit(){ commits++; return true; }
+  int  length() const { return size_; }
+  uint8_t* getDataPtr(){ return data_; }
+
+  template <typename T> T& get(int addr, T& t) const {
+    if (addr >= 0 && addr + (int)sizeof(T) <= size_) memcpy(&t, data_ + addr, sizeof(T));
+    return t;
+  }
+  template <typename T> const T& put(int addr, const T& t){
+    if (addr >= 0 && addr + (int)sizeof(T) <= size_) memcpy(data_ + addr, &t, sizeof(T));
+    return t;
+  }
+
+  uint32_t commits = 0;   // solo host: conta i commit (usura flash)
+
+private:
+  uint8_t data_[MAX_SIZE];
+  int     size_ = 0;
+};
+
+inline EEPROMClass EEPROM;
@@ -0,0 +1,3 @@
+// QMC5883LCompass.h — shim host: incluso da ADV_CALIBRATION.h ma non usato
+
+#pragma once
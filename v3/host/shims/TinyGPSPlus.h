@@ -0,0 +1,72 @@
+// TinyGPSPlus.h — shim host: stessi accessor della libreria, valori impostati
+// dal programma host (mockFix) invece che dal parser NMEA
+
+#pragma once
+
+#include <Arduino.h>
+
+struct TinyGPSLocation {
+  bool   valid = false;
+  double latDeg = 0.0, lngDeg = 0.0;
+  unsigned long updatedMs = 0;
+  bool   isValid() const { return valid; }
+  bool   isUpdated() const { return valid; }
+  double lat() const { return latDeg; }
+  double lng() const { return lngDeg; }
+  unsigned long age() const { return valid ? millis() - updatedMs : 0xFFFFFFFFUL; }
+};
+
+struct TinyGPSCourse {
+  bool   valid = false;
+  double value = 0.0;
+  unsigned long updatedMs = 0;
+  bool   isValid() const { return valid; }
+  bool   isUpdated() const { return valid; }
+  double deg() const { return value; }
+  unsigned long age() const { return valid ? millis() - updatedMs : 0xFFFFFFFFUL; }
+};
+
+struct TinyGPSSpeed {
+  bool   valid = false;
+  double kn = 0.0;
+  unsigned long updatedMs = 0;
+  bool   isValid() const { return valid; }
+  bool   isUpdated() const { return valid; }
+  double knots() const { return kn; }
+  double mps() const { return kn * 0.514444; }
+  double kmph() const { return kn * 1.852; }
+  unsigned long age() const { return valid ? millis() - updatedMs : 0xFFFFFFFFUL; }
+};
+
+struct TinyGPSInteger {
+  uint32_t v = 0;
+  bool isValid() const { return true; }
+  uint32_t value() const { return v; }
+};
+
+struct TinyGPSHDOP {
+  double v = 1.0;
+  bool   isValid() const { return true; }
+  double hdop() const { return v; }
+};
+
+class TinyGPSPlus {
+public:
+  TinyGPSLocation location;
+  TinyGPSCourse   course;
+  TinyGPSSpeed    speed;
+  TinyGPSInteger  satellites;
+  TinyGPSHDOP     hdop;
+
+  bool encode(char){ return false; }
+  uint32_t charsProcessed() const { return 0; }
+
+  // solo host: imposta un fix completo
+  void mockFix(bool valid, double lat, double lng, double cogDeg, double sogKn){
+    unsigned long now = millis();
+    location.valid = course.valid = speed.valid = valid;
+    location.latDeg = lat; location.lngDeg = lng; location.updatedMs = now;
+    course.value = cogDeg; course.updatedMs = now;
+    speed.kn = sogKn;      speed.updatedMs = now;
+  }
+};
@@ -0,0 +1,19 @@
+// Wire.h — shim host: bus I2C assente (ogni transazione diretta fallisce)
+
+#pragma once
+
+#include <stdint.h>
+
+class TwoWire {
+public:
+  bool begin(int = -1, int = -1, uint32_t = 0){ return true; }
+  void setClock(uint32_t){}
+  void beginTransmission(uint8_t){}
+  size_t write(uint8_t){ return 1; }
+  uint8_t endTransmission(bool = true){ return 2; }   // NACK
+  uint8_t requestFrom(int, int){ return 0; }
+  int available(){ return 0; }
+  int read(){ return 0; }
+};
+
+inline TwoWire Wire;
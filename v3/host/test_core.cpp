@@ -0,0 +1,646 @@
+// test_core.cpp — test unitari del nucleo (ctest)
+//
+//   test_core
+//
+// calculateDifference() attorno a 0/360, controllore a 3 stati
+// (calcola_velocita_e_verso: verso, banda morta E_tol, FERMA/INVERTI) e
+// heading FUSION che attraversa il nord senza salti né medie sbagliate,
+// checkpoint/warm start della fusion e calibrazione gyro incrementale.
+// Poi i moduli header-only, inclusi qui direttamente: filtro COG/SOG
+// (gps_motion.h: gate, ripartenza, attorno al nord), rotta a bordo
+// (route_engine.h: parsing coordinate, segno XTE, arrivo e cambio tratta),
+// modo TRACK (track_mode.h: RMB/APB, guadagno e saturazione, APB preferita),
+// archivio EEPROM (euno_config.h: CRC, slot, esiti di cfgLoad, commit
+// raggruppato), riga di telemetria (telemetry_frame.h: formato, checksum,
+// overflow) e modo WIND (wind_vane.h: MWV/VWR, media circolare, raffiche).
+// Stampa ogni controllo fallito ed esce con 1 se ce n'è almeno uno.
+
+#include "euno_core.h"
+#include "euno_config.h"
+#include "gps_motion.h"
+#include "route_engine.h"
+#include "telemetry_frame.h"
+#include "wind_vane.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { \
+  printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+#define CHECK_NEAR(a, b, tol) do { double _a = (double)(a), _b = (double)(b); if (!(fabs(_a - _b) <= (tol))) { \
+  printf("FAIL %s:%d  %s ~ %s  (%g != %g)\n", __FILE__, __LINE__, #a, #b, _a, _b); failures++; } } while (0)
+
+#define CHECK_EQ(a, b) do { long _a = (long)(a), _b = (long)(b); if (_a != _b) { \
+  printf("FAIL %s:%d  %s == %s  (%ld != %ld)\n", __FILE__, __LINE__, #a, #b, _a, _b); failures++; } } while (0)
+
+static float circDiff(float a, float b){
+  float d = fmodf(a - b + 540.0f, 360.0f) - 180.0f;
+  return fabsf(d);
+}
+
+static void testCalculateDifference(){
+  CHECK_EQ(calculateDifference(90, 90), 0);
+  CHECK_EQ(calculateDifference(350, 10), 20);     // attraverso il nord, a dritta
+  CHECK_EQ(calculateDifference(10, 350), -20);    // ...e a sinistra
+  CHECK_EQ(calculateDifference(0, 359), -1);
+  CHECK_EQ(calculateDifference(359, 0), 1);
+  CHECK_EQ(calculateDifference(0, 180), 180);
+  CHECK_EQ(calculateDifference(0, 181), -179);
+  CHECK_EQ(calculateDifference(270, 90), 180);
+}
+
+// Un passo del 3 stati con errore_precedente dato (deltaAmp = |prec| − |err|)
+static int step3(int hdg, int cmd, float prec){
+  errore_precedente = prec;
+  return calcola_velocita_e_verso(hdg, cmd);
+}
+
+static void testThreeState(){
+  euno_host::reset();   // V 100..255, E 5..40, E_tol 1, T_risposta 10
+
+  // verso: errore + → estende, − → ritrae, anche attraverso il nord
+  CHECK(step3(0, 20, 0.0f) > 0);
+  CHECK(step3(20, 0, 0.0f) < 0);
+  CHECK(step3(350, 10, 0.0f) > 0);
+  CHECK(step3(10, 350, 0.0f) < 0);
+  CHECK_EQ(step3(0, 20, 0.0f), -step3(20, 0, 0.0f));
+  // ampiezza: proporzionale tra E_min e E_max, saturata fuori
+  CHECK_EQ(step3(0, 3, 0.0f), V_min);
+  CHECK_EQ(step3(0, 90, 0.0f), V_max);
+
+  // banda morta E_tol: fermo, ed errore_precedente aggiornato
+  CHECK_EQ(step3(0, 1, 0.0f), 0);
+  CHECK_EQ(step3(359, 0, 0.0f), 0);
+  CHECK_EQ(step3(0, 0, 7.0f), 0);
+  CHECK(errore_precedente == 0.0f);
+  E_tol = 3;
+  CHECK_EQ(step3(0, 3, 0.0f), 0);
+  CHECK(step3(0, 4, 0.0f) > 0);
+  E_tol = 1;
+
+  // FERMA: l'errore cala alla velocità voluta (|err|/T_risposta = 2°/passo ±20%)
+  CHECK_EQ(step3(0, 20, 22.0f), 0);
+  CHECK_EQ(step3(0, 20, 22.3f), 0);
+  CHECK_EQ(step3(20, 0, -22.0f), 0);
+  // CONTINUA: cala troppo piano (o cresce)
+  CHECK(step3(0, 20, 21.0f) > 0);
+  CHECK(step3(0, 20, 18.0f) > 0);
+  // INVERTI: cala troppo in fretta, si contro-governa
+  CHECK(step3(0, 20, 30.0f) < 0);
+  CHECK(step3(20, 0, -30.0f) > 0);
+}
+
+// Campo magnetico che getCorrectedHeading() legge come psi (tilt nullo),
+// gyro Z = rate (come euno_sim)
+static void setImu(float psiDeg, float rateDegS){
+  float p = psiDeg * (float)M_PI / 180.0f;
+  euno_mock_imu.mx = 25.0f * sinf(p);
+  euno_mock_imu.my = 25.0f * cosf(p);
+  euno_mock_imu.mz = -40.0f;
+  euno_mock_imu.ax = 0.0f; euno_mock_imu.ay = 0.0f; euno_mock_imu.az = 9.81f;
+  euno_mock_imu.gx = 0.0f; euno_mock_imu.gy = 0.0f;
+  euno_mock_imu.gz = rateDegS * (float)M_PI / 180.0f;
+}
+
+static void testFusionWrap(){
+  euno_host::reset();
+
+  // fermi a 359°: la fusion non deve scivolare verso 180 (media non circolare)
+  setImu(359.0f, 0.0f);
+  euno_host::fusionInit();
+  for (int k = 0; k < 500; k++){ euno_host::advanceUs(10000); euno_host::fusionUpdate(); }
+  float h = euno_host::fusedHeading();
+  CHECK(h >= 0.0f && h < 360.0f);
+  CHECK(circDiff(h, 359.0f) < 2.0f);
+  CHECK(abs(calculateDifference(getCorrectedHeading(), 359)) <= 1);
+
+  // accostata a 5°/s da 340° a 20°: sempre in [0,360), vicina al vero, senza salti
+  float psi = 340.0f, prev = NAN, maxErr = 0.0f, maxJump = 0.0f;
+  bool inRange = true;
+  setImu(psi, 0.0f);
+  euno_host::fusionInit();
+  for (int k = 0; k < 300; k++){ euno_host::advanceUs(10000); euno_host::fusionUpdate(); }
+  for (int k = 0; k < 800; k++){
+    psi = fmodf(psi + 0.05f, 360.0f);
+    setImu(psi, 5.0f);
+    euno_host::advanceUs(10000);
+    euno_host::fusionUpdate();
+    h = euno_host::fusedHeading();
+    if (!(h >= 0.0f && h < 360.0f)) inRange = false;
+    if (k > 0) maxJump = fmaxf(maxJump, circDiff(h, prev));
+    if (k > 100) maxErr = fmaxf(maxErr, circDiff(h, psi));
+    prev = h;
+  }
+  CHECK(inRange);
+  CHECK(maxJump < 1.0f);
+  CHECK(maxErr < 5.0f);
+  CHECK(circDiff(h, 20.0f) < 5.0f);
+}
+
+static void fusionTicks(int n){
+  for (int k = 0; k < n; k++){ euno_host::advanceUs(10000); euno_host::fusionUpdate(); }
+}
+
+// "Riavvio": reset() e bussola a regime sul nuovo heading prima di fusionInit()
+static void reboot(float psiDeg, float gz){
+  euno_host::reset();
+  setImu(psiDeg, 0.0f);
+  euno_mock_imu.gz = gz;
+  for (int k = 0; k < 50; k++){ euno_host::advanceUs(10000); getCorrectedHeading(); }
+}
+
+// Checkpoint e warm start (CFG_FUSION): un gyro con bias non compensato
+// lascia l'heading fuso avanti alla bussola di un offset costante, che il
+// checkpoint salva e il warm start ripristina se la barca non ha girato.
+static void testFusionWarmStart(){
+  const float bias = 0.04f;                  // rad/s ≈ 2.3 °/s
+  euno_host::reset();
+  setImu(90.0f, 0.0f);
+  euno_mock_imu.gz = bias;
+  euno_host::fusionInit();
+  CHECK(!euno_host::fusionCheckpoint());     // AHRS ancora in boot
+  fusionTicks(300);
+  float off = euno_host::fusedHeading() - 90.0f;
+  CHECK(off > 0.5f && off < 3.0f);
+  CHECK(euno_host::fusionCheckpoint());
+
+  // riavvio, barca ferma: heading ripreso con l'offset, non dalla bussola
+  reboot(90.0f, bias);
+  CHECK(euno_host::fusionWarmLoad());
+  euno_host::fusionInit();
+  CHECK(circDiff(euno_host::fusedHeading(), 90.0f + off) < 0.2f);
+
+  // riavvio dopo un'accostata: l'heading salvato non torna, si riparte dalla bussola
+  reboot(150.0f, bias);
+  CHECK(euno_host::fusionWarmLoad());
+  euno_host::fusionInit();
+  CHECK(circDiff(euno_host::fusedHeading(), 150.0f) < 0.2f);
+
+  // record cancellato: niente warm start
+  cfgErase(CFG_FUSION);
+  CHECK(!euno_host::fusionWarmLoad());
+}
+
+// CAL=GYRO incrementale: 500 tick a barca ferma, un campione per tick;
+// un movimento scarta la prova e lascia il bias di prima
+static void testFusionCalibration(){
+  const float bias = 0.04f;
+  euno_host::reset();
+  setImu(90.0f, 0.0f);
+  euno_mock_imu.gz = bias;
+  euno_host::fusionInit();
+  fusionTicks(300);
+  CHECK(circDiff(euno_host::fusedHeading(), 90.0f) > 0.5f);   // bias non compensato
+
+  CHECK(!euno_host::fusionCalibrating());
+  euno_host::fusionCalibrate();
+  CHECK(euno_host::fusionCalibrating());
+  fusionTicks(499);
+  CHECK(euno_host::fusionCalibrating());
+  fusionTicks(1);
+  CHECK(!euno_host::fusionCalibrating());
+  CHECK_NEAR(euno_host::ahrsBiasZ(), bias, 1e-3);
+  fusionTicks(300);
+  CHECK(circDiff(euno_host::fusedHeading(), 90.0f) < 0.1f);
+  CHECK(euno_host::fusionCheckpoint());      // bias nuovo → checkpoint
+
+  // movimento a metà prova: scartata subito, bias invariato
+  euno_host::fusionCalibrate();
+  fusionTicks(100);
+  euno_mock_imu.gz = bias + 0.2f;
+  fusionTicks(1);
+  CHECK(!euno_host::fusionCalibrating());
+  euno_mock_imu.gz = bias;
+  fusionTicks(300);
+  CHECK(circDiff(euno_host::fusedHeading(), 90.0f) < 0.1f);
+
+  // nuova calibrazione con gyro a zero, poi riavvio: il checkpoint riporta
+  // il bias di prima e con il gyro di nuovo a "bias" l'heading non deriva
+  euno_mock_imu.gz = 0.0f;
+  euno_host::fusionCalibrate();
+  fusionTicks(500);
+  CHECK(!euno_host::fusionCalibrating());
+  reboot(90.0f, bias);
+  CHECK(euno_host::fusionWarmLoad());
+  euno_host::fusionInit();
+  fusionTicks(300);
+  CHECK(circDiff(euno_host::fusedHeading(), 90.0f) < 0.1f);
+  CHECK_NEAR(euno_host::ahrsBiasZ(), bias, 3e-3);
+}
+
+// "$<body>*XX" con il checksum giusto
+static const char* nmea(const char* body){
+  static char out[128];
+  uint8_t x = 0;
+  for (const char* p = body; *p; p++) x ^= (uint8_t)*p;
+  snprintf(out, sizeof(out), "$%s*%02X", body, x);
+  return out;
+}
+
+// ── gps_motion.h ─────────────────────────────────────────────────────
+static EunoGpsFix fixAt(uint32_t ms, float cog, float sog){
+  EunoGpsFix f;
+  f.ms = ms; f.valid = true; f.source = GPS_SRC_NMEA;
+  f.cogDeg = cog; f.sogKn = sog;
+  return f;
+}
+
+static void testGpsMotion(){
+  EunoMotionKf kf;
+  EunoGpsMotion m;
+  uint32_t t = 1000;
+
+  // rotta costante: stima ferma sulla misura
+  for (int k = 0; k < 10; k++, t += 1000) CHECK(kf.update(fixAt(t, 90.0f, 6.0f), t));
+  kf.output(t, m);
+  CHECK(m.valid && m.cogValid);
+  CHECK_NEAR(m.cogDeg, 90.0f, 0.1);
+  CHECK_NEAR(m.sogKn, 6.0f, 0.05);
+  CHECK(m.sogSigKn > 0.0f && m.sogSigKn < MOT_NMEA_SOG_KN);
+
+  // fix ripetuto, non valido, vecchio o con sAcc pessima: ignorato
+  CHECK(!kf.update(fixAt(t - 1000, 90.0f, 6.0f), t));
+  EunoGpsFix bad = fixAt(t, 90.0f, 6.0f); bad.valid = false;
+  CHECK(!kf.update(bad, t));
+  CHECK(!kf.update(fixAt(t + 1, 90.0f, 6.0f), t + 1 + MOT_MAX_AGE_MS + 1));
+  bad = fixAt(t + 2, 90.0f, 6.0f); bad.sogAccKn = MOT_MAX_SOG_ACC_KN + 1.0f;
+  uint32_t rej = kf.rejected;
+  CHECK(!kf.update(bad, t + 2));
+  CHECK_EQ(kf.rejected, rej + 1);
+  t += 1000;
+
+  // un fix fuori gate è scartato, MOT_REJECT_RESET di fila = manovra vera
+  uint32_t resets = kf.resets;
+  CHECK(!kf.update(fixAt(t, 270.0f, 6.0f), t));
+  kf.output(t, m);
+  CHECK_NEAR(m.cogDeg, 90.0f, 0.5);
+  t += 1000;
+  CHECK(kf.update(fixAt(t, 90.0f, 6.0f), t));    // rientra: conteggio azzerato
+  for (int k = 0; k < MOT_REJECT_RESET - 1; k++) { t += 1000; CHECK(!kf.update(fixAt(t, 270.0f, 6.0f), t)); }
+  t += 1000;
+  CHECK(kf.update(fixAt(t, 270.0f, 6.0f), t));
+  CHECK_EQ(kf.resets, resets + 1);
+  kf.output(t, m);
+  CHECK_NEAR(m.cogDeg, 270.0f, 0.1);
+
+  // senza fix da MOT_STALE_MS la stima non è più valida
+  kf.output(t + MOT_STALE_MS + 1, m);
+  CHECK(!m.valid && !m.cogValid);
+
+  // 359/1 alternati: COG attorno al nord, non 180
+  kf = EunoMotionKf();
+  for (int k = 0; k < 20; k++, t += 1000) kf.update(fixAt(t, (k & 1) ? 1.0f : 359.0f, 5.0f), t);
+  kf.output(t, m);
+  CHECK(m.cogValid);
+  CHECK(circDiff(m.cogDeg, 0.0f) < 1.5f);
+  CHECK_NEAR(m.sogKn, 5.0f, 0.05);
+
+  // da fermi il COG non è pubblicato
+  kf = EunoMotionKf();
+  for (int k = 0; k < 5; k++, t += 1000) kf.update(fixAt(t, 123.0f, 0.1f), t);
+  kf.output(t, m);
+  CHECK(m.valid && !m.cogValid);
+}
+
+// ── route_engine.h ───────────────────────────────────────────────────
+static EunoGpsFix posAt(uint32_t ms, double lat, double lon){
+  EunoGpsFix f = fixAt(ms, 0.0f, 5.0f);
+  f.posValid = true; f.lat = lat; f.lon = lon;
+  return f;
+}
+
+static void testRoute(){
+  double v = 0.0;
+  CHECK(geoParseDeg("45.5", 90.0, v) && v == 45.5);
+  CHECK(geoParseDeg(" -12.25 ", 90.0, v) && v == -12.25);
+  CHECK(geoParseDeg("-180", 180.0, v) && v == -180.0);
+  CHECK(!geoParseDeg("45.1x", 90.0, v));
+  CHECK(!geoParseDeg("", 90.0, v));
+  CHECK(!geoParseDeg("abc", 90.0, v));
+  CHECK(!geoParseDeg("nan", 90.0, v));
+  CHECK(!geoParseDeg("90.01", 90.0, v));
+  CHECK(!geoParseDeg("1e3", 180.0, v));
+
+  // tratta verso est lungo l'equatore: a nord (a sinistra) XTE + = governare a dritta
+  EunoRouteLeg g;
+  routeLegGeometry(0.0, 0.0, 0.0, 1.0, 0.01, 0.5, g);
+  CHECK_NEAR(g.xteNm, 0.6, 0.01);
+  CHECK_NEAR(g.atdNm, 30.0, 0.1);
+  CHECK_NEAR(g.legNm, 60.0, 0.1);
+  CHECK_NEAR(g.trackDeg, 90.0, 0.1);
+  CHECK_NEAR(g.dtwNm, 30.0, 0.1);
+  routeLegGeometry(0.0, 0.0, 0.0, 1.0, -0.01, 0.5, g);
+  CHECK_NEAR(g.xteNm, -0.6, 0.01);
+  CHECK(geoBearingDeg(0.0, 0.0, 1.0, 0.0) < 1e-9);
+  CHECK_NEAR(geoBearingDeg(0.0, 0.0, 0.0, -1.0), 270.0, 1e-9);
+
+  EunoRouteNav nav;
+  CHECK(!nav.add(91.0, 0.0, "X"));
+  CHECK(!nav.add(0.0, 180.5, "X"));
+  CHECK(!nav.add(NAN, 0.0, "X"));
+  CHECK(nav.add(0.0, 0.1, "A"));
+  CHECK(nav.add(0.0, 0.2, ""));
+  CHECK(nav.add(0.1, 0.2, "LONGNAME"));
+  CHECK_EQ(nav.r.count, 3);
+  CHECK(strcmp(nav.r.wp[2].name, "LONGNAM") == 0);
+
+  EunoNavTarget t;
+  uint32_t ms = 1000;
+  CHECK_EQ(nav.step(posAt(ms, 0.0, 0.0), ms, t), ROUTE_STEP_NONE);   // non avviata
+  CHECK(nav.start());
+
+  // primo fix = origine; verso A
+  CHECK_EQ(nav.step(posAt(ms, 0.0, 0.0), ms, t), ROUTE_STEP_STEER);
+  CHECK(t.valid && t.hasXte && t.src == NAV_SRC_ROUTE);
+  CHECK_NEAR(t.btwDeg, 90.0, 0.1);
+  CHECK(strcmp(t.dest, "A") == 0);
+  CHECK_EQ(nav.step(posAt(ms, 0.0, 0.0), ms, t), ROUTE_STEP_NONE);   // stesso fix
+  CHECK_EQ(nav.step(posAt(ms + 1, 0.0, 0.01), ms + 1 + ROUTE_FIX_AGE_MS + 1, t), ROUTE_STEP_NONE);
+
+  // nel cerchio d'arrivo di A → tratta A→#01
+  ms += 1000;
+  CHECK_EQ(nav.step(posAt(ms, 0.0, 0.1 - 0.0003), ms, t), ROUTE_STEP_ADVANCED);
+  CHECK_EQ(nav.r.active, 1);
+  CHECK(strcmp(t.dest, "#01") == 0);
+  // oltre la perpendicolare del waypoint (fuori dal cerchio) → arrivato anche così
+  ms += 1000;
+  CHECK_EQ(nav.step(posAt(ms, 0.002, 0.201), ms, t), ROUTE_STEP_ADVANCED);
+  CHECK_EQ(nav.r.active, 2);
+  CHECK(circDiff(t.btwDeg, 0.0f) < 1.0f);
+  // ultimo waypoint: la rotta finisce
+  ms += 1000;
+  CHECK_EQ(nav.step(posAt(ms, 0.1, 0.2), ms, t), ROUTE_STEP_DONE);
+  CHECK(!nav.running);
+
+  // ripresa dal waypoint attivo: origine = quello prima
+  nav.r.active = 1;
+  CHECK(nav.start() && nav.hasOrigin);
+  CHECK_NEAR(nav.oLon, 0.1, 1e-7);
+  CHECK(nav.select(0) && !nav.hasOrigin);
+  CHECK(!nav.select(3));
+  nav.setArrive(1);
+  CHECK_EQ(nav.r.arriveM, ROUTE_ARRIVE_MIN_M);
+  nav.clear();
+  CHECK_EQ(nav.r.count, 0);
+  CHECK_EQ(nav.r.arriveM, ROUTE_ARRIVE_MIN_M);
+  CHECK(!nav.start());
+}
+
+// ── track_mode.h ─────────────────────────────────────────────────────
+static void testTrack(){
+  EunoNavTarget t;
+  CHECK(navParseRmb(nmea("GPRMB,A,0.10,L,ORIG,DEST,4500.000,N,01300.000,E,5.0,045.0,6.0,V"), 1000, t));
+  CHECK(t.valid && t.hasXte && !t.arrived && t.src == NAV_SRC_RMB);
+  CHECK_NEAR(t.xteNm, -0.10, 1e-6);
+  CHECK_NEAR(t.btwDeg, 45.0, 1e-6);
+  CHECK(isnan(t.bodDeg));
+  CHECK(strcmp(t.dest, "DEST") == 0);
+  CHECK(!navParseRmb("$GPRMB,A,0.10,L,ORIG,DEST,4500.000,N,01300.000,E,5.0,045.0,6.0,V*00", 1000, t));
+  CHECK(!navParseRmb(nmea("GPAPB,A,A,0.10,R,N,V,V,045.0,T,DEST,050.0,T,048.0,T"), 1000, t));
+
+  CHECK(navParseApb(nmea("GPAPB,A,A,0.1852,R,K,V,V,045.0,T,WP12345678,050.0,T,048.0,T"), 1000, t));
+  CHECK_NEAR(t.xteNm, 0.10, 1e-5);          // km → nm
+  CHECK_NEAR(t.bodDeg, 45.0, 1e-6);
+  CHECK_NEAR(t.htsDeg, 48.0, 1e-6);
+  CHECK_NEAR(navPlainBearing(t), 48.0, 1e-6);
+  CHECK(strcmp(t.dest, "WP12345") == 0);
+  CHECK(navParseApb(nmea("GPAPB,A,A,,,N,V,V,045.0,T,,050.0,T,,T"), 1000, t));
+  CHECK(!t.hasXte && t.dest[0] == 0);
+  CHECK_NEAR(navPlainBearing(t), 50.0, 1e-6);
+
+  // P: 0.05 nm a dritta → +15°, a sinistra → −15°, saturato a TRK_MAX_CORR
+  EunoTrackCtl ctl;
+  float cmd = 0.0f;
+  EunoNavTarget a;
+  a.src = NAV_SRC_RMB; a.valid = true; a.hasXte = true; a.btwDeg = 45.0f; strcpy(a.dest, "D");
+  a.ms = 1000; a.xteNm = 0.05f;
+  CHECK(ctl.step(a, cmd));
+  CHECK_NEAR(cmd, 60.0f, 1e-3);
+  a.ms = 2000; a.xteNm = -0.05f;
+  CHECK(ctl.step(a, cmd));
+  CHECK_NEAR(cmd, 30.0f + TRK_KI_DEG_NMS * -0.05f, 1e-3);
+  ctl.reset();
+  a.ms = 3000; a.xteNm = 1.0f;
+  CHECK(ctl.step(a, cmd));
+  CHECK_NEAR(cmd, 45.0f + TRK_MAX_CORR, 1e-3);
+  a.ms = 4000;
+  CHECK(ctl.step(a, cmd));
+  CHECK(ctl.integDeg == 0.0f);               // saturo nello stesso verso: niente windup
+
+  // I: XTE costante → l'integrale cresce di Ki·XTE·dt
+  ctl.reset();
+  a.xteNm = 0.02f;
+  for (int k = 0; k < 10; k++) { a.ms = 10000 + k * 1000; ctl.step(a, cmd); }
+  CHECK_NEAR(ctl.integDeg, 9 * TRK_KI_DEG_NMS * 0.02f, 1e-4);
+  // cambio di waypoint: riparte da questo passo; frasi ferme da TRK_STALE_MS: azzerato
+  strcpy(a.dest, "E"); a.ms += 1000;
+  ctl.step(a, cmd);
+  CHECK_NEAR(ctl.integDeg, TRK_KI_DEG_NMS * 0.02f, 1e-5);
+  a.ms += TRK_STALE_MS + 1; ctl.step(a, cmd);
+  CHECK(ctl.integDeg == 0.0f);
+
+  // arrivo: dritti al BTW; attorno al nord il comando resta in [0,360)
+  a.arrived = true; a.ms += 1000;
+  CHECK(ctl.step(a, cmd));
+  CHECK_NEAR(cmd, 45.0f, 1e-6);
+  CHECK(ctl.corrDeg == 0.0f);
+  a.arrived = false; a.btwDeg = 5.0f; a.xteNm = -0.05f; a.ms += 1000;
+  CHECK(ctl.step(a, cmd));
+  CHECK(cmd >= 0.0f && cmd < 360.0f);
+  CHECK(circDiff(cmd, 350.0f) < 0.5f);
+
+  // APB recente: RMB ignorata; base = BOD
+  ctl.reset();
+  EunoNavTarget b = a;
+  b.src = NAV_SRC_APB; b.bodDeg = 100.0f; b.btwDeg = 110.0f; b.xteNm = 0.0f; b.ms = 50000;
+  CHECK(ctl.step(b, cmd));
+  CHECK_NEAR(cmd, 100.0f, 1e-6);
+  a.ms = b.ms + 1000;
+  CHECK(!ctl.step(a, cmd));
+  a.ms = b.ms + TRK_APB_PREF_MS;
+  CHECK(ctl.step(a, cmd));
+  a.valid = false; a.ms += 1000;
+  CHECK(!ctl.step(a, cmd));
+}
+
+// ── euno_config.h ────────────────────────────────────────────────────
+struct TestRec { int32_t a; float b; uint8_t c[6]; };
+CFG_ASSERT_FITS(CFG_PARAMS, TestRec);
+static_assert(cfgSlotCap(CFG_ROUTE) == 528, "slot CFG_ROUTE");
+static_assert(cfgSlotCap(0xEE) == 0, "id sconosciuto");
+
+static void testConfig(){
+  // CRC-16/CCITT-FALSE di "123456789" = 0x29B1
+  uint16_t crc = 0xFFFF;
+  for (const char* p = "123456789"; *p; p++) crc = cfgCrc16(crc, (uint8_t)*p);
+  CHECK_EQ(crc, 0x29B1);
+
+  // slot: dopo l'intestazione, ordinati, senza sovrapposizioni, dentro la EEPROM
+  int prevEnd = 16;
+  const size_t n = sizeof(cfgSlots) / sizeof(cfgSlots[0]);
+  for (size_t i = 0; i < n; i++) {
+    CHECK(cfgSlots[i].addr >= prevEnd);
+    CHECK(cfgSlots[i].cap > sizeof(EunoCfgHeader));
+    for (size_t j = 0; j < i; j++) CHECK(cfgSlots[j].id != cfgSlots[i].id);
+    CHECK(cfgSlot(cfgSlots[i].id) == &cfgSlots[i]);
+    prevEnd = cfgSlots[i].addr + cfgSlots[i].cap;
+  }
+  CHECK(prevEnd <= CFG_EEPROM_SIZE);
+  CHECK(cfgSlot(0xEE) == nullptr);
+
+  if (!cfgBegin()) cfgFinishMigration();
+  CHECK(cfgIsOpen() && !cfgLegacy());
+
+  TestRec w = { -123456, 3.5f, { 1, 2, 3, 4, 5, 6 } }, r = {};
+  uint8_t ver = 0;
+  CHECK(cfgStore(CFG_PARAMS, &w, sizeof(w), 7));
+  CHECK_EQ(cfgLoad(CFG_PARAMS, &r, sizeof(r), 7, &ver), CFG_LOAD_OK);
+  CHECK(memcmp(&w, &r, sizeof(w)) == 0);
+  CHECK_EQ(ver, 7);
+
+  // altra versione o altra lunghezza: integro ma da migrare, dst non toccato
+  r = TestRec();
+  CHECK_EQ(cfgLoad(CFG_PARAMS, &r, sizeof(r), 8, &ver), CFG_LOAD_VERSION);
+  CHECK_EQ(ver, 7);
+  CHECK_EQ(r.a, 0);
+  CHECK_EQ(cfgLoad(CFG_PARAMS, &r, sizeof(r) - 2, 7), CFG_LOAD_VERSION);
+
+  // un byte cambiato nei dati: CRC sbagliato
+  const EunoCfgSlot* s = cfgSlot(CFG_PARAMS);
+  int da = s->addr + (int)sizeof(EunoCfgHeader);
+  EEPROM.write(da + 1, EEPROM.read(da + 1) ^ 0x10);
+  CHECK_EQ(cfgLoad(CFG_PARAMS, &r, sizeof(r), 7), CFG_LOAD_CORRUPT);
+  EEPROM.write(da + 1, EEPROM.read(da + 1) ^ 0x10);
+  CHECK_EQ(cfgLoad(CFG_PARAMS, &r, sizeof(r), 7), CFG_LOAD_OK);
+
+  // record più grande dello slot, id sconosciuto, record cancellato
+  static uint8_t big[64];
+  CHECK(!cfgStore(CFG_GPS, big, sizeof(big), 1));
+  CHECK(!cfgStore(0xEE, big, 4, 1));
+  CHECK_EQ(cfgLoad(CFG_GPS, big, sizeof(big), 1), CFG_LOAD_MISSING);
+  cfgErase(CFG_PARAMS);
+  CHECK_EQ(cfgLoad(CFG_PARAMS, &r, sizeof(r), 7), CFG_LOAD_MISSING);
+
+  // commit: dopo CFG_COALESCE_MS di quiete, rimandato se busy fino a CFG_MAX_DEFER_MS
+  cfgFlush();
+  uint32_t c0 = cfgCommits;
+  unsigned long t0 = millis();
+  CHECK(!cfgService(t0, false));                      // niente da scrivere
+  cfgStore(CFG_PARAMS, &w, sizeof(w), 7);
+  CHECK(!cfgService(t0 + CFG_COALESCE_MS - 1, false));
+  CHECK(!cfgService(t0 + CFG_COALESCE_MS, true));
+  CHECK(cfgService(t0 + CFG_COALESCE_MS, false));
+  CHECK_EQ(cfgCommits, c0 + 1);
+  cfgStore(CFG_PARAMS, &w, sizeof(w), 7);
+  CHECK(!cfgService(t0 + CFG_MAX_DEFER_MS - 1, true));
+  CHECK(cfgService(t0 + CFG_MAX_DEFER_MS, true));
+  CHECK_EQ(cfgCommits, c0 + 2);
+  cfgErase(CFG_PARAMS);
+  cfgFlush();
+}
+
+// ── telemetry_frame.h ────────────────────────────────────────────────
+struct TestTelem { int a; float b; };
+
+static void testTelemetryFrame(){
+  EunoFrame f;
+  f.begin("");
+  f.putInt(0); f.put(' '); f.putInt(-42); f.put(' '); f.putInt(2147483647L);
+  CHECK(strcmp(f.c_str(), "0 -42 2147483647") == 0);
+  f.begin("");
+  f.putFixed(3.14159f, 2); f.put(' ');
+  f.putFixed(-12.345f, 1); f.put(' ');
+  f.putFixed(0.96f, 1); f.put(' ');
+  f.putFixed(-0.2f, 0); f.put(' ');
+  f.putFixed(7.0f, 3);
+  CHECK(strcmp(f.c_str(), "3.14 -12.3 1.0 -0 7.000") == 0);
+  f.begin("");
+  f.putFixed(NAN, 1); f.put(' '); f.putFixed(INFINITY, 1); f.put(' '); f.putFixed(5e9f, 1);
+  CHECK(strcmp(f.c_str(), "nan inf ovf") == 0);
+
+  static const EunoTelemField<TestTelem> tab[] = {
+    { "A", [](EunoFrame& f, const TestTelem& c){ f.putInt(c.a); } },
+    { "B", [](EunoFrame& f, const TestTelem& c){ f.putFixed(c.b, 2); } },
+    { "C", [](EunoFrame& f, const TestTelem&){ f.na(); } },
+  };
+  TestTelem c = { -7, 2.5f };
+  CHECK(telemBuild(f, "$AUTOPILOT", tab, c));
+  CHECK(strncmp(f.c_str(), "$AUTOPILOT,A=-7,B=2.50,C=N/A*", 29) == 0);
+  CHECK_EQ(f.len, strlen(f.c_str()));
+  CHECK_EQ(f.len, 31);
+  CHECK(nmeaChecksumOk(f.c_str()));
+  CHECK(strcmp(f.c_str(), nmea("AUTOPILOT,A=-7,B=2.50,C=N/A")) == 0);
+
+  // riga troppo lunga: finish() → false, buffer sempre terminato
+  static const EunoTelemField<TestTelem> longTab[] = {
+    { "X", [](EunoFrame& f, const TestTelem&){ for (int i = 0; i < TELEM_FRAME_MAX; i++) f.put('x'); } },
+  };
+  CHECK(!telemBuild(f, "$AUTOPILOT", longTab, c));
+  CHECK(f.ovf);
+  CHECK_EQ(f.len, TELEM_FRAME_MAX - 1);
+  CHECK_EQ(strlen(f.c_str()), f.len);
+  CHECK(telemBuild(f, "$AUTOPILOT", tab, c));       // begin() azzera l'overflow
+  CHECK(!f.ovf);
+}
+
+// ── wind_vane.h ──────────────────────────────────────────────────────
+static void testWind(){
+  EunoWindObs o;
+  CHECK(windParseMwv(nmea("WIMWV,045.0,R,10.0,N,A"), 1000, o));
+  CHECK_NEAR(o.awaDeg, 45.0f, 1e-5);
+  CHECK_NEAR(o.awsKn, 10.0f, 1e-5);
+  CHECK(windParseMwv(nmea("WIMWV,315.0,R,5.0,M,A"), 1000, o));
+  CHECK_NEAR(o.awaDeg, -45.0f, 1e-4);
+  CHECK_NEAR(o.awsKn, 5.0f * 1.943844f, 1e-4);
+  CHECK(!windParseMwv(nmea("WIMWV,045.0,T,10.0,N,A"), 1000, o));   // vento vero
+  CHECK(!windParseMwv(nmea("WIMWV,045.0,R,10.0,N,V"), 1000, o));   // non valido
+  CHECK(windParseVwr(nmea("IIVWR,030.0,L,8.0,N,4.1,M,14.8,K"), 1000, o));
+  CHECK_NEAR(o.awaDeg, -30.0f, 1e-5);
+  CHECK_NEAR(o.awsKn, 8.0f, 1e-5);
+  CHECK(!windParseVwr(nmea("IIVWR,190.0,R,8.0,N,,,,"), 1000, o));
+
+  // vento in poppa che oscilla tra ±179: la media circolare resta a 180, non a 0
+  EunoWindVane wv;
+  EunoWindObs w;
+  w.awsKn = 10.0f;
+  for (int k = 0; k < 40; k++) {
+    w.ms = 1000 + k * 200;
+    w.awaDeg = (k & 1) ? 179.0f : -179.0f;
+    CHECK(wv.update(w, 0.0f));
+  }
+  CHECK(circDiff(wv.dirDeg(), 180.0f) < 1.0f);
+  CHECK(fabsf(wv.awaDeg(0.0f)) > 179.0f);
+  // il filtro è riferito al nord: l'accostata sposta l'AWA, non la direzione
+  CHECK(circDiff(wv.dirDeg(), 180.0f) < 1.0f);
+  CHECK_NEAR(wv.awaDeg(90.0f), 90.0f, 1.0);
+  CHECK_NEAR(wv.command(135.0f), 45.0f, 1.0);
+
+  // raffica isolata scartata, salto che dura WIND_GUST_PERSIST campioni accettato
+  uint32_t ms = w.ms;
+  w.awaDeg = 90.0f;
+  w.ms = (ms += 200);
+  CHECK(!wv.update(w, 0.0f));
+  w.awaDeg = 180.0f; w.ms = (ms += 200);
+  CHECK(wv.update(w, 0.0f));
+  for (int k = 1; k < WIND_GUST_PERSIST; k++) { w.awaDeg = 90.0f; w.ms = (ms += 200); CHECK(!wv.update(w, 0.0f)); }
+  w.ms = (ms += 200);
+  CHECK(wv.update(w, 0.0f));
+  CHECK(wv.valid(ms) && !wv.valid(ms + WIND_STALE_MS + 1));
+}
+
+int main(){
+  testCalculateDifference();
+  testThreeState();
+  testFusionWrap();
+  testFusionWarmStart();
+  testFusionCalibration();
+  testGpsMotion();
+  testRoute();
+  testTrack();
+  testConfig();
+  testTelemetryFrame();
+  testWind();
+  if (failures) { printf("%d controlli falliti\n", failures); return 1; }
+  printf("test_core: OK\n");
+  return 0;
+}
@@ -0,0 +1,110 @@
+// vessel_sim.h — modelli per la simulazione in anello chiuso (solo host)
+//
+// - VesselModel:   Nomoto 1° ordine  T·ṙ + r = K·δ + d   (r in °/s, δ in °)
+// - ActuatorModel: attuatore lineare con zona morta PWM, velocità di corsa
+//                  finita e fine corsa → angolo timone
+// - SeaState:      onde (somma di sinusoidi) + raffiche (Gauss-Markov) + orza
+// - SimMetrics:    RMS errore, corsa timone, tempo motore acceso, inversioni
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <random>
+
+struct VesselModel {
+  float K = 0.12f;      // guadagno Nomoto: (°/s) per ° di timone
+  float T = 6.0f;       // costante di tempo (s)
+  float psi = 0.0f;     // heading vero (°, 0..360)
+  float r = 0.0f;       // rate of turn (°/s)
+
+  void step(float deltaDeg, float distDegps, float dt){
+    float rdot = (K * deltaDeg + distDegps - r) / T;
+    r   += rdot * dt;
+    psi += r * dt;
+    psi  = fmodf(psi, 360.0f);
+    if (psi < 0.0f) psi += 360.0f;
+  }
+};
+
+struct ActuatorModel {
+  float strokeTimeS = 8.0f;   // corsa completa (-1 → +1) a PWM 255
+  int   deadPwm     = 40;     // sotto questo duty il motore non si muove
+  float rudderMax   = 35.0f;  // ° di timone a fine corsa
+  float x = 0.0f;             // posizione normalizzata -1..+1
+
+  // pwm > 0 estende (timone a dritta, heading che aumenta), < 0 ritrae
+  void step(int pwm, float dt){
+    int a = pwm < 0 ? -pwm : pwm;
+    if (a <= deadPwm) return;
+    float v = (2.0f / strokeTimeS) * (float)(a - deadPwm) / (float)(255 - deadPwm);
+    x += (pwm > 0 ? v : -v) * dt;
+    if (x >  1.0f) x =  1.0f;
+    if (x < -1.0f) x = -1.0f;
+  }
+  float rudderDeg() const { return x * rudderMax; }
+};
+
+struct SeaState {
+  float waveAmp   = 2.0f;     // °/s equivalenti di disturbo di imbardata
+  float gustSigma = 1.0f;     // σ raffiche (°/s)
+  float gustTau   = 20.0f;    // costante di correlazione raffiche (s)
+  float helm      = 0.5f;     // orza costante (°/s)
+
+  std::mt19937 rng{1};
+  std::normal_distribution<float> n01{0.0f, 1.0f};
+  float gust = 0.0f;
+  float phase[3] = {0, 0, 0};
+
+  void seed(uint32_t s){
+    rng.seed(s);
+    std::uniform_real_distribution<float> u(0.0f, 2.0f * (float)M_PI);
+    for (float& p : phase) p = u(rng);
+    gust = 0.0f;
+  }
+
+  // disturbo di imbardata all'istante t (s)
+  float step(float t, float dt){
+    static const float periods[3] = {6.0f, 8.5f, 11.0f};
+    static const float weights[3] = {0.5f, 0.3f, 0.2f};
+    float w = 0.0f;
+    for (int i = 0; i < 3; i++)
+      w += weights[i] * sinf(2.0f * (float)M_PI * t / periods[i] + phase[i]);
+    // Gauss-Markov discreto: varianza stazionaria gustSigma²
+    float a = expf(-dt / gustTau);
+    gust = a * gust + gustSigma * sqrtf(1.0f - a * a) * n01(rng);
+    return waveAmp * w + gust + helm;
+  }
+};
+
+struct SimMetrics {
+  double sumErr2 = 0.0;
+  double maxErr = 0.0;
+  double rudderTravel = 0.0;  // Σ|Δδ| (°)
+  double motorOnS = 0.0;
+  uint32_t reversals = 0;
+  double simS = 0.0;
+  uint64_t n = 0;
+
+  float lastRudder = 0.0f;
+  int   lastDir = 0;
+
+  void sample(float errDeg, float rudderDeg, int pwm, float dt){
+    double e = errDeg;
+    sumErr2 += e * e;
+    if (fabs(e) > maxErr) maxErr = fabs(e);
+    rudderTravel += fabs(rudderDeg - lastRudder);
+    lastRudder = rudderDeg;
+    int dir = (pwm > 0) - (pwm < 0);
+    if (dir != 0) {
+      motorOnS += dt;
+      if (lastDir != 0 && dir != lastDir) reversals++;
+      lastDir = dir;
+    }
+    simS += dt;
+    n++;
+  }
+
+  double errRms() const { return n ? sqrt(sumErr2 / (double)n) : 0.0; }
+  double hours() const { return simS / 3600.0; }
+};
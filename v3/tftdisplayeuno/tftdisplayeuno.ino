@@ -23,6 +23,7 @@ WiFiUDP udp;
 IPAddress autopilotIP(192,168,4,1);   // IP dell’autopilota in modalità AP
 const int autopilotPort = 10110;      // porta NMEA UDP
 unsigned long lastReconnectAttempt = 0;
+bool udpStarted = false;              // UDP aperto al primo aggancio Wi-Fi
 
 bool motorControllerState = false;
 bool externalBearingEnabled = false;
@@ -60,18 +61,10 @@ void setup() {
 
   WiFi.mode(WIFI_STA);
   WiFi.setSleep(false);
-// setup()
-WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-
-  Serial.println("[TFT] Connecting to EunoAutopilot...");
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(200);
-    Serial.print(".");
-  }
-  Serial.println("\n[TFT] Connected, IP=" + WiFi.localIP().toString());
-
-  udp.begin(10110); // avvia UDP locale
-  Serial.println("[TFT] UDP started on port 10110");
+  // Connessione asincrona: UI e touch subito attivi, l'aggancio lo segue loop()
+  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  lastReconnectAttempt = millis();
+  Serial.printf("[TFT] Connecting to EunoAutopilot... (UI ready @%lu ms)\n", millis());
 }
 
 // ===================== LOOP =====================
@@ -121,7 +114,7 @@ void loop() {
         cmd = "$PEUNO,CMD,SET," + rest;
       }
 
-      if (cmd.length()) {
+      if (cmd.length() && udpStarted && WiFi.status() == WL_CONNECTED) {
         udp.beginPacket(autopilotIP, autopilotPort);
         udp.print(cmd);
         udp.endPacket();
@@ -132,7 +125,14 @@ void loop() {
       pendingAction = "";
     }
   }
-if (WiFi.status() != WL_CONNECTED) {
+bool wifiUp = (WiFi.status() == WL_CONNECTED);
+if (wifiUp && !udpStarted) {
+  udp.begin(10110); // avvia UDP locale
+  udpStarted = true;
+  Serial.printf("[TFT] Connected @%lu ms, IP=%s, UDP on port 10110\n",
+                millis(), WiFi.localIP().toString().c_str());
+}
+if (!wifiUp) {
   if (millis() - lastReconnectAttempt > 5000) {  // ogni 5s tenta
     Serial.println("WiFi non connesso, ritento...");
     WiFi.disconnect();
@@ -142,7 +142,7 @@ if (WiFi.status() != WL_CONNECTED) {
 }
 
   // Ricezione telemetria via UDP
-  int packetSize = udp.parsePacket();
+  int packetSize = udpStarted ? udp.parsePacket() : 0;
   if (packetSize) {
     char buf[512];
     int len = udp.read(buf, sizeof(buf)-1);